@@ -0,0 +1,634 @@
+/*
+ Formatting benchmarks.
+
+ Copyright (c) 2015, Victor Zverovich
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum { NUM_VALUES = 1024 };
+
+int ints[NUM_VALUES];
+double doubles[NUM_VALUES];
+std::string strings[NUM_VALUES];
+
+// Fills the input arrays with pseudo-random values so that the compiler
+// can't precompute the output.
+void init_values() {
+  unsigned state = 42;
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    state = state * 1103515245 + 12345;
+    ints[i] = static_cast<int>(state >> 1) >> (state % 24);
+    doubles[i] = ints[i] / 1000.0;
+    strings[i] = std::string("str") + std::string(state % 16, 'x');
+  }
+}
+
+char buffer[4096];
+wchar_t wbuffer[4096];
+fmt::MemoryWriter writer;
+fmt::WMemoryWriter wwriter;
+
+// Each benchmark function performs one operation on the i-th input and
+// returns the size of the output.
+typedef std::size_t (*BenchFunc)(int i);
+
+// Integers
+
+std::size_t int_format(int i) { return fmt::format("{}", ints[i]).size(); }
+
+std::size_t int_sprintf(int i) {
+  return fmt::sprintf("%d", ints[i]).size();
+}
+
+std::size_t int_writer(int i) {
+  writer.clear();
+  writer << ints[i];
+  return writer.size();
+}
+
+std::size_t int_format_int(int i) { return fmt::FormatInt(ints[i]).size(); }
+
+std::size_t int_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%d", ints[i]);
+}
+
+std::size_t int_ostream(int i) {
+  std::ostringstream os;
+  os << ints[i];
+  return os.str().size();
+}
+
+// Doubles
+
+std::size_t double_format(int i) {
+  return fmt::format("{:.3f}", doubles[i]).size();
+}
+
+std::size_t double_sprintf(int i) {
+  return fmt::sprintf("%.3f", doubles[i]).size();
+}
+
+std::size_t double_writer(int i) {
+  writer.clear();
+  writer.write("{:.3f}", doubles[i]);
+  return writer.size();
+}
+
+std::size_t double_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%.3f", doubles[i]);
+}
+
+std::size_t double_ostream(int i) {
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3) << doubles[i];
+  return os.str().size();
+}
+
+// Strings
+
+std::size_t string_format(int i) {
+  return fmt::format("{} {}", strings[i], "literal").size();
+}
+
+std::size_t string_sprintf(int i) {
+  return fmt::sprintf("%s %s", strings[i], "literal").size();
+}
+
+std::size_t string_writer(int i) {
+  writer.clear();
+  writer << strings[i] << ' ' << "literal";
+  return writer.size();
+}
+
+std::size_t string_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%s %s",
+                  strings[i].c_str(), "literal");
+}
+
+std::size_t string_ostream(int i) {
+  std::ostringstream os;
+  os << strings[i] << ' ' << "literal";
+  return os.str().size();
+}
+
+// Named arguments
+
+std::size_t named_format(int i) {
+  return fmt::format("{name}={value}", fmt::arg("name", strings[i]),
+                     fmt::arg("value", ints[i])).size();
+}
+
+std::size_t named_writer(int i) {
+  writer.clear();
+  writer.write("{name}={value}", fmt::arg("name", strings[i]),
+               fmt::arg("value", ints[i]));
+  return writer.size();
+}
+
+std::size_t named_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%s=%d",
+                  strings[i].c_str(), ints[i]);
+}
+
+// Padding
+
+std::size_t padding_format(int i) {
+  return fmt::format("{:>12}|{:<8}|{:08x}", ints[i], strings[i],
+                     static_cast<unsigned>(ints[i])).size();
+}
+
+std::size_t padding_sprintf(int i) {
+  return fmt::sprintf("%12d|%-8s|%08x", ints[i], strings[i],
+                      static_cast<unsigned>(ints[i])).size();
+}
+
+std::size_t padding_writer(int i) {
+  writer.clear();
+  writer << fmt::pad(ints[i], 12) << '|'
+         << fmt::pad(strings[i].c_str(), 8) << '|'
+         << fmt::pad(fmt::hex(static_cast<unsigned>(ints[i])), 8, '0');
+  return writer.size();
+}
+
+std::size_t padding_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%12d|%-8s|%08x", ints[i],
+                  strings[i].c_str(), static_cast<unsigned>(ints[i]));
+}
+
+std::size_t padding_ostream(int i) {
+  std::ostringstream os;
+  os << std::setw(12) << ints[i] << '|' << std::left << std::setw(8)
+     << strings[i] << '|' << std::right << std::hex << std::setfill('0')
+     << std::setw(8) << static_cast<unsigned>(ints[i]);
+  return os.str().size();
+}
+
+// Wide characters
+
+std::size_t wide_format(int i) {
+  return fmt::format(L"{} {:.3f} {}", ints[i], doubles[i], L"wide").size();
+}
+
+std::size_t wide_writer(int i) {
+  wwriter.clear();
+  wwriter.write(L"{} {:.3f} {}", ints[i], doubles[i], L"wide");
+  return wwriter.size();
+}
+
+std::size_t wide_snprintf(int i) {
+  return swprintf(wbuffer, sizeof(wbuffer) / sizeof(*wbuffer),
+                  L"%d %.3f %ls", ints[i], doubles[i], L"wide");
+}
+
+std::size_t wide_ostream(int i) {
+  std::wostringstream os;
+  os << ints[i] << L' ' << std::fixed << std::setprecision(3) << doubles[i]
+     << L' ' << L"wide";
+  return os.str().size();
+}
+
+// Large argument lists
+
+#define FMT_BENCH_INTS(i) \
+  ints[i], ints[(i + 1) % NUM_VALUES], ints[(i + 2) % NUM_VALUES], \
+  ints[(i + 3) % NUM_VALUES], ints[(i + 4) % NUM_VALUES], \
+  ints[(i + 5) % NUM_VALUES], ints[(i + 6) % NUM_VALUES], \
+  ints[(i + 7) % NUM_VALUES], ints[(i + 8) % NUM_VALUES], \
+  ints[(i + 9) % NUM_VALUES]
+
+std::size_t large_format(int i) {
+  return fmt::format("{} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} "
+                     "{} {}", FMT_BENCH_INTS(i), FMT_BENCH_INTS(i)).size();
+}
+
+std::size_t large_sprintf(int i) {
+  return fmt::sprintf("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d "
+                      "%d %d", FMT_BENCH_INTS(i), FMT_BENCH_INTS(i)).size();
+}
+
+std::size_t large_writer(int i) {
+  writer.clear();
+  writer.write("{} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {}",
+               FMT_BENCH_INTS(i), FMT_BENCH_INTS(i));
+  return writer.size();
+}
+
+std::size_t large_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer),
+                  "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d "
+                  "%d %d", FMT_BENCH_INTS(i), FMT_BENCH_INTS(i));
+}
+
+std::size_t large_ostream(int i) {
+  std::ostringstream os;
+  for (int j = 0; j < 20; ++j)
+    os << ints[(i + j % 10) % NUM_VALUES] << (j != 19 ? " " : "");
+  return os.str().size();
+}
+
+// Log line: a timestamp, a source location, a message and a duration.
+
+std::size_t log_format(int i) {
+  return fmt::format("[{:08}] {}:{}: request {} took {:.3f} ms", i,
+                     strings[i], ints[i] & 0xfff, ints[i], doubles[i]).size();
+}
+
+std::size_t log_sprintf(int i) {
+  return fmt::sprintf("[%08d] %s:%d: request %d took %.3f ms", i,
+                      strings[i], ints[i] & 0xfff, ints[i],
+                      doubles[i]).size();
+}
+
+std::size_t log_writer(int i) {
+  writer.clear();
+  writer.write("[{:08}] {}:{}: request {} took {:.3f} ms", i, strings[i],
+               ints[i] & 0xfff, ints[i], doubles[i]);
+  return writer.size();
+}
+
+std::size_t log_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer),
+                  "[%08d] %s:%d: request %d took %.3f ms", i,
+                  strings[i].c_str(), ints[i] & 0xfff, ints[i], doubles[i]);
+}
+
+std::size_t log_ostream(int i) {
+  std::ostringstream os;
+  os << '[' << std::setw(8) << std::setfill('0') << i << std::setfill(' ')
+     << "] " << strings[i] << ':' << (ints[i] & 0xfff) << ": request "
+     << ints[i] << " took " << std::fixed << std::setprecision(3)
+     << doubles[i] << " ms";
+  return os.str().size();
+}
+
+// CSV row
+
+std::size_t csv_format(int i) {
+  return fmt::format("{},{},{:.2f},{},{}\n", i, strings[i], doubles[i],
+                     ints[i], ints[(i + 1) % NUM_VALUES]).size();
+}
+
+std::size_t csv_sprintf(int i) {
+  return fmt::sprintf("%d,%s,%.2f,%d,%d\n", i, strings[i], doubles[i],
+                      ints[i], ints[(i + 1) % NUM_VALUES]).size();
+}
+
+std::size_t csv_writer(int i) {
+  writer.clear();
+  writer << i << ',' << strings[i] << ',';
+  writer.write("{:.2f}", doubles[i]);
+  writer << ',' << ints[i] << ',' << ints[(i + 1) % NUM_VALUES] << '\n';
+  return writer.size();
+}
+
+std::size_t csv_snprintf(int i) {
+  return snprintf(buffer, sizeof(buffer), "%d,%s,%.2f,%d,%d\n", i,
+                  strings[i].c_str(), doubles[i], ints[i],
+                  ints[(i + 1) % NUM_VALUES]);
+}
+
+std::size_t csv_ostream(int i) {
+  std::ostringstream os;
+  os << i << ',' << strings[i] << ',' << std::fixed << std::setprecision(2)
+     << doubles[i] << ',' << ints[i] << ',' << ints[(i + 1) % NUM_VALUES]
+     << '\n';
+  return os.str().size();
+}
+
+// JSON fragment
+
+std::size_t json_format(int i) {
+  return fmt::format(
+        "{{\"id\":{},\"name\":\"{}\",\"score\":{:.3f},\"tags\":[\"{}\",{}]}}",
+        i, strings[i], doubles[i], strings[(i + 1) % NUM_VALUES],
+        ints[i]).size();
+}
+
+std::size_t json_sprintf(int i) {
+  return fmt::sprintf(
+        "{\"id\":%d,\"name\":\"%s\",\"score\":%.3f,\"tags\":[\"%s\",%d]}",
+        i, strings[i], doubles[i], strings[(i + 1) % NUM_VALUES],
+        ints[i]).size();
+}
+
+std::size_t json_writer(int i) {
+  writer.clear();
+  writer.write(
+        "{{\"id\":{},\"name\":\"{}\",\"score\":{:.3f},\"tags\":[\"{}\",{}]}}",
+        i, strings[i], doubles[i], strings[(i + 1) % NUM_VALUES], ints[i]);
+  return writer.size();
+}
+
+std::size_t json_snprintf(int i) {
+  return snprintf(
+        buffer, sizeof(buffer),
+        "{\"id\":%d,\"name\":\"%s\",\"score\":%.3f,\"tags\":[\"%s\",%d]}",
+        i, strings[i].c_str(), doubles[i],
+        strings[(i + 1) % NUM_VALUES].c_str(), ints[i]);
+}
+
+std::size_t json_ostream(int i) {
+  std::ostringstream os;
+  os << "{\"id\":" << i << ",\"name\":\"" << strings[i] << "\",\"score\":"
+     << std::fixed << std::setprecision(3) << doubles[i] << ",\"tags\":[\""
+     << strings[(i + 1) % NUM_VALUES] << "\"," << ints[i] << "]}";
+  return os.str().size();
+}
+
+struct Benchmark {
+  const char *name;
+  BenchFunc func;
+};
+
+#define FMT_BENCH(name, func) {name, func}
+
+const Benchmark BENCHMARKS[] = {
+  FMT_BENCH("int/format", int_format),
+  FMT_BENCH("int/sprintf", int_sprintf),
+  FMT_BENCH("int/MemoryWriter", int_writer),
+  FMT_BENCH("int/FormatInt", int_format_int),
+  FMT_BENCH("int/snprintf", int_snprintf),
+  FMT_BENCH("int/ostringstream", int_ostream),
+  FMT_BENCH("double/format", double_format),
+  FMT_BENCH("double/sprintf", double_sprintf),
+  FMT_BENCH("double/MemoryWriter", double_writer),
+  FMT_BENCH("double/snprintf", double_snprintf),
+  FMT_BENCH("double/ostringstream", double_ostream),
+  FMT_BENCH("string/format", string_format),
+  FMT_BENCH("string/sprintf", string_sprintf),
+  FMT_BENCH("string/MemoryWriter", string_writer),
+  FMT_BENCH("string/snprintf", string_snprintf),
+  FMT_BENCH("string/ostringstream", string_ostream),
+  FMT_BENCH("named/format", named_format),
+  FMT_BENCH("named/MemoryWriter", named_writer),
+  FMT_BENCH("named/snprintf", named_snprintf),
+  FMT_BENCH("padding/format", padding_format),
+  FMT_BENCH("padding/sprintf", padding_sprintf),
+  FMT_BENCH("padding/MemoryWriter", padding_writer),
+  FMT_BENCH("padding/snprintf", padding_snprintf),
+  FMT_BENCH("padding/ostringstream", padding_ostream),
+  FMT_BENCH("wide/format", wide_format),
+  FMT_BENCH("wide/MemoryWriter", wide_writer),
+  FMT_BENCH("wide/swprintf", wide_snprintf),
+  FMT_BENCH("wide/wostringstream", wide_ostream),
+  FMT_BENCH("large-args/format", large_format),
+  FMT_BENCH("large-args/sprintf", large_sprintf),
+  FMT_BENCH("large-args/MemoryWriter", large_writer),
+  FMT_BENCH("large-args/snprintf", large_snprintf),
+  FMT_BENCH("large-args/ostringstream", large_ostream),
+  FMT_BENCH("log-line/format", log_format),
+  FMT_BENCH("log-line/sprintf", log_sprintf),
+  FMT_BENCH("log-line/MemoryWriter", log_writer),
+  FMT_BENCH("log-line/snprintf", log_snprintf),
+  FMT_BENCH("log-line/ostringstream", log_ostream),
+  FMT_BENCH("csv-row/format", csv_format),
+  FMT_BENCH("csv-row/sprintf", csv_sprintf),
+  FMT_BENCH("csv-row/MemoryWriter", csv_writer),
+  FMT_BENCH("csv-row/snprintf", csv_snprintf),
+  FMT_BENCH("csv-row/ostringstream", csv_ostream),
+  FMT_BENCH("json/format", json_format),
+  FMT_BENCH("json/sprintf", json_sprintf),
+  FMT_BENCH("json/MemoryWriter", json_writer),
+  FMT_BENCH("json/snprintf", json_snprintf),
+  FMT_BENCH("json/ostringstream", json_ostream)
+};
+
+volatile std::size_t sink;
+
+// Returns the time of one call of func in nanoseconds. Runs func in
+// batches long enough to be timed reliably and takes the best of several
+// batches to filter out noise.
+double run(BenchFunc func, double min_batch_time) {
+  typedef std::chrono::steady_clock Clock;
+  double best = 0;
+  long num_iterations = 1;
+  for (int repeat = 0; repeat < 5;) {
+    std::size_t size = 0;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < num_iterations; ++i)
+      size += func(static_cast<int>(i % NUM_VALUES));
+    double elapsed = std::chrono::duration<double>(Clock::now() - start)
+                       .count();
+    sink = size;
+    if (elapsed < min_batch_time) {
+      num_iterations *= 2;
+      continue;
+    }
+    double time = elapsed * 1e9 / num_iterations;
+    if (repeat++ == 0 || time < best)
+      best = time;
+  }
+  return best;
+}
+
+long file_size(const char *filename) {
+  std::FILE *f = std::fopen(filename, "rb");
+  if (!f)
+    return -1;
+  std::fseek(f, 0, SEEK_END);
+  long size = std::ftell(f);
+  std::fclose(f);
+  return size;
+}
+
+struct Result {
+  std::string name;
+  double value;
+  const char *unit;
+};
+
+// Reads results in the output format of this program.
+std::map<std::string, double> read_results(const char *filename) {
+  std::map<std::string, double> results;
+  std::ifstream in(filename);
+  if (!in)
+    throw std::runtime_error(fmt::format("cannot open {}", filename));
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    std::string name;
+    double value = 0;
+    if (std::getline(fields, name, '\t') && fields >> value)
+      results[name] = value;
+  }
+  return results;
+}
+
+void usage() {
+  std::fputs(
+    "usage: fmt-bench [options]\n"
+    "Options:\n"
+    "  --filter STR      run only benchmarks whose names contain STR\n"
+    "  --time SECONDS    minimum time of a timed batch (default 0.02)\n"
+    "  --output FILE     write results to FILE\n"
+    "  --compare FILE    compare with results from FILE written by an\n"
+    "                    earlier run and fail if anything got slower\n"
+    "  --threshold PCT   allowed slowdown for --compare (default 10)\n"
+    "  --size NAME FILE1 FILEN\n"
+    "                    report the code size of one call site computed\n"
+    "                    from the sizes of FILE1 with one call site and\n"
+    "                    FILEN with --calls call sites\n"
+    "  --calls N         number of call sites in FILEN (default 50)\n"
+    "  --binary-size NAME FILE\n"
+    "                    report the size of FILE\n",
+    stderr);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *filter = "";
+  const char *output = 0;
+  const char *baseline = 0;
+  double min_batch_time = 0.02;
+  double threshold = 10;
+  long num_calls = 50;
+  std::vector<char**> sizes, binary_sizes;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    int num_values = arg == "--size" ? 3 : arg == "--binary-size" ? 2 : 1;
+    if (arg == "--help" || arg[0] != '-' || i + num_values >= argc) {
+      usage();
+      return arg == "--help" ? 0 : 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--filter") {
+      filter = value;
+    } else if (arg == "--time") {
+      min_batch_time = atof(value);
+    } else if (arg == "--output") {
+      output = value;
+    } else if (arg == "--compare") {
+      baseline = value;
+    } else if (arg == "--threshold") {
+      threshold = atof(value);
+    } else if (arg == "--calls") {
+      num_calls = atol(value);
+    } else if (arg == "--size") {
+      sizes.push_back(argv + i);
+      i += 2;
+    } else if (arg == "--binary-size") {
+      binary_sizes.push_back(argv + i);
+      ++i;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  init_values();
+  std::vector<Result> results;
+  for (std::size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(*BENCHMARKS); ++i) {
+    const Benchmark &b = BENCHMARKS[i];
+    if (!strstr(b.name, filter))
+      continue;
+    Result r = {b.name, run(b.func, min_batch_time), "ns"};
+    fmt::print("{:<28} {:10.1f} ns\n", r.name, r.value);
+    std::fflush(stdout);
+    results.push_back(r);
+  }
+  for (std::size_t i = 0; i < sizes.size(); ++i) {
+    char **args = sizes[i];
+    long size1 = file_size(args[1]), size_n = file_size(args[2]);
+    if (size1 < 0 || size_n < 0) {
+      fmt::print(stderr, "cannot get size of {} or {}\n", args[1], args[2]);
+      return 1;
+    }
+    Result r = {fmt::format("size/{}", args[0]),
+                static_cast<double>(size_n - size1) / (num_calls - 1),
+                "bytes"};
+    fmt::print("{:<28} {:10.1f} bytes per call\n", r.name, r.value);
+    results.push_back(r);
+  }
+  for (std::size_t i = 0; i < binary_sizes.size(); ++i) {
+    char **args = binary_sizes[i];
+    long size = file_size(args[1]);
+    if (size < 0) {
+      fmt::print(stderr, "cannot get size of {}\n", args[1]);
+      return 1;
+    }
+    Result r = {fmt::format("binary-size/{}", args[0]),
+                static_cast<double>(size), "bytes"};
+    fmt::print("{:<28} {:10} bytes\n", r.name, size);
+    results.push_back(r);
+  }
+
+  if (output) {
+    std::FILE *f = std::fopen(output, "w");
+    if (!f) {
+      fmt::print(stderr, "cannot open {}\n", output);
+      return 1;
+    }
+    fmt::print(f, "# name\tvalue\tunit\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const Result &r = results[i];
+      fmt::print(f, "{}\t{:.1f}\t{}\n", r.name, r.value, r.unit);
+    }
+    std::fclose(f);
+  }
+
+  if (!baseline)
+    return 0;
+  std::map<std::string, double> old_results = read_results(baseline);
+  int num_regressions = 0;
+  fmt::print("\n{:<28} {:>10} {:>10} {:>8}\n", "name", "baseline", "current",
+             "change");
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    std::map<std::string, double>::const_iterator it =
+        old_results.find(r.name);
+    if (it == old_results.end() || it->second <= 0)
+      continue;
+    double change = (r.value / it->second - 1) * 100;
+    bool regression = change > threshold;
+    if (regression)
+      ++num_regressions;
+    fmt::print("{:<28} {:10.1f} {:10.1f} {:+7.1f}%{}\n", r.name, it->second,
+               r.value, change, regression ? " REGRESSION" : "");
+  }
+  if (num_regressions != 0) {
+    fmt::print("{} result(s) regressed by more than {}%\n",
+               num_regressions, threshold);
+    return 1;
+  }
+  return 0;
+}
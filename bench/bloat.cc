@@ -0,0 +1,66 @@
+/*
+ A program with NUM_CALLS formatting call sites for measuring code bloat.
+ Define one of BLOAT_PRINTF, BLOAT_IOSTREAM, BLOAT_FMT_PRINT or
+ BLOAT_FMT_PRINTF to select the method.
+
+ Copyright (c) 2015, Victor Zverovich
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(BLOAT_PRINTF)
+# include <stdio.h>
+# define CALL(n) \
+  if (argc > n) printf("Value %d %g %s\n", argc + n, 1.5 * argc, argv[0]);
+#elif defined(BLOAT_IOSTREAM)
+# include <iostream>
+# define CALL(n) \
+  if (argc > n) \
+    std::cout << "Value " << argc + n << ' ' << 1.5 * argc << ' ' \
+              << argv[0] << '\n';
+#elif defined(BLOAT_FMT_PRINT)
+# include "format.h"
+# define CALL(n) \
+  if (argc > n) fmt::print("Value {} {} {}\n", argc + n, 1.5 * argc, argv[0]);
+#elif defined(BLOAT_FMT_PRINTF)
+# include "format.h"
+# define CALL(n) \
+  if (argc > n) \
+    fmt::printf("Value %d %g %s\n", argc + n, 1.5 * argc, argv[0]);
+#else
+# error "no formatting method selected"
+#endif
+
+#define CALL10(n) \
+  CALL(n##0) CALL(n##1) CALL(n##2) CALL(n##3) CALL(n##4) \
+  CALL(n##5) CALL(n##6) CALL(n##7) CALL(n##8) CALL(n##9)
+
+int main(int argc, char **argv) {
+#if NUM_CALLS == 1
+  CALL(1)
+#elif NUM_CALLS == 50
+  CALL10(1) CALL10(2) CALL10(3) CALL10(4) CALL10(5)
+#else
+# error "NUM_CALLS should be 1 or 50"
+#endif
+  return 0;
+}
@@ -34,6 +34,8 @@
 #include <climits>
 #include <cmath>
 #include <cstdarg>
+#include <cstdlib>
+#include <new>
 
 #if defined(_WIN32) && defined(__MINGW32__)
 # include <cstring>
@@ -84,6 +86,69 @@ using fmt::internal::Arg;
 # define FMT_FUNC
 #endif
 
+// Define FMT_USE_BUFFER_CACHE to 0 to disable reusing per-thread buffers
+// in the printing functions.
+#ifndef FMT_USE_BUFFER_CACHE
+# define FMT_USE_BUFFER_CACHE \
+   (FMT_HAS_FEATURE(cxx_thread_local) || \
+       (FMT_GCC_VERSION >= 408 && FMT_HAS_GXX_CXX11) || _MSC_VER >= 1900)
+#endif
+
+// The default maximum capacity of a per-thread buffer kept between calls.
+#ifndef FMT_BUFFER_CACHE_LIMIT
+# define FMT_BUFFER_CACHE_LIMIT 65536
+#endif
+
+#if FMT_USE_BUFFER_CACHE
+# include <atomic>
+#endif
+
+// Define FMT_USE_SIMD_SCAN to 0 to disable scanning format strings with
+// SSE2 or NEON instructions. Scanning reads aligned blocks that may extend
+// past the end of a string, which is safe because such blocks never cross
+// a page boundary, but is reported by AddressSanitizer, so it is disabled
+// in builds with the latter.
+#ifndef FMT_USE_SIMD_SCAN
+# if defined(__SANITIZE_ADDRESS__) || FMT_HAS_FEATURE(address_sanitizer)
+#  define FMT_USE_SIMD_SCAN 0
+# else
+#  define FMT_USE_SIMD_SCAN 1
+# endif
+#endif
+
+#if FMT_USE_PARALLEL_FORMAT
+# include <atomic>
+# include <condition_variable>
+# include <exception>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+#endif
+
+#if FMT_USE_STATS
+# include <atomic>
+# include <mutex>
+# include <vector>
+#endif
+
+#if FMT_USE_FORMAT_TIMING
+# include <chrono>
+# include <map>
+# include <unordered_map>
+#endif
+
+#if FMT_USE_SIMD_SCAN
+# if defined(__SSE2__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define FMT_SSE2 1
+# elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define FMT_NEON 1
+# endif
+#endif
+
 #if _MSC_VER
 # pragma warning(push)
 # pragma warning(disable: 4127)  // conditional expression is constant
@@ -251,10 +316,282 @@ class IsZeroInt : public fmt::internal::ArgVisitor<IsZeroInt, bool> {
   bool visit_any_int(T value) { return value == 0; }
 };
 
+// DefaultSizeVisitor::visit(arg) returns the size of arg formatted with an
+// empty format specification or 0 if the size can only be determined by
+// formatting the argument.
+class DefaultSizeVisitor :
+    public fmt::internal::ArgVisitor<DefaultSizeVisitor, std::size_t> {
+ private:
+  template <typename Char>
+  static std::size_t get_size(Arg::StringValue<Char> s) {
+    // A null string is reported as an error when formatted.
+    if (!s.value)
+      return 0;
+    return s.size != 0 ? s.size : std::char_traits<Char>::length(s.value);
+  }
+
+ public:
+  template <typename T>
+  std::size_t visit_any_int(T value) {
+    typename fmt::internal::IntTraits<T>::MainType abs_value = value;
+    std::size_t size = 0;
+    if (fmt::internal::is_negative(value)) {
+      abs_value = 0 - abs_value;
+      size = 1;
+    }
+    return size + fmt::internal::count_digits(abs_value);
+  }
+
+  std::size_t visit_bool(bool value) { return value ? 4 : 5; }
+  std::size_t visit_char(int) { return 1; }
+
+  std::size_t visit_string(Arg::StringValue<char> value) {
+    return get_size(value);
+  }
+  std::size_t visit_wstring(Arg::StringValue<wchar_t> value) {
+    return get_size(value);
+  }
+};
+
+// Returns a pointer to the first occurrence of c1, c2 or the terminating
+// null character in the string s.
+template <typename Char>
+inline const Char *find_special_scalar(const Char *s, Char c1, Char c2) {
+  for (;; ++s) {
+    Char c = *s;
+    if (c == c1 || c == c2 || !c)
+      return s;
+  }
+}
+
+// Returns a pointer to the first occurrence of c1 or c2 in [s, end) or end
+// if there is none.
+template <typename Char>
+inline const Char *find_special_scalar(
+    const Char *s, const Char *end, Char c1, Char c2) {
+  for (; s != end; ++s) {
+    if (*s == c1 || *s == c2)
+      break;
+  }
+  return s;
+}
+
+#if FMT_SSE2 || FMT_NEON
+enum { SIMD_BLOCK_SIZE = 16 };
+
+// Checks characters one by one until s is aligned on a block boundary
+// so that block loads don't cross a page boundary past the end of the
+// string. Returns true if the scan is complete.
+template <typename Char>
+inline bool align_scan(const Char *&s, Char c1, Char c2) {
+  for (; reinterpret_cast<uintptr_t>(s) % SIMD_BLOCK_SIZE != 0; ++s) {
+    Char c = *s;
+    if (c == c1 || c == c2 || !c)
+      return true;
+  }
+  return false;
+}
+
+inline unsigned count_trailing_zeros(unsigned n) {
+# ifdef _MSC_VER
+  unsigned long r = 0;
+  _BitScanForward(&r, n);
+  return r;
+# else
+  return __builtin_ctz(n);
+# endif
+}
+#endif
+
+#if FMT_SSE2
+// SSE2 operations on blocks of characters of the given size.
+template <std::size_t SIZE>
+struct Sse2Chars;
+
+template <>
+struct Sse2Chars<1> {
+  static __m128i set(int c) { return _mm_set1_epi8(static_cast<char>(c)); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+};
+
+template <>
+struct Sse2Chars<2> {
+  static __m128i set(int c) { return _mm_set1_epi16(static_cast<short>(c)); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+};
+
+template <>
+struct Sse2Chars<4> {
+  static __m128i set(int c) { return _mm_set1_epi32(c); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+};
+
+template <typename Char>
+const Char *find_special(const Char *s, Char c1, Char c2) {
+  if (sizeof(Char) > 4 || align_scan(s, c1, c2))
+    return find_special_scalar(s, c1, c2);
+  typedef Sse2Chars<sizeof(Char) <= 4 ? sizeof(Char) : 4> Chars;
+  __m128i v1 = Chars::set(c1), v2 = Chars::set(c2);
+  __m128i zero = _mm_setzero_si128();
+  for (;; s += SIMD_BLOCK_SIZE / sizeof(Char)) {
+    __m128i block = _mm_load_si128(reinterpret_cast<const __m128i*>(s));
+    __m128i matches = _mm_or_si128(
+          _mm_or_si128(Chars::eq(block, v1), Chars::eq(block, v2)),
+          Chars::eq(block, zero));
+    if (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches)))
+      return s + count_trailing_zeros(mask) / sizeof(Char);
+  }
+}
+
+template <typename Char>
+const Char *find_special(const Char *s, const Char *end, Char c1, Char c2) {
+  if (sizeof(Char) <= 4) {
+    typedef Sse2Chars<sizeof(Char) <= 4 ? sizeof(Char) : 4> Chars;
+    __m128i v1 = Chars::set(c1), v2 = Chars::set(c2);
+    enum { BLOCK_CHARS = SIMD_BLOCK_SIZE / sizeof(Char) };
+    for (; end - s >= BLOCK_CHARS; s += BLOCK_CHARS) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+      __m128i matches =
+          _mm_or_si128(Chars::eq(block, v1), Chars::eq(block, v2));
+      if (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches)))
+        return s + count_trailing_zeros(mask) / sizeof(Char);
+    }
+  }
+  return find_special_scalar(s, end, c1, c2);
+}
+#elif FMT_NEON
+inline const char *find_special(const char *s, char c1, char c2) {
+  if (align_scan(s, c1, c2))
+    return s;
+  uint8x16_t v1 = vdupq_n_u8(static_cast<uint8_t>(c1));
+  uint8x16_t v2 = vdupq_n_u8(static_cast<uint8_t>(c2));
+  uint8x16_t zero = vdupq_n_u8(0);
+  for (;; s += SIMD_BLOCK_SIZE) {
+    uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(s));
+    uint8x16_t matches = vorrq_u8(
+          vorrq_u8(vceqq_u8(block, v1), vceqq_u8(block, v2)),
+          vceqq_u8(block, zero));
+    // Narrow each 8-bit lane to 4 bits to get a 64-bit mask.
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+          vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (mask != 0)
+      return s + __builtin_ctzll(mask) / 4;
+  }
+}
+
+inline const char *find_special(
+    const char *s, const char *end, char c1, char c2) {
+  uint8x16_t v1 = vdupq_n_u8(static_cast<uint8_t>(c1));
+  uint8x16_t v2 = vdupq_n_u8(static_cast<uint8_t>(c2));
+  for (; end - s >= SIMD_BLOCK_SIZE; s += SIMD_BLOCK_SIZE) {
+    uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(s));
+    uint8x16_t matches = vorrq_u8(vceqq_u8(block, v1), vceqq_u8(block, v2));
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+          vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (mask != 0)
+      return s + __builtin_ctzll(mask) / 4;
+  }
+  return find_special_scalar(s, end, c1, c2);
+}
+
+template <typename Char>
+inline const Char *find_special(const Char *s, Char c1, Char c2) {
+  return find_special_scalar(s, c1, c2);
+}
+
+template <typename Char>
+inline const Char *find_special(
+    const Char *s, const Char *end, Char c1, Char c2) {
+  return find_special_scalar(s, end, c1, c2);
+}
+#else
+template <typename Char>
+inline const Char *find_special(const Char *s, Char c1, Char c2) {
+  return find_special_scalar(s, c1, c2);
+}
+
+template <typename Char>
+inline const Char *find_special(
+    const Char *s, const Char *end, Char c1, Char c2) {
+  return find_special_scalar(s, end, c1, c2);
+}
+#endif
+
+// Returns a pointer to the first character in [s, end) that cannot precede
+// the conversion type in a printf format specification. The printf parser
+// doesn't read past this character.
+template <typename Char>
+const Char *find_printf_type(const Char *s, const Char *end) {
+  for (; s != end; ++s) {
+    switch (*s) {
+    case '-': case '+': case ' ': case '#': case '$': case '*': case '.':
+    case 'h': case 'l': case 'j': case 'z': case 't': case 'L':
+      continue;
+    }
+    if (*s < '0' || *s > '9')
+      break;
+  }
+  return s;
+}
+
+// A replacement field of a format string that is not null-terminated.
+// The parsers rely on the terminating null character, so the field is
+// parsed in place if the parser is known to stop before the end of the
+// string and from a null-terminated copy of the rest of the string
+// otherwise. The copy is only made for malformed fields at the end of the
+// string, so it is allocated on demand.
+template <typename Char>
+class FormatField {
+ private:
+  const Char *start_;
+  const Char *data_;
+  Char *copy_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(FormatField);
+
+ public:
+  FormatField(const Char *s, const Char *end, bool in_place)
+  : start_(s), data_(s), copy_(0) {
+    if (in_place)
+      return;
+    std::size_t size = static_cast<std::size_t>(end - s);
+    copy_ = new Char[size + 1];
+    std::copy(s, end, fmt::internal::make_ptr(copy_, size));
+    copy_[size] = 0;
+    data_ = copy_;
+  }
+
+  ~FormatField() { delete [] copy_; }
+
+  // Returns the field data to parse.
+  const Char *data() const { return data_; }
+
+  // Converts a pointer into the data into a pointer into the format string.
+  const Char *map(const Char *p) const { return start_ + (p - data_); }
+};
+
+// Returns true if the replacement field whose content starts at s can be
+// parsed in place. The parser of format specifications reads at most one
+// character past the closing brace and only if it follows ':'. Fields are
+// usually short, so the closing brace is found with a simple loop rather
+// than find_special.
+template <typename Char>
+inline bool is_field_closed(const Char *s, const Char *end) {
+  for (int depth = 1; s != end; ++s) {
+    if (*s == '{') {
+      ++depth;
+    } else if (*s == '}' && --depth == 0) {
+      return s + 1 != end || s[-1] != ':';
+    }
+  }
+  return false;
+}
+
 // Parses an unsigned integer advancing s to the end of the parsed input.
 // This function assumes that the first character of s is a digit.
+// Sets error if the value doesn't fit in int.
 template <typename Char>
-int parse_nonnegative_int(const Char *&s) {
+int parse_nonnegative_int(const Char *&s, const char *&error) {
   assert('0' <= *s && *s <= '9');
   unsigned value = 0;
   do {
@@ -266,8 +603,19 @@ int parse_nonnegative_int(const Char *&s) {
     }
     value = new_value;
   } while ('0' <= *s && *s <= '9');
-  if (value > INT_MAX)
-    FMT_THROW(fmt::FormatError("number is too big"));
+  if (value > INT_MAX) {
+    error = "number is too big";
+    return 0;
+  }
+  return value;
+}
+
+template <typename Char>
+int parse_nonnegative_int(const Char *&s) {
+  const char *error = 0;
+  int value = parse_nonnegative_int(s, error);
+  if (error)
+    FMT_THROW(fmt::FormatError(error));
   return value;
 }
 
@@ -276,22 +624,57 @@ inline bool is_name_start(Char c) {
   return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || '_' == c;
 }
 
-inline void require_numeric_argument(const Arg &arg, char spec) {
-  if (arg.type > Arg::LAST_NUMERIC_TYPE) {
-    std::string message =
-        fmt::format("format specifier '{}' requires numeric argument", spec);
-    FMT_THROW(fmt::FormatError(message));
+// Returns an error message if the format specifier spec is not allowed
+// for arg because the latter is not numeric or a null pointer otherwise.
+inline const char *check_numeric_argument(const Arg &arg, char spec) {
+  if (arg.type <= Arg::LAST_NUMERIC_TYPE)
+    return 0;
+  switch (spec) {
+  case '=':
+    return "format specifier '=' requires numeric argument";
+  case '#':
+    return "format specifier '#' requires numeric argument";
+  case '0':
+    return "format specifier '0' requires numeric argument";
+  case '+':
+    return "format specifier '+' requires numeric argument";
+  case '-':
+    return "format specifier '-' requires numeric argument";
+  default:
+    return "format specifier ' ' requires numeric argument";
+  }
+}
+
+// Returns an error message if the sign specifier sign is not allowed for
+// arg or a null pointer otherwise.
+inline const char *check_sign_argument(const Arg &arg, char sign) {
+  if (const char *error = check_numeric_argument(arg, sign))
+    return error;
+  if (arg.type != Arg::UINT && arg.type != Arg::ULONG_LONG)
+    return 0;
+  switch (sign) {
+  case '+':
+    return "format specifier '+' requires signed argument";
+  case '-':
+    return "format specifier '-' requires signed argument";
+  default:
+    return "format specifier ' ' requires signed argument";
   }
 }
 
+inline void require_numeric_argument(const Arg &arg, char spec) {
+  const char *error = check_numeric_argument(arg, spec);
+  (void)error;
+  if (error)
+    FMT_THROW(fmt::FormatError(error));
+}
+
 template <typename Char>
 void check_sign(const Char *&s, const Arg &arg) {
-  char sign = static_cast<char>(*s);
-  require_numeric_argument(arg, sign);
-  if (arg.type == Arg::UINT || arg.type == Arg::ULONG_LONG) {
-    FMT_THROW(fmt::FormatError(fmt::format(
-      "format specifier '{}' requires signed argument", sign)));
-  }
+  const char *error = check_sign_argument(arg, static_cast<char>(*s));
+  (void)error;
+  if (error)
+    FMT_THROW(fmt::FormatError(error));
   ++s;
 }
 
@@ -396,96 +779,1125 @@ class CharConverter : public fmt::internal::ArgVisitor<CharConverter, void> {
     arg_.int_value = static_cast<char>(value);
   }
 };
-}  // namespace
 
-namespace internal {
+// Length modifiers of printf format specifications.
+enum LengthModifier {
+  LENGTH_NONE, LENGTH_HH, LENGTH_H, LENGTH_L, LENGTH_LL, LENGTH_J, LENGTH_Z,
+  LENGTH_T, LENGTH_BIG_L
+};
 
-template <typename Impl, typename Char>
-class BasicArgFormatter : public ArgVisitor<Impl, void> {
- private:
-  BasicWriter<Char> &writer_;
-  FormatSpec &spec_;
+// A bit mask of the length modifier characters relative to 'A'.
+const uint64_t LENGTH_MODIFIER_MASK =
+    (static_cast<uint64_t>(1) << ('h' - 'A')) |
+    (static_cast<uint64_t>(1) << ('j' - 'A')) |
+    (static_cast<uint64_t>(1) << ('l' - 'A')) |
+    (static_cast<uint64_t>(1) << ('t' - 'A')) |
+    (static_cast<uint64_t>(1) << ('z' - 'A')) |
+    (static_cast<uint64_t>(1) << ('L' - 'A'));
+
+// Returns true if c is the conversion type of a printf format specification
+// that has no flags, width, precision, length modifier or argument index,
+// such as "%d" or "%s". Flags, digits, '*', '.' and '$' all precede 'A'
+// so letters other than length modifiers can only be conversion types.
+template <typename Char>
+inline bool is_simple_printf_type(Char c) {
+  unsigned offset = static_cast<unsigned>(c) - 'A';
+  return offset <= 'z' - 'A' && ((LENGTH_MODIFIER_MASK >> offset) & 1) == 0;
+}
 
-  FMT_DISALLOW_COPY_AND_ASSIGN(BasicArgFormatter);
+// Parses a printf length modifier advancing s past it.
+template <typename Char>
+char parse_length(const Char *&s) {
+  switch (*s++) {
+  case 'h':
+    if (*s != 'h')
+      return LENGTH_H;
+    ++s;
+    return LENGTH_HH;
+  case 'l':
+    if (*s != 'l')
+      return LENGTH_L;
+    ++s;
+    return LENGTH_LL;
+  case 'j':
+    return LENGTH_J;
+  case 'z':
+    return LENGTH_Z;
+  case 't':
+    return LENGTH_T;
+  case 'L':
+    return LENGTH_BIG_L;
+  default:
+    --s;
+    return LENGTH_NONE;
+  }
+}
 
- protected:
-  BasicWriter<Char> &writer() { return writer_; }
-  const FormatSpec &spec() const { return spec_; }
+// Returns true if an integer argument already has the type it would be
+// converted to for a printf length modifier and a conversion type, so the
+// conversion is a no-op.
+inline bool has_printf_type(const Arg &arg, char length, wchar_t type) {
+  bool is_signed = type == 'd' || type == 'i';
+  if (length == LENGTH_LL || (length == LENGTH_L && sizeof(long) > sizeof(int)))
+    return arg.type == (is_signed ? Arg::LONG_LONG : Arg::ULONG_LONG);
+  if (length == LENGTH_NONE || length == LENGTH_L)
+    return arg.type == (is_signed ? Arg::INT : Arg::UINT);
+  return false;
+}
 
- public:
-  BasicArgFormatter(BasicWriter<Char> &w, FormatSpec &s)
-  : writer_(w), spec_(s) {}
+// Converts an argument to the type specified by a printf length modifier.
+void convert_arg(Arg &arg, char length, wchar_t type) {
+  if (arg.type > Arg::LAST_INTEGER_TYPE || has_printf_type(arg, length, type))
+    return;
+  switch (length) {
+  case LENGTH_HH:
+    ArgConverter<signed char>(arg, type).visit(arg);
+    break;
+  case LENGTH_H:
+    ArgConverter<short>(arg, type).visit(arg);
+    break;
+  case LENGTH_L:
+    ArgConverter<long>(arg, type).visit(arg);
+    break;
+  case LENGTH_LL:
+    ArgConverter<fmt::LongLong>(arg, type).visit(arg);
+    break;
+  case LENGTH_J:
+    ArgConverter<intmax_t>(arg, type).visit(arg);
+    break;
+  case LENGTH_Z:
+    ArgConverter<size_t>(arg, type).visit(arg);
+    break;
+  case LENGTH_T:
+    ArgConverter<ptrdiff_t>(arg, type).visit(arg);
+    break;
+  case LENGTH_BIG_L:
+    // printf produces garbage when 'L' is omitted for long double, no
+    // need to do the same.
+    break;
+  default:
+    ArgConverter<int>(arg, type).visit(arg);
+  }
+}
 
-  template <typename T>
-  void visit_any_int(T value) { writer_.write_int(value, spec_); }
+// Returns the value of an argument used as a dynamic width or precision.
+// Sets error if the argument is not a valid width or precision.
+unsigned get_dynamic_spec(const Arg &arg, bool is_width, const char *&error) {
+  fmt::ULongLong value = 0;
+  const char *negative_error =
+      is_width ? "negative width" : "negative precision";
+  switch (arg.type) {
+  case Arg::INT:
+    if (arg.int_value < 0)
+      error = negative_error;
+    value = arg.int_value;
+    break;
+  case Arg::UINT:
+    value = arg.uint_value;
+    break;
+  case Arg::LONG_LONG:
+    if (arg.long_long_value < 0)
+      error = negative_error;
+    value = arg.long_long_value;
+    break;
+  case Arg::ULONG_LONG:
+    value = arg.ulong_long_value;
+    break;
+  default:
+    error = is_width ? "width is not integer" : "precision is not integer";
+  }
+  if (!error && value > INT_MAX)
+    error = "number is too big";
+  return error ? 0 : static_cast<unsigned>(value);
+}
 
-  template <typename T>
-  void visit_any_double(T value) { writer_.write_double(value, spec_); }
+unsigned get_dynamic_spec(const Arg &arg, bool is_width) {
+  const char *error = 0;
+  unsigned value = get_dynamic_spec(arg, is_width, error);
+  if (error)
+    FMT_THROW(fmt::FormatError(error));
+  return value;
+}
 
-  void visit_bool(bool value) {
-    if (spec_.type_) {
-      writer_.write_int(value, spec_);
-      return;
-    }
-    const char *str_value = value ? "true" : "false";
-    Arg::StringValue<char> str = { str_value, strlen(str_value) };
-    writer_.write_str(str, spec_);
+inline bool is_int_type_code(char type) {
+  switch (type) {
+  case 0: case 'd': case 'x': case 'X': case 'b': case 'B': case 'o':
+    return true;
   }
+  return false;
+}
 
-  void visit_char(int value) {
-    if (spec_.type_ && spec_.type_ != 'c') {
-      spec_.flags_ |= CHAR_FLAG;
-      writer_.write_int(value, spec_);
-      return;
+inline bool is_double_type_code(char type) {
+  switch (type) {
+  case 0: case 'e': case 'f': case 'g': case 'a':
+  case 'E': case 'F': case 'G': case 'A':
+    return true;
+  }
+  return false;
+}
+
+// Checks that an argument can be formatted according to spec with
+// ArgFormatter, so that the latter doesn't throw. Mirrors the checks done
+// by BasicArgFormatter and BasicWriter. Returns false and sets error if
+// the argument cannot be formatted.
+bool check_arg(const Arg &arg, const fmt::FormatSpec &spec,
+               fmt::internal::FormatErrorInfo &error) {
+  char type = spec.type_;
+  switch (arg.type) {
+  case Arg::CHAR:
+    if (!type || type == 'c') {
+      if (spec.align_ != fmt::ALIGN_NUMERIC && spec.flags_ == 0)
+        return true;
+      error.message = "invalid format specifier for char";
+      return false;
     }
-    if (spec_.align_ == ALIGN_NUMERIC || spec_.flags_ != 0)
-      FMT_THROW(FormatError("invalid format specifier for char"));
-    typedef typename BasicWriter<Char>::CharPtr CharPtr;
-    Char fill = internal::CharTraits<Char>::cast(spec_.fill());
-    CharPtr out = CharPtr();
-    if (spec_.width_ > 1) {
-      out = writer_.grow_buffer(spec_.width_);
-      if (spec_.align_ == ALIGN_RIGHT) {
-        std::fill_n(out, spec_.width_ - 1, fill);
-        out += spec_.width_ - 1;
-      } else if (spec_.align_ == ALIGN_CENTER) {
-        out = writer_.fill_padding(out, spec_.width_, 1, fill);
-      } else {
-        std::fill_n(out + 1, spec_.width_ - 1, fill);
-      }
-    } else {
-      out = writer_.grow_buffer(1);
+    if (is_int_type_code(type))
+      return true;
+    error.message = "unknown format code for char";
+    error.type_name = "char";
+    break;
+  case Arg::INT: case Arg::UINT: case Arg::LONG_LONG: case Arg::ULONG_LONG:
+  case Arg::BOOL:
+    if (is_int_type_code(type))
+      return true;
+    error.message = "unknown format code for integer";
+    error.type_name = "integer";
+    break;
+  case Arg::DOUBLE: case Arg::LONG_DOUBLE:
+    if (is_double_type_code(type))
+      return true;
+    error.message = "unknown format code for floating-point number";
+    error.type_name = "double";
+    break;
+  case Arg::CSTRING: case Arg::STRING: case Arg::WSTRING: {
+    if (type && type != 's') {
+      error.message = "unknown format code for string";
+      error.type_name = "string";
+      break;
     }
-    *out = internal::CharTraits<Char>::cast(value);
+    bool is_null = arg.type == Arg::WSTRING ?
+          !arg.wstring.value && arg.wstring.size == 0 :
+          !arg.string.value && (arg.type == Arg::CSTRING || !arg.string.size);
+    if (!is_null)
+      return true;
+    error.message = "string pointer is null";
+    return false;
   }
-
-  void visit_string(Arg::StringValue<char> value) {
-    writer_.write_str(value, spec_);
+  case Arg::POINTER:
+    if (!type || type == 'p')
+      return true;
+    error.message = "unknown format code for pointer";
+    error.type_name = "pointer";
+    break;
+  default:
+    return true;
   }
+  error.code = type;
+  return false;
+}
 
-  using ArgVisitor<Impl, void>::visit_wstring;
+// Throws an error detected by a formatting function that doesn't throw.
+void throw_format_error(const fmt::internal::FormatErrorInfo &error) {
+  if (error.type_name)
+    fmt::internal::report_unknown_type(error.code, error.type_name);
+  FMT_THROW(fmt::FormatError(error.message));
+}
 
-  void visit_wstring(Arg::StringValue<Char> value) {
-    writer_.write_str(value, spec_);
+// Assigns argument indices in a compiled format string using the same rules
+// as FormatterBase.
+class ArgIndexer {
+ private:
+  int next_arg_index_;
+
+ public:
+  ArgIndexer() : next_arg_index_(0) {}
+
+  unsigned next_arg(const char *&error) {
+    if (next_arg_index_ >= 0)
+      return next_arg_index_++;
+    error = "cannot switch from manual to automatic argument indexing";
+    return 0;
   }
 
-  void visit_pointer(const void *value) {
-    if (spec_.type_ && spec_.type_ != 'p')
-      report_unknown_type(spec_.type_, "pointer");
-    spec_.flags_ = HASH_FLAG;
-    spec_.type_ = 'x';
-    writer_.write_int(reinterpret_cast<uintptr_t>(value), spec_);
+  bool check_no_auto_index(const char *&error) {
+    if (next_arg_index_ > 0) {
+      error = "cannot switch from automatic to manual argument indexing";
+      return false;
+    }
+    next_arg_index_ = -1;
+    return true;
+  }
+
+  unsigned get_arg(unsigned arg_index, const char *&error) {
+    check_no_auto_index(error);
+    return arg_index;
   }
 };
 
-// An argument formatter.
+// Parses an argument index or name in a compiled format string.
 template <typename Char>
-class ArgFormatter : public BasicArgFormatter<ArgFormatter<Char>, Char> {
- private:
-  BasicFormatter<Char> &formatter_;
-  const Char *format_;
-
- public:
+fmt::internal::ArgRef parse_arg_ref(
+    const Char *&s, const Char *format, ArgIndexer &indexer) {
+  using fmt::internal::ArgRef;
+  const char *error = 0;
+  if (is_name_start(*s)) {
+    const Char *start = s;
+    Char c;
+    do {
+      c = *++s;
+    } while (is_name_start(c) || ('0' <= c && c <= '9'));
+    if (!indexer.check_no_auto_index(error))
+      FMT_THROW(fmt::FormatError(error));
+    return ArgRef(ArgRef::NAME, static_cast<unsigned>(start - format),
+                  static_cast<unsigned>(s - start));
+  }
+  unsigned index = *s < '0' || *s > '9' ? indexer.next_arg(error) :
+        indexer.get_arg(parse_nonnegative_int(s), error);
+  if (error) {
+    FMT_THROW(fmt::FormatError(
+                *s != '}' && *s != ':' ? "invalid format string" : error));
+  }
+  return ArgRef(ArgRef::INDEX, index);
+}
+
+// Parses a format specification of a compiled format string and returns
+// a pointer past the closing brace or a null pointer if the specification
+// cannot be parsed without knowing the argument type.
+template <typename Char>
+const Char *parse_compiled_spec(const Char *s, const Char *format,
+                                fmt::internal::FormatItem &item,
+                                ArgIndexer &indexer) {
+  using fmt::internal::FormatItem;
+  fmt::FormatSpec &spec = item.spec;
+  item.spec_offset = s - format;
+  if (*s == ':') {
+    ++s;
+    // Parse fill and alignment.
+    if (Char c = *s) {
+      const Char *p = s + 1;
+      spec.align_ = fmt::ALIGN_DEFAULT;
+      do {
+        switch (*p) {
+          case '<':
+            spec.align_ = fmt::ALIGN_LEFT;
+            break;
+          case '>':
+            spec.align_ = fmt::ALIGN_RIGHT;
+            break;
+          case '=':
+            spec.align_ = fmt::ALIGN_NUMERIC;
+            break;
+          case '^':
+            spec.align_ = fmt::ALIGN_CENTER;
+            break;
+        }
+        if (spec.align_ != fmt::ALIGN_DEFAULT) {
+          if (p != s) {
+            if (c == '}') break;
+            if (c == '{')
+              return 0;
+            s += 2;
+            spec.fill_ = c;
+          } else ++s;
+          if (spec.align_ == fmt::ALIGN_NUMERIC)
+            item.flags |= FormatItem::CHECK_NUMERIC_ALIGN;
+          break;
+        }
+      } while (--p >= s);
+    }
+
+    // Parse sign.
+    switch (*s) {
+      case '+':
+        item.sign = '+';
+        spec.flags_ |= fmt::SIGN_FLAG | fmt::PLUS_FLAG;
+        ++s;
+        break;
+      case '-':
+        item.sign = '-';
+        spec.flags_ |= fmt::MINUS_FLAG;
+        ++s;
+        break;
+      case ' ':
+        item.sign = ' ';
+        spec.flags_ |= fmt::SIGN_FLAG;
+        ++s;
+        break;
+    }
+
+    if (*s == '#') {
+      item.flags |= FormatItem::CHECK_HASH;
+      spec.flags_ |= fmt::HASH_FLAG;
+      ++s;
+    }
+
+    // Parse zero flag.
+    if (*s == '0') {
+      item.flags |= FormatItem::CHECK_ZERO;
+      spec.align_ = fmt::ALIGN_NUMERIC;
+      spec.fill_ = '0';
+      ++s;
+    }
+
+    // Parse width.
+    if ('0' <= *s && *s <= '9') {
+      spec.width_ = parse_nonnegative_int(s);
+    } else if (*s == '{') {
+      ++s;
+      item.width_arg = parse_arg_ref(s, format, indexer);
+      if (*s++ != '}')
+        return 0;
+    }
+
+    // Parse precision.
+    if (*s == '.') {
+      ++s;
+      spec.precision_ = 0;
+      if ('0' <= *s && *s <= '9') {
+        spec.precision_ = parse_nonnegative_int(s);
+      } else if (*s == '{') {
+        ++s;
+        item.precision_arg = parse_arg_ref(s, format, indexer);
+        if (*s++ != '}')
+          return 0;
+      } else {
+        return 0;
+      }
+      item.flags |= FormatItem::CHECK_PRECISION;
+    }
+
+    // Parse type.
+    if (*s != '}' && *s)
+      spec.type_ = static_cast<char>(*s++);
+  }
+  return *s++ == '}' ? s : 0;
+}
+
+// Returns an argument referenced from a compiled format string.
+// Named arguments are taken from named_args indexed by the name index.
+inline Arg get_compiled_arg(const fmt::ArgList &args, const Arg *named_args,
+                            const fmt::internal::ArgRef &ref) {
+  if (ref.kind == fmt::internal::ArgRef::NAME) {
+    const Arg &arg = named_args[ref.index];
+    if (arg.type == Arg::NONE)
+      FMT_THROW(fmt::FormatError("argument not found"));
+    return arg;
+  }
+  Arg arg = args[ref.index];
+  switch (arg.type) {
+  case Arg::NONE:
+    FMT_THROW(fmt::FormatError("argument index out of range"));
+  case Arg::NAMED_ARG:
+    arg = *static_cast<const Arg*>(arg.pointer);
+  default:
+    /*nothing*/;
+  }
+  return arg;
+}
+
+// Returns a reference to a printf argument with the specified index or,
+// if arg_index is equal to the maximum unsigned value, the next argument.
+template <typename Char>
+fmt::internal::ArgRef get_printf_arg_ref(
+    const Char *s, ArgIndexer &indexer, unsigned arg_index = UINT_MAX) {
+  (void)s;
+  const char *error = 0;
+  unsigned index = arg_index == UINT_MAX ?
+        indexer.next_arg(error) : indexer.get_arg(arg_index - 1, error);
+  if (error)
+    FMT_THROW(fmt::FormatError(!*s ? "invalid format string" : error));
+  return fmt::internal::ArgRef(fmt::internal::ArgRef::INDEX, index);
+}
+
+const uint32_t POWERS_OF_10[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// A floating-point number f * pow(2, e) with a 64-bit significand used by
+// the Grisu algorithm. See "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers" by Florian Loitsch.
+struct DiyFP {
+  enum {
+    SIGNIFICAND_SIZE = 64,
+    // The number of explicitly stored significand bits in a double.
+    DOUBLE_SIGNIFICAND_SIZE = std::numeric_limits<double>::digits - 1,
+    EXPONENT_BIAS = std::numeric_limits<double>::max_exponent - 1 +
+                    DOUBLE_SIGNIFICAND_SIZE,
+    // The number of explicitly stored significand bits in a float.
+    FLOAT_SIGNIFICAND_SIZE = std::numeric_limits<float>::digits - 1,
+    // The exponent of the smallest normal float.
+    FLOAT_MIN_EXPONENT = std::numeric_limits<float>::min_exponent - 1
+  };
+
+  uint64_t f;
+  int e;
+
+  DiyFP() : f(0), e(0) {}
+  DiyFP(uint64_t f_value, int e_value) : f(f_value), e(e_value) {}
+
+  static uint64_t implicit_bit() {
+    return static_cast<uint64_t>(1) << DOUBLE_SIGNIFICAND_SIZE;
+  }
+
+  // Constructs a DiyFP object from a finite positive IEEE 754 double.
+  explicit DiyFP(double d) {
+    uint64_t u = 0;
+    memcpy(&u, &d, sizeof(d));
+    int biased_e = static_cast<int>(u >> DOUBLE_SIGNIFICAND_SIZE) & 0x7ff;
+    f = u & (implicit_bit() - 1);
+    if (biased_e != 0) {
+      f += implicit_bit();
+      e = biased_e - EXPONENT_BIAS;
+    } else {
+      e = 1 - EXPONENT_BIAS;  // Subnormal.
+    }
+  }
+
+  // Returns the value shifted so that the most significant bit of f is set.
+  DiyFP normalize() const {
+    DiyFP result = *this;
+    while ((result.f & implicit_bit()) == 0) {  // Subnormals only.
+      result.f <<= 1;
+      --result.e;
+    }
+    int shift = SIGNIFICAND_SIZE - DOUBLE_SIGNIFICAND_SIZE - 1;
+    result.f <<= shift;
+    result.e -= shift;
+    return result;
+  }
+
+  // Computes the boundaries of the rounding interval of this number, with
+  // the upper boundary normalized and the lower one having the same exponent.
+  void compute_boundaries(DiyFP &lower, DiyFP &upper) const {
+    upper = DiyFP((f << 1) + 1, e - 1);
+    while ((upper.f & (implicit_bit() << 1)) == 0) {
+      upper.f <<= 1;
+      --upper.e;
+    }
+    int shift = SIGNIFICAND_SIZE - DOUBLE_SIGNIFICAND_SIZE - 2;
+    upper.f <<= shift;
+    upper.e -= shift;
+    // The lower boundary is closer if the significand is a power of 2.
+    lower = f == implicit_bit() ?
+          DiyFP((f << 2) - 1, e - 2) : DiyFP((f << 1) - 1, e - 1);
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+  }
+
+  // Same as compute_boundaries but for the rounding interval of a float
+  // equal to this number.
+  void compute_float_boundaries(DiyFP &lower, DiyFP &upper) const {
+    DiyFP v = normalize();
+    // The exponents of the most significant bit and of the unit in the last
+    // place of the float.
+    int msb_e = v.e + SIGNIFICAND_SIZE - 1;
+    int ulp_e = (std::max)(msb_e, static_cast<int>(FLOAT_MIN_EXPONENT)) -
+        FLOAT_SIGNIFICAND_SIZE;
+    // Represent the number and the boundaries as multiples of a quarter ulp.
+    int e = ulp_e - 2;
+    uint64_t quarters = v.f >> (e - v.e);
+    upper = DiyFP(quarters + 2, e);
+    while ((upper.f >> (SIGNIFICAND_SIZE - 1)) == 0) {
+      upper.f <<= 1;
+      --upper.e;
+    }
+    // The lower boundary is closer if the significand is a power of 2.
+    bool closer = v.f == implicit_bit() << (SIGNIFICAND_SIZE - 1 -
+        DOUBLE_SIGNIFICAND_SIZE) && msb_e > FLOAT_MIN_EXPONENT;
+    lower = DiyFP(quarters - (closer ? 1 : 2), e);
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+  }
+};
+
+// Returns an approximation of x * y rounded to 64 bits.
+inline DiyFP operator*(DiyFP x, DiyFP y) {
+  // Multiply 32-bit parts of significands.
+  uint64_t mask = (static_cast<uint64_t>(1) << 32) - 1;
+  uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  // Compute mid 64-bit of result and round.
+  uint64_t mid = (bd >> 32) + (ad & mask) + (bc & mask) + (1u << 31);
+  return DiyFP(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+// Returns a cached power of 10 c such that the binary exponent of x * c,
+// where x is a normalized DiyFP with exponent e, is in the range [-60, -32].
+// Stores the decimal exponent of c in pow10_exp.
+inline DiyFP get_cached_power(int e, int &pow10_exp) {
+  const double ONE_OVER_LOG2_10 = 0.30102999566398114;  // 1 / log2(10)
+  const int FIRST_DEC_EXP = -348, DEC_EXP_STEP = 8;
+  // dk is always positive, so the ceiling can be computed by truncation.
+  double dk = (-61 - e) * ONE_OVER_LOG2_10 - FIRST_DEC_EXP - 1;
+  int k = static_cast<int>(dk);
+  if (dk - k > 0.0)
+    ++k;
+  int index = k / DEC_EXP_STEP + 1;
+  pow10_exp = FIRST_DEC_EXP + index * DEC_EXP_STEP;
+  typedef fmt::internal::Data Data;
+  return DiyFP(Data::POW10_SIGNIFICANDS[index], Data::POW10_EXPONENTS[index]);
+}
+
+// Moves the last digit towards w and checks that the result is in the safe
+// interval. Returns false if the result may be incorrect.
+bool grisu_round_weed(char *buffer, int size, uint64_t distance_too_high_w,
+                       uint64_t unsafe_interval, uint64_t rest,
+                       uint64_t ten_kappa, uint64_t unit) {
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+  while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+         (rest + ten_kappa < small_distance ||
+          small_distance - rest >= rest + ten_kappa - small_distance)) {
+    --buffer[size - 1];
+    rest += ten_kappa;
+  }
+  // Check if the digit could be moved even closer to w in which case it is
+  // impossible to tell which candidate is the closest.
+  if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+      (rest + ten_kappa < big_distance ||
+       big_distance - rest > rest + ten_kappa - big_distance)) {
+    return false;
+  }
+  return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+// Generates the shortest sequence of digits within the interval
+// (low, high) that is the closest to w (Grisu3). Returns false if the
+// result cannot be guaranteed to be shortest and closest.
+bool grisu_gen_shortest(DiyFP low, DiyFP w, DiyFP high,
+                       char *buffer, int &size, int &exp) {
+  // low, w and high are imprecise by less than one unit, so too_low and
+  // too_high are guaranteed to lie outside the rounding interval.
+  uint64_t unit = 1;
+  uint64_t too_high = high.f + unit;
+  uint64_t unsafe_interval = too_high - (low.f - unit);
+  DiyFP one(static_cast<uint64_t>(1) << -w.e, w.e);
+  uint32_t integral = static_cast<uint32_t>(too_high >> -one.e);
+  uint64_t fractional = too_high & (one.f - 1);
+  int kappa = fmt::internal::count_digits(integral);
+  uint32_t divisor = POWERS_OF_10[kappa - 1];
+  size = 0;
+  while (kappa > 0) {
+    buffer[size++] = static_cast<char>('0' + integral / divisor);
+    integral %= divisor;
+    --kappa;
+    uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+    if (rest < unsafe_interval) {
+      exp += kappa;
+      return grisu_round_weed(buffer, size, too_high - w.f, unsafe_interval,
+          rest, static_cast<uint64_t>(divisor) << -one.e, unit);
+    }
+    divisor /= 10;
+  }
+  for (;;) {
+    fractional *= 10;
+    unit *= 10;
+    unsafe_interval *= 10;
+    buffer[size++] = static_cast<char>('0' + (fractional >> -one.e));
+    fractional &= one.f - 1;
+    --kappa;
+    if (fractional < unsafe_interval) {
+      exp += kappa;
+      return grisu_round_weed(buffer, size, (too_high - w.f) * unit,
+          unsafe_interval, fractional, one.f, unit);
+    }
+  }
+}
+
+// Formats value with the smallest number of digits that round-trip using
+// snprintf. This is used for numbers rejected by Grisu3 and relies on the
+// fact that rounding to 15 digits (6 for a float) gives the shortest
+// representation if it has at most that many digits.
+void format_shortest_exact(double value, char *buffer, int &size, int &exp,
+                           bool single_precision) {
+  char s[32];
+  int max_precision = single_precision ? 8 : 16;
+  for (int precision = single_precision ? 5 : 14; ; ++precision) {
+    FMT_SNPRINTF(s, sizeof(s), "%.*e", precision, value);
+    double parsed = std::strtod(s, 0);
+    if (precision == max_precision || (single_precision ?
+          static_cast<float>(parsed) == value : parsed == value)) {
+      break;
+    }
+  }
+  const char *p = s;
+  size = 0;
+  for (; *p != 'e'; ++p) {
+    if ('0' <= *p && *p <= '9')
+      buffer[size++] = *p;
+  }
+  exp = std::atoi(p + 1) - (size - 1);
+  while (size > 1 && buffer[size - 1] == '0') {
+    --size;
+    ++exp;
+  }
+}
+
+// Generates the shortest sequence of digits of value that lies within the
+// rounding interval (lower, upper).
+void grisu_format_shortest(double value, DiyFP lower, DiyFP upper,
+                           bool single_precision,
+                           char *buffer, int &size, int &exp) {
+  int pow10_exp = 0;
+  DiyFP c = get_cached_power(upper.e, pow10_exp);
+  DiyFP w = DiyFP(value).normalize() * c;
+  upper = upper * c;
+  lower = lower * c;
+  exp = -pow10_exp;
+  // Grisu3 rejects about 0.5% of numbers for which it cannot guarantee
+  // the shortest and closest result.
+  if (!grisu_gen_shortest(lower, w, upper, buffer, size, exp))
+    format_shortest_exact(value, buffer, size, exp, single_precision);
+}
+
+// Rounds the digits in buffer given the rest of w, the value of the unit
+// in the last place 10^kappa and the error of w. Returns false if it is
+// impossible to decide which way to round.
+bool grisu_round_counted(char *buffer, int size, uint64_t rest,
+                         uint64_t ten_kappa, uint64_t error, int &exp) {
+  if (error >= ten_kappa || ten_kappa - error <= error)
+    return false;
+  // Round down if 2 * (rest + error) <= 10^kappa.
+  if (ten_kappa - rest > rest && ten_kappa - 2 * rest >= 2 * error)
+    return true;
+  // Round up if 2 * (rest - error) >= 10^kappa.
+  if (rest <= error || ten_kappa - (rest - error) > (rest - error))
+    return false;
+  ++buffer[size - 1];
+  for (int i = size - 1; i > 0 && buffer[i] > '9'; --i) {
+    buffer[i] = '0';
+    ++buffer[i - 1];
+  }
+  if (buffer[0] > '9') {
+    // All digits were 9s, e.g. 99 became 100 which is 10 * 10^1.
+    buffer[0] = '1';
+    ++exp;
+  }
+  return true;
+}
+
+// Generates the requested number of correctly rounded digits of w, which
+// has an error of at most 1 unit in the last place (Grisu counted mode).
+// Stores the number of requested digits in num_digits.
+bool grisu_gen_counted(DiyFP w, int precision, bool fixed,
+                       char *buffer, int &size, int &exp, int &num_digits) {
+  uint64_t error = 1;
+  DiyFP one(static_cast<uint64_t>(1) << -w.e, w.e);
+  uint32_t integral = static_cast<uint32_t>(w.f >> -one.e);
+  uint64_t fractional = w.f & (one.f - 1);
+  int kappa = fmt::internal::count_digits(integral);
+  num_digits = fixed ? exp + kappa + precision : precision;
+  if (num_digits <= 0 || num_digits > fmt::internal::MAX_GRISU_DIGITS)
+    return false;
+  int digits_left = num_digits;
+  size = 0;
+  uint32_t divisor = POWERS_OF_10[kappa - 1];
+  for (;;) {
+    buffer[size++] = static_cast<char>('0' + integral / divisor);
+    integral %= divisor;
+    --kappa;
+    if (--digits_left == 0) {
+      uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+      exp += kappa;
+      return grisu_round_counted(buffer, size, rest,
+          static_cast<uint64_t>(divisor) << -one.e, error, exp);
+    }
+    if (kappa == 0)
+      break;
+    divisor /= 10;
+  }
+  while (digits_left > 0 && fractional > error) {
+    fractional *= 10;
+    error *= 10;
+    buffer[size++] = static_cast<char>('0' + (fractional >> -one.e));
+    fractional &= one.f - 1;
+    --kappa;
+    --digits_left;
+  }
+  if (digits_left != 0)
+    return false;
+  exp += kappa;
+  return grisu_round_counted(buffer, size, fractional, one.f, error, exp);
+}
+
+typedef fmt::internal::MemoryBuffer<char, fmt::internal::INLINE_BUFFER_SIZE>
+    PrintMemoryBuffer;
+
+#if FMT_USE_BUFFER_CACHE
+std::atomic<std::size_t> buffer_cache_limit(FMT_BUFFER_CACHE_LIMIT);
+
+// Set when the calling thread's buffer cache has been destroyed so that
+// printing from destructors of other thread-local or static objects doesn't
+// access it.
+thread_local bool buffer_cache_destroyed = false;
+
+struct BufferCache {
+  PrintMemoryBuffer buffer;
+  bool in_use;
+
+  BufferCache() : in_use(false) {}
+  ~BufferCache() { buffer_cache_destroyed = true; }
+};
+
+thread_local BufferCache buffer_cache;
+#endif
+
+// A buffer used by the printing functions. It reuses the calling thread's
+// cached buffer unless the latter is in use by an outer call, e.g. from a
+// custom format function, or has been destroyed, and a local buffer otherwise.
+class PrintBuffer {
+ private:
+#if FMT_USE_BUFFER_CACHE
+  BufferCache *cache_;
+#endif
+  PrintMemoryBuffer local_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(PrintBuffer);
+
+ public:
+#if FMT_USE_BUFFER_CACHE
+  PrintBuffer() : cache_(0) {
+    if (buffer_cache_destroyed || buffer_cache.in_use)
+      return;
+    cache_ = &buffer_cache;
+    cache_->in_use = true;
+  }
+
+  ~PrintBuffer() {
+    if (!cache_)
+      return;
+    PrintMemoryBuffer &buffer = cache_->buffer;
+    buffer.clear();
+    std::size_t capacity = buffer.capacity();
+    if (capacity > fmt::internal::INLINE_BUFFER_SIZE &&
+        capacity > buffer_cache_limit.load(std::memory_order_relaxed)) {
+      // Release memory above the limit.
+      PrintMemoryBuffer empty;
+      buffer = std::move(empty);
+    }
+    cache_->in_use = false;
+  }
+
+  fmt::Buffer<char> &get() { return cache_ ? cache_->buffer : local_; }
+#else
+  PrintBuffer() {}
+
+  fmt::Buffer<char> &get() { return local_; }
+#endif
+};
+
+// Storage for strings copied to a format record. It is used in two passes:
+// first the sizes of the strings are reserved and then, after the memory
+// is allocated, the strings are copied.
+class RecordStrings {
+ private:
+  std::size_t num_chars_;
+  std::size_t num_wchars_;
+  char *chars_;
+  wchar_t *wchars_;
+
+  char *&ptr(const char *) { return chars_; }
+  wchar_t *&ptr(const wchar_t *) { return wchars_; }
+
+ public:
+  RecordStrings() : num_chars_(0), num_wchars_(0), chars_(0), wchars_(0) {}
+
+  void reserve(const char *, std::size_t size) { num_chars_ += size; }
+  void reserve(const wchar_t *, std::size_t size) { num_wchars_ += size; }
+
+  std::size_t size() const {
+    return num_wchars_ * sizeof(wchar_t) + num_chars_;
+  }
+
+  // Sets the memory to copy strings to. Wide strings are stored first
+  // because they have stricter alignment.
+  void set_data(char *data) {
+    wchars_ = reinterpret_cast<wchar_t*>(data);
+    chars_ = data + num_wchars_ * sizeof(wchar_t);
+  }
+
+  template <typename Char>
+  const Char *copy(const Char *s, std::size_t size) {
+    Char *&p = ptr(s);
+    Char *result = p;
+    if (size != 0)
+      memcpy(result, s, size * sizeof(Char));
+    p += size;
+    return result;
+  }
+};
+
+// Reserves storage for the data referenced by arg in a format record.
+void reserve_arg(RecordStrings &strings, const Arg &arg,
+                 std::size_t &num_custom_args) {
+  switch (arg.type) {
+  case Arg::CSTRING:
+    if (arg.string.value)
+      strings.reserve(arg.string.value, strlen(arg.string.value));
+    break;
+  case Arg::STRING:
+    strings.reserve(arg.string.value, arg.string.size);
+    break;
+  case Arg::WSTRING:
+    strings.reserve(arg.wstring.value, arg.wstring.size);
+    break;
+  case Arg::CUSTOM:
+    ++num_custom_args;
+    break;
+  default:
+    break;
+  }
+}
+
+// Copies the data referenced by arg to a format record.
+void copy_arg(RecordStrings &strings, Arg &arg,
+              fmt::internal::CustomArgCopy *custom_args,
+              std::size_t &num_custom_args) {
+  if (arg.type == Arg::CSTRING && arg.string.value) {
+    // Convert to a string with known size to avoid computing it again
+    // when formatting.
+    arg.type = Arg::STRING;
+    arg.string.size = strlen(arg.string.value);
+  }
+  switch (arg.type) {
+  case Arg::STRING:
+    arg.string.value = strings.copy(arg.string.value, arg.string.size);
+    break;
+  case Arg::WSTRING:
+    arg.wstring.value = strings.copy(arg.wstring.value, arg.wstring.size);
+    break;
+  case Arg::CUSTOM: {
+    fmt::internal::CustomArgCopy &copy = custom_args[num_custom_args];
+    // Calling the format function with null formatter makes a copy.
+    arg.custom.format(0, arg.custom.value, &copy);
+    if (!copy.value)
+      FMT_THROW(fmt::FormatError("cannot copy argument of custom type"));
+    ++num_custom_args;
+    arg.custom.value = copy.value;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// The number of code units converted at once by the ASCII fast paths of
+// the UTF-8 converters.
+enum { ASCII_BLOCK_SIZE = 16 };
+
+const uint32_t INVALID_CODE_POINT = 0xFFFFFFFF;
+
+// Returns true if the ASCII_BLOCK_SIZE bytes at s are all ASCII.
+inline bool is_ascii_block(const unsigned char *s) {
+#if FMT_SSE2
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+  return _mm_movemask_epi8(block) == 0;
+#elif FMT_NEON
+  return vmaxvq_u8(vld1q_u8(s)) < 0x80;
+#else
+  unsigned bits = 0;
+  for (int i = 0; i < ASCII_BLOCK_SIZE; ++i)
+    bits |= s[i];
+  return bits < 0x80;
+#endif
+}
+
+// Writes ASCII_BLOCK_SIZE ASCII characters from s to out as wide characters.
+inline void widen_ascii_block(const unsigned char *s, wchar_t *out) {
+#if FMT_SSE2
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_unpacklo_epi8(block, zero);
+  __m128i hi = _mm_unpackhi_epi8(block, zero);
+  __m128i *p = reinterpret_cast<__m128i*>(out);
+  if (sizeof(wchar_t) == 2) {
+    _mm_storeu_si128(p, lo);
+    _mm_storeu_si128(p + 1, hi);
+    return;
+  }
+  if (sizeof(wchar_t) == 4) {
+    _mm_storeu_si128(p, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(p + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(p + 3, _mm_unpackhi_epi16(hi, zero));
+    return;
+  }
+#endif
+  for (int i = 0; i < ASCII_BLOCK_SIZE; ++i)
+    out[i] = static_cast<wchar_t>(s[i]);
+}
+
+// Writes ASCII_BLOCK_SIZE wide characters from s to out as bytes if they
+// are all ASCII. Returns false without writing anything otherwise.
+inline bool narrow_ascii_block(const wchar_t *s, char *out) {
+#if FMT_SSE2
+  const __m128i *p = reinterpret_cast<const __m128i*>(s);
+  __m128i zero = _mm_setzero_si128();
+  if (sizeof(wchar_t) == 2) {
+    __m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1);
+    __m128i non_ascii = _mm_and_si128(
+          _mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(~0x7f)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xffff)
+      return false;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+    return true;
+  }
+  if (sizeof(wchar_t) == 4) {
+    __m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1);
+    __m128i c = _mm_loadu_si128(p + 2), d = _mm_loadu_si128(p + 3);
+    __m128i non_ascii = _mm_and_si128(
+          _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)),
+          _mm_set1_epi32(~0x7f));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(non_ascii, zero)) != 0xffff)
+      return false;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(
+          _mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    return true;
+  }
+#endif
+  uint32_t bits = 0;
+  for (int i = 0; i < ASCII_BLOCK_SIZE; ++i)
+    bits |= static_cast<uint32_t>(s[i]);
+  if (bits >= 0x80)
+    return false;
+  for (int i = 0; i < ASCII_BLOCK_SIZE; ++i)
+    out[i] = static_cast<char>(s[i]);
+  return true;
+}
+
+// Decodes a UTF-8 sequence starting with a non-ASCII byte at s and advances
+// s past it. Returns INVALID_CODE_POINT if the sequence is truncated,
+// overlong, encodes a surrogate or a value outside of the Unicode range.
+uint32_t decode_utf8(const unsigned char *&s, const unsigned char *end) {
+  unsigned lead = *s;
+  int num_trailing = 0;
+  uint32_t cp = 0, min_cp = 0;
+  if (lead < 0xc2) {
+    return INVALID_CODE_POINT;  // A continuation byte or an overlong form.
+  } else if (lead < 0xe0) {
+    num_trailing = 1;
+    cp = lead & 0x1f;
+    min_cp = 0x80;
+  } else if (lead < 0xf0) {
+    num_trailing = 2;
+    cp = lead & 0x0f;
+    min_cp = 0x800;
+  } else if (lead < 0xf5) {
+    num_trailing = 3;
+    cp = lead & 0x07;
+    min_cp = 0x10000;
+  } else {
+    return INVALID_CODE_POINT;
+  }
+  if (end - s <= num_trailing)
+    return INVALID_CODE_POINT;
+  for (int i = 1; i <= num_trailing; ++i) {
+    unsigned c = s[i];
+    if ((c & 0xc0) != 0x80)
+      return INVALID_CODE_POINT;
+    cp = (cp << 6) | (c & 0x3f);
+  }
+  if (cp < min_cp || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+    return INVALID_CODE_POINT;
+  s += num_trailing + 1;
+  return cp;
+}
+
+// Encodes a code point as UTF-8. Returns a pointer past the last byte.
+inline char *encode_utf8(char *out, uint32_t cp) {
+  if (cp < 0x800) {
+    *out++ = static_cast<char>(0xc0 | (cp >> 6));
+  } else {
+    if (cp < 0x10000) {
+      *out++ = static_cast<char>(0xe0 | (cp >> 12));
+    } else {
+      *out++ = static_cast<char>(0xf0 | (cp >> 18));
+      *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+    }
+    *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+  }
+  *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+  return out;
+}
+}  // namespace
+
+namespace internal {
+
+template <typename Impl, typename Char>
+class BasicArgFormatter : public ArgVisitor<Impl, void> {
+ private:
+  BasicWriter<Char> &writer_;
+  FormatSpec &spec_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(BasicArgFormatter);
+
+ protected:
+  BasicWriter<Char> &writer() { return writer_; }
+  const FormatSpec &spec() const { return spec_; }
+
+ public:
+  BasicArgFormatter(BasicWriter<Char> &w, FormatSpec &s)
+  : writer_(w), spec_(s) {}
+
+  template <typename T>
+  void visit_any_int(T value) { writer_.write_int(value, spec_); }
+
+  template <typename T>
+  void visit_any_double(T value) { writer_.write_double(value, spec_); }
+
+  void visit_float(float value) { writer_.write_double(value, spec_); }
+
+  void visit_bool(bool value) {
+    if (spec_.type_) {
+      writer_.write_int(value, spec_);
+      return;
+    }
+    const char *str_value = value ? "true" : "false";
+    Arg::StringValue<char> str = { str_value, strlen(str_value) };
+    writer_.write_str(str, spec_);
+  }
+
+  void visit_char(int value) {
+    if (spec_.type_ && spec_.type_ != 'c') {
+      spec_.flags_ |= CHAR_FLAG;
+      writer_.write_int(value, spec_);
+      return;
+    }
+    if (spec_.align_ == ALIGN_NUMERIC || spec_.flags_ != 0)
+      FMT_THROW(FormatError("invalid format specifier for char"));
+    typedef typename BasicWriter<Char>::CharPtr CharPtr;
+    Char fill = internal::CharTraits<Char>::cast(spec_.fill());
+    CharPtr out = writer_.grow_padded(1, spec_.width_, spec_.align_, fill);
+    *out = internal::CharTraits<Char>::cast(value);
+  }
+
+  void visit_string(Arg::StringValue<char> value) {
+    writer_.write_str(value, spec_);
+  }
+
+  using ArgVisitor<Impl, void>::visit_wstring;
+
+  void visit_wstring(Arg::StringValue<Char> value) {
+    writer_.write_str(value, spec_);
+  }
+
+  void visit_pointer(const void *value) {
+    if (spec_.type_ && spec_.type_ != 'p')
+      report_unknown_type(spec_.type_, "pointer");
+    spec_.flags_ = HASH_FLAG;
+    spec_.type_ = 'x';
+    writer_.write_int(reinterpret_cast<uintptr_t>(value), spec_);
+  }
+};
+
+// An argument formatter.
+template <typename Char>
+class ArgFormatter : public BasicArgFormatter<ArgFormatter<Char>, Char> {
+ private:
+  BasicFormatter<Char> &formatter_;
+  const Char *format_;
+
+ public:
   ArgFormatter(BasicFormatter<Char> &f, FormatSpec &s, const Char *fmt)
   : BasicArgFormatter<ArgFormatter<Char>, Char>(f.writer(), s),
     formatter_(f), format_(fmt) {}
@@ -508,22 +1920,57 @@ class PrintfArgFormatter :
     if (spec.type_ && spec.type_ != 'c')
       writer.write_int(value, spec);
     typedef typename BasicWriter<Char>::CharPtr CharPtr;
-    CharPtr out = CharPtr();
-    if (spec.width_ > 1) {
-      Char fill = ' ';
-      out = writer.grow_buffer(spec.width_);
-      if (spec.align_ != ALIGN_LEFT) {
-        std::fill_n(out, spec.width_ - 1, fill);
-        out += spec.width_ - 1;
-      } else {
-        std::fill_n(out + 1, spec.width_ - 1, fill);
-      }
-    } else {
-      out = writer.grow_buffer(1);
-    }
+    CharPtr out = writer.grow_padded(
+        1, spec.width_, spec.align_ == ALIGN_LEFT ? ALIGN_LEFT : ALIGN_RIGHT,
+        static_cast<Char>(' '));
     *out = static_cast<Char>(value);
   }
 };
+
+// Formats an element of a range written with BasicWriter::write_range.
+template <typename Char>
+class RangeArgFormatter :
+    public BasicArgFormatter<RangeArgFormatter<Char>, Char> {
+ public:
+  RangeArgFormatter(BasicWriter<Char> &w, FormatSpec &s)
+  : BasicArgFormatter<RangeArgFormatter<Char>, Char>(w, s) {}
+
+  void visit_custom(Arg::CustomValue) {
+    FMT_THROW(FormatError("cannot write a range of user-defined type"));
+  }
+};
+
+// Formats an argument according to a printf format specification and
+// a length modifier.
+template <typename Char>
+void format_printf_arg(
+    BasicWriter<Char> &w, FormatSpec &spec, Arg arg, char length) {
+  if (spec.flag(HASH_FLAG) && IsZeroInt().visit(arg))
+    spec.flags_ &= ~HASH_FLAG;
+  if (spec.fill_ == '0') {
+    if (arg.type <= Arg::LAST_NUMERIC_TYPE)
+      spec.align_ = ALIGN_NUMERIC;
+    else
+      spec.fill_ = ' ';  // Ignore '0' flag for non-numeric types.
+  }
+
+  // Convert the argument to the required type.
+  convert_arg(arg, length, spec.type_);
+  if (arg.type <= Arg::LAST_INTEGER_TYPE) {
+    // Normalize type.
+    switch (spec.type_) {
+    case 'i': case 'u':
+      spec.type_ = 'd';
+      break;
+    case 'c':
+      // TODO: handle wchar_t
+      CharConverter(arg).visit(arg);
+      break;
+    }
+  }
+
+  PrintfArgFormatter<Char>(w, spec).visit(arg);
+}
 }  // namespace internal
 }  // namespace fmt
 
@@ -564,6 +2011,40 @@ int fmt::internal::CharTraits<wchar_t>::format_float(
       FMT_SWPRINTF(buffer, size, format, width, precision, value);
 }
 
+FMT_FUNC bool fmt::internal::grisu_format(
+    double value, char *buffer, int &size, int &exp,
+    int precision, bool fixed) {
+  DiyFP v(value);
+  if (precision < 0) {
+    DiyFP lower, upper;
+    v.compute_boundaries(lower, upper);
+    grisu_format_shortest(value, lower, upper, false, buffer, size, exp);
+    return true;
+  }
+  int pow10_exp = 0;
+  DiyFP w = v.normalize();
+  DiyFP c = get_cached_power(w.e, pow10_exp);
+  exp = -pow10_exp;
+  int num_digits = 0;
+  if (grisu_gen_counted(w * c, precision, fixed, buffer, size, exp, num_digits))
+    return true;
+  // Any decimal number with at most DBL_DIG significant digits is uniquely
+  // identified by its nearest double so if the shortest representation fits
+  // into the requested number of digits it is also the correctly rounded
+  // result padded with zeros.
+  if (num_digits <= 0 || num_digits > std::numeric_limits<double>::digits10)
+    return false;
+  grisu_format(value, buffer, size, exp);
+  return fixed ? exp >= -precision : size <= precision;
+}
+
+FMT_FUNC void fmt::internal::grisu_format_float(
+    float value, char *buffer, int &size, int &exp) {
+  DiyFP lower, upper;
+  DiyFP(value).compute_float_boundaries(lower, upper);
+  grisu_format_shortest(value, lower, upper, true, buffer, size, exp);
+}
+
 template <typename T>
 const char fmt::internal::BasicData<T>::DIGITS[] =
     "0001020304050607080910111213141516171819"
@@ -598,6 +2079,73 @@ const uint64_t fmt::internal::BasicData<T>::POWERS_OF_10_64[] = {
   fmt::ULongLong(1000000000) * fmt::ULongLong(1000000000) * 10
 };
 
+// Combines two 32-bit halves into a 64-bit constant to avoid warnings about
+// C++98 not supporting long long.
+#define FMT_UINT64(hi, lo) ((static_cast<uint64_t>(hi) << 32) | (lo))
+
+template <typename T>
+const uint64_t fmt::internal::BasicData<T>::POW10_SIGNIFICANDS[] = {
+  FMT_UINT64(0xfa8fd5a0, 0x081c0288), FMT_UINT64(0xbaaee17f, 0xa23ebf76),
+  FMT_UINT64(0x8b16fb20, 0x3055ac76), FMT_UINT64(0xcf42894a, 0x5dce35ea),
+  FMT_UINT64(0x9a6bb0aa, 0x55653b2d), FMT_UINT64(0xe61acf03, 0x3d1a45df),
+  FMT_UINT64(0xab70fe17, 0xc79ac6ca), FMT_UINT64(0xff77b1fc, 0xbebcdc4f),
+  FMT_UINT64(0xbe5691ef, 0x416bd60c), FMT_UINT64(0x8dd01fad, 0x907ffc3c),
+  FMT_UINT64(0xd3515c28, 0x31559a83), FMT_UINT64(0x9d71ac8f, 0xada6c9b5),
+  FMT_UINT64(0xea9c2277, 0x23ee8bcb), FMT_UINT64(0xaecc4991, 0x4078536d),
+  FMT_UINT64(0x823c1279, 0x5db6ce57), FMT_UINT64(0xc2109436, 0x4dfb5637),
+  FMT_UINT64(0x9096ea6f, 0x3848984f), FMT_UINT64(0xd77485cb, 0x25823ac7),
+  FMT_UINT64(0xa086cfcd, 0x97bf97f4), FMT_UINT64(0xef340a98, 0x172aace5),
+  FMT_UINT64(0xb23867fb, 0x2a35b28e), FMT_UINT64(0x84c8d4df, 0xd2c63f3b),
+  FMT_UINT64(0xc5dd4427, 0x1ad3cdba), FMT_UINT64(0x936b9fce, 0xbb25c996),
+  FMT_UINT64(0xdbac6c24, 0x7d62a584), FMT_UINT64(0xa3ab6658, 0x0d5fdaf6),
+  FMT_UINT64(0xf3e2f893, 0xdec3f126), FMT_UINT64(0xb5b5ada8, 0xaaff80b8),
+  FMT_UINT64(0x87625f05, 0x6c7c4a8b), FMT_UINT64(0xc9bcff60, 0x34c13053),
+  FMT_UINT64(0x964e858c, 0x91ba2655), FMT_UINT64(0xdff97724, 0x70297ebd),
+  FMT_UINT64(0xa6dfbd9f, 0xb8e5b88f), FMT_UINT64(0xf8a95fcf, 0x88747d94),
+  FMT_UINT64(0xb9447093, 0x8fa89bcf), FMT_UINT64(0x8a08f0f8, 0xbf0f156b),
+  FMT_UINT64(0xcdb02555, 0x653131b6), FMT_UINT64(0x993fe2c6, 0xd07b7fac),
+  FMT_UINT64(0xe45c10c4, 0x2a2b3b06), FMT_UINT64(0xaa242499, 0x697392d3),
+  FMT_UINT64(0xfd87b5f2, 0x8300ca0e), FMT_UINT64(0xbce50864, 0x92111aeb),
+  FMT_UINT64(0x8cbccc09, 0x6f5088cc), FMT_UINT64(0xd1b71758, 0xe219652c),
+  FMT_UINT64(0x9c400000, 0x00000000), FMT_UINT64(0xe8d4a510, 0x00000000),
+  FMT_UINT64(0xad78ebc5, 0xac620000), FMT_UINT64(0x813f3978, 0xf8940984),
+  FMT_UINT64(0xc097ce7b, 0xc90715b3), FMT_UINT64(0x8f7e32ce, 0x7bea5c70),
+  FMT_UINT64(0xd5d238a4, 0xabe98068), FMT_UINT64(0x9f4f2726, 0x179a2245),
+  FMT_UINT64(0xed63a231, 0xd4c4fb27), FMT_UINT64(0xb0de6538, 0x8cc8ada8),
+  FMT_UINT64(0x83c7088e, 0x1aab65db), FMT_UINT64(0xc45d1df9, 0x42711d9a),
+  FMT_UINT64(0x924d692c, 0xa61be758), FMT_UINT64(0xda01ee64, 0x1a708dea),
+  FMT_UINT64(0xa26da399, 0x9aef774a), FMT_UINT64(0xf209787b, 0xb47d6b85),
+  FMT_UINT64(0xb454e4a1, 0x79dd1877), FMT_UINT64(0x865b8692, 0x5b9bc5c2),
+  FMT_UINT64(0xc83553c5, 0xc8965d3d), FMT_UINT64(0x952ab45c, 0xfa97a0b3),
+  FMT_UINT64(0xde469fbd, 0x99a05fe3), FMT_UINT64(0xa59bc234, 0xdb398c25),
+  FMT_UINT64(0xf6c69a72, 0xa3989f5c), FMT_UINT64(0xb7dcbf53, 0x54e9bece),
+  FMT_UINT64(0x88fcf317, 0xf22241e2), FMT_UINT64(0xcc20ce9b, 0xd35c78a5),
+  FMT_UINT64(0x98165af3, 0x7b2153df), FMT_UINT64(0xe2a0b5dc, 0x971f303a),
+  FMT_UINT64(0xa8d9d153, 0x5ce3b396), FMT_UINT64(0xfb9b7cd9, 0xa4a7443c),
+  FMT_UINT64(0xbb764c4c, 0xa7a44410), FMT_UINT64(0x8bab8eef, 0xb6409c1a),
+  FMT_UINT64(0xd01fef10, 0xa657842c), FMT_UINT64(0x9b10a4e5, 0xe9913129),
+  FMT_UINT64(0xe7109bfb, 0xa19c0c9d), FMT_UINT64(0xac2820d9, 0x623bf429),
+  FMT_UINT64(0x80444b5e, 0x7aa7cf85), FMT_UINT64(0xbf21e440, 0x03acdd2d),
+  FMT_UINT64(0x8e679c2f, 0x5e44ff8f), FMT_UINT64(0xd433179d, 0x9c8cb841),
+  FMT_UINT64(0x9e19db92, 0xb4e31ba9), FMT_UINT64(0xeb96bf6e, 0xbadf77d9),
+  FMT_UINT64(0xaf87023b, 0x9bf0ee6b)
+};
+
+template <typename T>
+const int16_t fmt::internal::BasicData<T>::POW10_EXPONENTS[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+  -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+  -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+  -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+  -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+  109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+  641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066
+};
+
+#undef FMT_UINT64
+
 FMT_FUNC void fmt::internal::report_unknown_type(char code, const char *type) {
   (void)type;
   if (std::isprint(static_cast<unsigned char>(code))) {
@@ -609,20 +2157,103 @@ FMT_FUNC void fmt::internal::report_unknown_type(char code, const char *type) {
         static_cast<unsigned>(code), type)));
 }
 
+FMT_FUNC bool fmt::internal::utf8_to_wchar(
+    fmt::StringRef s, fmt::Buffer<wchar_t> &out) {
+  std::size_t size = out.size();
+  if (s.size() == 0)
+    return true;
+  // Each byte produces at most one wide character, so a single
+  // reservation is enough.
+  out.resize(size + s.size());
+  wchar_t *start = &out[0], *o = start + size;
+  const unsigned char *p = reinterpret_cast<const unsigned char*>(s.data());
+  const unsigned char *end = p + s.size();
+  while (p != end) {
+    if (*p < 0x80) {
+      if (end - p >= ASCII_BLOCK_SIZE && is_ascii_block(p)) {
+        widen_ascii_block(p, o);
+        p += ASCII_BLOCK_SIZE;
+        o += ASCII_BLOCK_SIZE;
+      } else {
+        *o++ = static_cast<wchar_t>(*p++);
+      }
+      continue;
+    }
+    uint32_t cp = decode_utf8(p, end);
+    if (cp == INVALID_CODE_POINT) {
+      out.resize(size);
+      return false;
+    }
+    if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+      // Encode as a surrogate pair. The sequence is 4 bytes long, so the
+      // pair fits into the reserved space.
+      cp -= 0x10000;
+      *o++ = static_cast<wchar_t>(0xd800 + (cp >> 10));
+      *o++ = static_cast<wchar_t>(0xdc00 + (cp & 0x3ff));
+    } else {
+      *o++ = static_cast<wchar_t>(cp);
+    }
+  }
+  out.resize(o - start);
+  return true;
+}
+
+FMT_FUNC bool fmt::internal::wchar_to_utf8(
+    fmt::WStringRef s, fmt::Buffer<char> &out) {
+  std::size_t size = out.size(), pos = size;
+  // Reserve enough space for ASCII output and grow when a non-ASCII
+  // character is encountered. The space left is kept at least as large as
+  // the number of characters left, so ASCII characters need no checks.
+  out.resize(size + s.size());
+  const wchar_t *p = s.data(), *end = p + s.size();
+  while (p != end) {
+    if (end - p >= ASCII_BLOCK_SIZE && narrow_ascii_block(p, &out[pos])) {
+      p += ASCII_BLOCK_SIZE;
+      pos += ASCII_BLOCK_SIZE;
+      continue;
+    }
+    uint32_t cp = static_cast<uint32_t>(*p++);
+    if (cp < 0x80) {
+      out[pos++] = static_cast<char>(cp);
+      continue;
+    }
+    if (cp >= 0xd800 && cp <= 0xdfff) {
+      uint32_t low = p != end ? static_cast<uint32_t>(*p) : 0;
+      if (sizeof(wchar_t) != 2 || cp > 0xdbff || low < 0xdc00 || low > 0xdfff) {
+        out.resize(size);
+        return false;
+      }
+      ++p;
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+    } else if (cp > 0x10ffff) {
+      out.resize(size);
+      return false;
+    }
+    // A character takes at most 4 bytes.
+    std::size_t min_size = pos + 4 + (end - p);
+    if (out.size() < min_size)
+      out.resize(min_size);
+    pos = encode_utf8(&out[pos], cp) - &out[0];
+  }
+  out.resize(pos);
+  return true;
+}
+
+FMT_FUNC void fmt::internal::append_wide(
+    fmt::Buffer<char> &out, fmt::WStringRef s) {
+  if (!wchar_to_utf8(s, out))
+    FMT_THROW(FormatError("cannot convert wide string to UTF-8"));
+}
+
 #if FMT_USE_WINDOWS_H
 
 FMT_FUNC fmt::internal::UTF8ToUTF16::UTF8ToUTF16(fmt::StringRef s) {
-  int length = MultiByteToWideChar(
-      CP_UTF8, MB_ERR_INVALID_CHARS, s.data(), s.size(), 0, 0);
   static const char ERROR_MSG[] = "cannot convert string from UTF-8 to UTF-16";
-  if (length == 0)
-    FMT_THROW(WindowsError(GetLastError(), ERROR_MSG));
-  buffer_.resize(length + 1);
-  length = MultiByteToWideChar(
-    CP_UTF8, MB_ERR_INVALID_CHARS, s.data(), s.size(), &buffer_[0], length);
-  if (length == 0)
-    FMT_THROW(WindowsError(GetLastError(), ERROR_MSG));
-  buffer_[length] = 0;
+  if (!s.data())
+    FMT_THROW(WindowsError(ERROR_INVALID_PARAMETER, ERROR_MSG));
+  if (!utf8_to_wchar(s, buffer_))
+    FMT_THROW(WindowsError(ERROR_NO_UNICODE_TRANSLATION, ERROR_MSG));
+  buffer_.push_back(0);
 }
 
 FMT_FUNC fmt::internal::UTF16ToUTF8::UTF16ToUTF8(fmt::WStringRef s) {
@@ -633,15 +2264,12 @@ FMT_FUNC fmt::internal::UTF16ToUTF8::UTF16ToUTF8(fmt::WStringRef s) {
 }
 
 FMT_FUNC int fmt::internal::UTF16ToUTF8::convert(fmt::WStringRef s) {
-  int length = WideCharToMultiByte(CP_UTF8, 0, s.data(), s.size(), 0, 0, 0, 0);
-  if (length == 0)
-    return GetLastError();
-  buffer_.resize(length + 1);
-  length = WideCharToMultiByte(
-    CP_UTF8, 0, s.data(), s.size(), &buffer_[0], length, 0, 0);
-  if (length == 0)
-    return GetLastError();
-  buffer_[length] = 0;
+  buffer_.clear();
+  if (!s.data())
+    return ERROR_INVALID_PARAMETER;
+  if (!wchar_to_utf8(s, buffer_))
+    return ERROR_NO_UNICODE_TRANSLATION;
+  buffer_.push_back(0);
   return 0;
 }
 
@@ -673,11 +2301,12 @@ FMT_FUNC void fmt::internal::format_windows_error(
         FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, 0,
         error_code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
         reinterpret_cast<LPWSTR>(system_message.ptr()), 0, 0)) {
-      UTF16ToUTF8 utf8_message;
-      if (utf8_message.convert(system_message.c_str()) == ERROR_SUCCESS) {
-        out << message << ": " << utf8_message;
+      // Transcode the message directly into the output.
+      std::size_t size = out.size();
+      out << message << ": ";
+      if (wchar_to_utf8(system_message.c_str(), out.buffer()))
         return;
-      }
+      out.buffer().resize(size);
     }
   } FMT_CATCH(...) {}
   format_error_code(out, error_code, message);
@@ -707,11 +2336,15 @@ FMT_FUNC void fmt::internal::format_system_error(
 }
 
 template <typename Char>
-void fmt::internal::ArgMap<Char>::init(const ArgList &args) {
-  if (!map_.empty())
-    return;
+void fmt::internal::ArgMap<Char>::add(const ArgList &args) {
   typedef internal::NamedArg<Char> NamedArg;
-  const NamedArg *named_arg = 0;
+  if (args.is_large()) {
+    for (unsigned i = 0, n = args.large_size(); i != n; ++i) {
+      if (args.large_type(i) == internal::Arg::NAMED_ARG)
+        add(static_cast<const NamedArg*>(args.values_[i].pointer));
+    }
+    return;
+  }
   bool use_values =
       args.type(ArgList::MAX_PACKED_ARGS - 1) == internal::Arg::NONE;
   if (use_values) {
@@ -721,29 +2354,24 @@ void fmt::internal::ArgMap<Char>::init(const ArgList &args) {
       case internal::Arg::NONE:
         return;
       case internal::Arg::NAMED_ARG:
-        named_arg = static_cast<const NamedArg*>(args.values_[i].pointer);
-        map_.insert(Pair(named_arg->name, *named_arg));
+        add(static_cast<const NamedArg*>(args.values_[i].pointer));
         break;
       default:
         /*nothing*/;
       }
     }
-    return;
   }
   for (unsigned i = 0; i != ArgList::MAX_PACKED_ARGS; ++i) {
     internal::Arg::Type arg_type = args.type(i);
-    if (arg_type == internal::Arg::NAMED_ARG) {
-      named_arg = static_cast<const NamedArg*>(args.args_[i].pointer);
-      map_.insert(Pair(named_arg->name, *named_arg));
-    }
+    if (arg_type == internal::Arg::NAMED_ARG)
+      add(static_cast<const NamedArg*>(args.args_[i].pointer));
   }
   for (unsigned i = ArgList::MAX_PACKED_ARGS;/*nothing*/; ++i) {
     switch (args.args_[i].type) {
     case internal::Arg::NONE:
       return;
     case internal::Arg::NAMED_ARG:
-      named_arg = static_cast<const NamedArg*>(args.args_[i].pointer);
-      map_.insert(Pair(named_arg->name, *named_arg));
+      add(static_cast<const NamedArg*>(args.args_[i].pointer));
       break;
     default:
       /*nothing*/;
@@ -751,11 +2379,65 @@ void fmt::internal::ArgMap<Char>::init(const ArgList &args) {
   }
 }
 
+template <typename Char>
+void fmt::internal::ArgMap<Char>::init(const ArgList &args) {
+  if (initialized_)
+    return;
+  initialized_ = true;
+  FMT_ADD_STAT(ARG_MAP_BUILDS, 1);
+  add(args);
+  std::size_t size = entries_.size();
+  if (size <= MAX_LINEAR_SIZE)
+    return;
+  // Rebuild as a hash table that is at most half full.
+  std::size_t table_size = 2 * MAX_LINEAR_SIZE;
+  while (table_size < 2 * size)
+    table_size *= 2;
+  entries_.resize(table_size);
+  std::fill_n(&entries_[0], table_size,
+              static_cast<const NamedArg<Char>*>(0));
+  mask_ = table_size - 1;
+  add(args);
+}
+
 template <typename Char>
 void fmt::internal::FixedBuffer<Char>::grow(std::size_t) {
   FMT_THROW(std::runtime_error("buffer overflow"));
 }
 
+template <typename Char>
+void fmt::internal::align_output(
+    Buffer<Char> &buffer, std::size_t start, const FormatSpec &spec) {
+  std::size_t size = buffer.size() - start;
+  std::size_t precision = static_cast<std::size_t>(spec.precision_);
+  if (spec.precision_ >= 0 && precision < size) {
+    size = precision;
+    buffer.resize(start + size);
+  }
+  if (spec.width_ <= size)
+    return;
+  std::size_t padding = spec.width_ - size;
+  buffer.resize(start + spec.width_);
+  Char *out = &buffer[start];
+  Char fill = internal::CharTraits<Char>::cast(spec.fill_);
+  std::size_t left_padding = 0;
+  if (spec.align_ == ALIGN_RIGHT)
+    left_padding = padding;
+  else if (spec.align_ == ALIGN_CENTER)
+    left_padding = padding / 2;
+  if (left_padding != 0) {
+    std::copy_backward(out, out + size, out + left_padding + size);
+    internal::fill_chars(out, left_padding, fill);
+  }
+  internal::fill_chars(out + left_padding + size,
+                       padding - left_padding, fill);
+}
+
+template <typename Char>
+void fmt::BasicWriter<Char>::write_arg(const Arg &arg, FormatSpec spec) {
+  internal::RangeArgFormatter<Char>(*this, spec).visit(arg);
+}
+
 template <typename Char>
 template <typename StrChar>
 void fmt::BasicWriter<Char>::write_str(
@@ -791,28 +2473,49 @@ inline Arg fmt::BasicFormatter<Char>::get_arg(
   return Arg();
 }
 
+template <typename Char>
+inline Arg fmt::BasicFormatter<Char>::parse_arg_index(
+    const Char *&s, const char *&error) {
+  if (*s < '0' || *s > '9') {
+    Arg arg = next_arg(error);
+    if (error && *s != '}' && *s != ':')
+      error = "invalid format string";
+    return arg;
+  }
+  unsigned arg_index = parse_nonnegative_int(s, error);
+  if (error)
+    return Arg();
+  Arg arg = get_arg(arg_index, error);
+  if (error && *s != '}' && *s != ':')
+    error = "invalid format string";
+  return arg;
+}
+
 template <typename Char>
 inline Arg fmt::BasicFormatter<Char>::parse_arg_index(const Char *&s) {
   const char *error = 0;
-  Arg arg = *s < '0' || *s > '9' ?
-        next_arg(error) : get_arg(parse_nonnegative_int(s), error);
-  if (error) {
-    FMT_THROW(FormatError(
-                *s != '}' && *s != ':' ? "invalid format string" : error));
-  }
+  Arg arg = parse_arg_index(s, error);
+  if (error)
+    FMT_THROW(FormatError(error));
   return arg;
 }
 
 template <typename Char>
-inline Arg fmt::BasicFormatter<Char>::parse_arg_name(const Char *&s) {
+inline Arg fmt::BasicFormatter<Char>::parse_arg_name(
+    const Char *&s, const char *&error) {
   assert(is_name_start(*s));
   const Char *start = s;
   Char c;
   do {
     c = *++s;
   } while (is_name_start(c) || ('0' <= c && c <= '9'));
+  return get_arg(fmt::BasicStringRef<Char>(start, s - start), error);
+}
+
+template <typename Char>
+inline Arg fmt::BasicFormatter<Char>::parse_arg_name(const Char *&s) {
   const char *error = 0;
-  Arg arg = get_arg(fmt::BasicStringRef<Char>(start, s - start), error);
+  Arg arg = parse_arg_name(s, error);
   if (error)
     FMT_THROW(fmt::FormatError(error));
   return arg;
@@ -930,13 +2633,13 @@ unsigned fmt::internal::PrintfFormatter<Char>::parse_header(
 
 template <typename Char>
 void fmt::internal::PrintfFormatter<Char>::format(
-    BasicWriter<Char> &writer, BasicCStringRef<Char> format_str) {
-  const Char *start = format_str.c_str();
+    BasicWriter<Char> &writer, BasicStringRef<Char> format_str) {
+  const Char *start = format_str.data();
+  const Char *end = start + format_str.size();
   const Char *s = start;
-  while (*s) {
+  while ((s = find_special(s, end, Char('%'), Char('%'))) != end) {
     Char c = *s++;
-    if (c != '%') continue;
-    if (*s == c) {
+    if (s != end && *s == c) {
       write(writer, start, s);
       start = ++s;
       continue;
@@ -946,97 +2649,52 @@ void fmt::internal::PrintfFormatter<Char>::format(
     FormatSpec spec;
     spec.align_ = ALIGN_RIGHT;
 
-    // Parse argument index, flags and width.
-    unsigned arg_index = parse_header(s, spec);
-
-    // Parse precision.
-    if (*s == '.') {
-      ++s;
-      if ('0' <= *s && *s <= '9') {
-        spec.precision_ = parse_nonnegative_int(s);
-      } else if (*s == '*') {
-        ++s;
-        spec.precision_ = PrecisionHandler().visit(get_arg(s));
-      }
+    if (s != end && is_simple_printf_type(*s)) {
+      // Fast path for specifications consisting of a type only.
+      Arg arg = get_arg(s);
+      spec.type_ = static_cast<char>(*s++);
+      start = s;
+      format_printf_arg(writer, spec, arg, LENGTH_NONE);
+      continue;
     }
 
-    Arg arg = get_arg(s, arg_index);
-    if (spec.flag(HASH_FLAG) && IsZeroInt().visit(arg))
-      spec.flags_ &= ~HASH_FLAG;
-    if (spec.fill_ == '0') {
-      if (arg.type <= Arg::LAST_NUMERIC_TYPE)
-        spec.align_ = ALIGN_NUMERIC;
-      else
-        spec.fill_ = ' ';  // Ignore '0' flag for non-numeric types.
-    }
+    FormatField<Char> field(s, end, find_printf_type(s, end) != end);
+    const Char *p = field.data();
 
-    // Parse length and convert the argument to the required type.
-    switch (*s++) {
-    case 'h':
-      if (*s == 'h')
-        ArgConverter<signed char>(arg, *++s).visit(arg);
-      else
-        ArgConverter<short>(arg, *s).visit(arg);
-      break;
-    case 'l':
-      if (*s == 'l')
-        ArgConverter<fmt::LongLong>(arg, *++s).visit(arg);
-      else
-        ArgConverter<long>(arg, *s).visit(arg);
-      break;
-    case 'j':
-      ArgConverter<intmax_t>(arg, *s).visit(arg);
-      break;
-    case 'z':
-      ArgConverter<size_t>(arg, *s).visit(arg);
-      break;
-    case 't':
-      ArgConverter<ptrdiff_t>(arg, *s).visit(arg);
-      break;
-    case 'L':
-      // printf produces garbage when 'L' is omitted for long double, no
-      // need to do the same.
-      break;
-    default:
-      --s;
-      ArgConverter<int>(arg, *s).visit(arg);
+    // Parse argument index, flags and width.
+    unsigned arg_index = parse_header(p, spec);
+
+    // Parse precision.
+    if (*p == '.') {
+      ++p;
+      if ('0' <= *p && *p <= '9') {
+        spec.precision_ = parse_nonnegative_int(p);
+      } else if (*p == '*') {
+        ++p;
+        spec.precision_ = PrecisionHandler().visit(get_arg(p));
+      }
     }
 
+    Arg arg = get_arg(p, arg_index);
+    char length = parse_length(p);
+
     // Parse type.
-    if (!*s)
+    if (!*p)
       FMT_THROW(FormatError("invalid format string"));
-    spec.type_ = static_cast<char>(*s++);
-    if (arg.type <= Arg::LAST_INTEGER_TYPE) {
-      // Normalize type.
-      switch (spec.type_) {
-      case 'i': case 'u':
-        spec.type_ = 'd';
-        break;
-      case 'c':
-        // TODO: handle wchar_t
-        CharConverter(arg).visit(arg);
-        break;
-      }
-    }
+    spec.type_ = static_cast<char>(*p++);
 
-    start = s;
+    start = s = field.map(p);
 
     // Format argument.
-    internal::PrintfArgFormatter<Char>(writer, spec).visit(arg);
+    format_printf_arg(writer, spec, arg, length);
   }
-  write(writer, start, s);
+  write(writer, start, end);
 }
 
 template <typename Char>
-const Char *fmt::BasicFormatter<Char>::format(
-    const Char *&format_str, const Arg &arg) {
-  const Char *s = format_str;
-  FormatSpec spec;
+const Char *fmt::BasicFormatter<Char>::parse_spec(
+    const Char *s, const Arg &arg, FormatSpec &spec, const char *&error) {
   if (*s == ':') {
-    if (arg.type == Arg::CUSTOM) {
-      arg.custom.format(this, arg.custom.value, &s);
-      return s;
-    }
     ++s;
     // Parse fill and alignment.
     if (Char c = *s) {
@@ -1060,13 +2718,17 @@ const Char *fmt::BasicFormatter<Char>::format(
         if (spec.align_ != ALIGN_DEFAULT) {
           if (p != s) {
             if (c == '}') break;
-            if (c == '{')
-              FMT_THROW(FormatError("invalid fill character '{'"));
+            if (c == '{') {
+              error = "invalid fill character '{'";
+              return 0;
+            }
             s += 2;
             spec.fill_ = c;
           } else ++s;
-          if (spec.align_ == ALIGN_NUMERIC)
-            require_numeric_argument(arg, '=');
+          if (spec.align_ == ALIGN_NUMERIC &&
+              (error = check_numeric_argument(arg, '=')) != 0) {
+            return 0;
+          }
           break;
         }
       } while (--p >= s);
@@ -1075,146 +2737,849 @@ const Char *fmt::BasicFormatter<Char>::format(
     // Parse sign.
     switch (*s) {
       case '+':
-        check_sign(s, arg);
         spec.flags_ |= SIGN_FLAG | PLUS_FLAG;
         break;
       case '-':
-        check_sign(s, arg);
         spec.flags_ |= MINUS_FLAG;
         break;
       case ' ':
-        check_sign(s, arg);
         spec.flags_ |= SIGN_FLAG;
         break;
     }
+    if (*s == '+' || *s == '-' || *s == ' ') {
+      if ((error = check_sign_argument(arg, static_cast<char>(*s))) != 0)
+        return 0;
+      ++s;
+    }
 
     if (*s == '#') {
-      require_numeric_argument(arg, '#');
+      if ((error = check_numeric_argument(arg, '#')) != 0)
+        return 0;
       spec.flags_ |= HASH_FLAG;
       ++s;
     }
 
     // Parse zero flag.
     if (*s == '0') {
-      require_numeric_argument(arg, '0');
+      if ((error = check_numeric_argument(arg, '0')) != 0)
+        return 0;
       spec.align_ = ALIGN_NUMERIC;
       spec.fill_ = '0';
       ++s;
     }
-    
+
     // Parse width.
     if ('0' <= *s && *s <= '9') {
-      spec.width_ = parse_nonnegative_int(s);
+      spec.width_ = parse_nonnegative_int(s, error);
+      if (error)
+        return 0;
     } else if (*s == '{') {
       ++s;
       Arg width_arg = is_name_start(*s) ?
-            parse_arg_name(s) : parse_arg_index(s);
-      if (*s++ != '}')
-        FMT_THROW(FormatError("invalid format string"));
-      ULongLong value = 0;
-      switch (width_arg.type) {
-      case Arg::INT:
-        if (width_arg.int_value < 0)
-          FMT_THROW(FormatError("negative width"));
-        value = width_arg.int_value;
-        break;
-      case Arg::UINT:
-        value = width_arg.uint_value;
-        break;
-      case Arg::LONG_LONG:
-        if (width_arg.long_long_value < 0)
-          FMT_THROW(FormatError("negative width"));
-        value = width_arg.long_long_value;
-        break;
-      case Arg::ULONG_LONG:
-        value = width_arg.ulong_long_value;
-        break;
-      default:
-        FMT_THROW(FormatError("width is not integer"));
+            parse_arg_name(s, error) : parse_arg_index(s, error);
+      if (error)
+        return 0;
+      if (*s++ != '}') {
+        error = "invalid format string";
+        return 0;
+      }
+      spec.width_ = get_dynamic_spec(width_arg, true, error);
+      if (error)
+        return 0;
+    }
+
+    // Parse precision.
+    if (*s == '.') {
+      ++s;
+      spec.precision_ = 0;
+      if ('0' <= *s && *s <= '9') {
+        spec.precision_ = parse_nonnegative_int(s, error);
+      } else if (*s == '{') {
+        ++s;
+        Arg precision_arg =
+            is_name_start(*s) ? parse_arg_name(s, error) :
+                                parse_arg_index(s, error);
+        if (error)
+          return 0;
+        if (*s++ != '}') {
+          error = "invalid format string";
+          return 0;
+        }
+        spec.precision_ = static_cast<int>(
+            get_dynamic_spec(precision_arg, false, error));
+      } else {
+        error = "missing precision specifier";
+      }
+      if (error)
+        return 0;
+      if (arg.type <= Arg::LAST_INTEGER_TYPE) {
+        error = "precision not allowed in integer format specifier";
+        return 0;
+      }
+      if (arg.type == Arg::POINTER) {
+        error = "precision not allowed in pointer format specifier";
+        return 0;
+      }
+    }
+
+    // Parse type.
+    if (*s != '}' && *s)
+      spec.type_ = static_cast<char>(*s++);
+  }
+
+  if (*s++ != '}') {
+    error = "missing '}' in format string";
+    return 0;
+  }
+  return s;
+}
+
+template <typename Char>
+const Char *fmt::BasicFormatter<Char>::parse_spec(
+    const Char *s, const Arg &arg, FormatSpec &spec) {
+  const char *error = 0;
+  s = parse_spec(s, arg, spec, error);
+  if (error)
+    FMT_THROW(FormatError(error));
+  return s;
+}
+
+template <typename Char>
+const Char *fmt::BasicFormatter<Char>::format(
+    const Char *&format_str, const Arg &arg,
+    internal::FormatErrorInfo &error) {
+  const Char *s = format_str;
+  if (*s == ':' && arg.type == Arg::CUSTOM) {
+    arg.custom.format(this, arg.custom.value, &s);
+    return s;
+  }
+  FormatSpec spec;
+  s = parse_spec(s, arg, spec, error.message);
+  if (!s || !check_arg(arg, spec, error))
+    return 0;
+  internal::ArgFormatter<Char>(*this, spec, s - 1).visit(arg);
+  return s;
+}
+
+template <typename Char>
+const Char *fmt::BasicFormatter<Char>::format(
+    const Char *&format_str, const Arg &arg) {
+  internal::FormatErrorInfo error;
+  const Char *s = format(format_str, arg, error);
+  if (!s)
+    throw_format_error(error);
+  return s;
+}
+
+#if FMT_USE_STATS
+namespace fmt {
+namespace internal {
+
+#if FMT_USE_FORMAT_TIMING
+// The timing of a format string together with the bytes of the string
+// which identify it, because the address of a format string can be reused
+// for a different one.
+struct FormatTimingEntry {
+  std::string content;
+  FormatTiming timing;
+};
+
+// Timings keyed by the hash of the format string content.
+typedef std::unordered_multimap<std::size_t, FormatTimingEntry>
+  FormatTimingMap;
+
+// The maximum number of format strings timed per thread, so that formatting
+// with dynamically generated format strings doesn't use unbounded memory.
+enum { MAX_FORMAT_TIMINGS = 1024 };
+
+// Returns the FNV-1a hash of size bytes at data.
+inline std::size_t hash_bytes(const char *data, std::size_t size) {
+  ULongLong hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return static_cast<std::size_t>(hash);
+}
+#endif
+
+// Statistics of one thread. The counters are only incremented by the
+// owning thread but can be read or reset by others.
+struct ThreadStats {
+  std::atomic<ULongLong> counters[NUM_STATS_COUNTERS];
+#if FMT_USE_FORMAT_TIMING
+  std::mutex timing_mutex;
+  FormatTimingMap timings;
+#endif
+
+  ThreadStats();
+  ~ThreadStats();
+};
+
+// Statistics of all threads.
+struct StatsRegistry {
+  std::mutex mutex;
+  std::vector<ThreadStats*> threads;
+
+  // Statistics of the threads that have exited.
+  ULongLong exited[NUM_STATS_COUNTERS];
+#if FMT_USE_FORMAT_TIMING
+  std::vector<FormatTiming> exited_timings;
+#endif
+
+  StatsRegistry() { std::fill_n(exited, NUM_STATS_COUNTERS, 0); }
+};
+
+FMT_FUNC StatsRegistry &stats_registry() {
+  // The registry is never destroyed so that threads that exit after the
+  // destruction of static objects can still remove themselves.
+  static StatsRegistry *registry = new StatsRegistry;
+  return *registry;
+}
+
+// Returns the statistics of the calling thread or null if they have been
+// destroyed, e.g. when formatting from a destructor of a thread-local
+// object.
+FMT_FUNC ThreadStats *current_thread_stats() {
+  static thread_local bool destroyed = false;
+  struct Holder {
+    ThreadStats stats;
+    ~Holder() { destroyed = true; }
+  };
+  static thread_local Holder holder;
+  return destroyed ? 0 : &holder.stats;
+}
+
+FMT_FUNC ThreadStats::ThreadStats() {
+  for (int i = 0; i < NUM_STATS_COUNTERS; ++i)
+    counters[i].store(0, std::memory_order_relaxed);
+  StatsRegistry &registry = stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.threads.push_back(this);
+}
+
+FMT_FUNC ThreadStats::~ThreadStats() {
+  StatsRegistry &registry = stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (int i = 0; i < NUM_STATS_COUNTERS; ++i)
+    registry.exited[i] += counters[i].load(std::memory_order_relaxed);
+#if FMT_USE_FORMAT_TIMING
+  for (FormatTimingMap::const_iterator
+       it = timings.begin(), end = timings.end(); it != end; ++it) {
+    registry.exited_timings.push_back(it->second.timing);
+  }
+#endif
+  registry.threads.erase(
+        std::find(registry.threads.begin(), registry.threads.end(), this));
+}
+
+// Converts counters to Stats.
+FMT_FUNC Stats make_stats(const ULongLong *counters) {
+  Stats stats;
+  stats.buffer_grows = counters[BUFFER_GROWS];
+  stats.inline_buffer_spills = counters[INLINE_BUFFER_SPILLS];
+  stats.bytes_allocated = counters[BYTES_ALLOCATED];
+  stats.double_snprintf_calls = counters[DOUBLE_SNPRINTF_CALLS];
+  stats.double_snprintf_retries = counters[DOUBLE_SNPRINTF_RETRIES];
+  stats.ostream_fallbacks = counters[OSTREAM_FALLBACKS];
+  stats.arg_map_builds = counters[ARG_MAP_BUILDS];
+  return stats;
+}
+
+FMT_FUNC void load_counters(const ThreadStats &stats, ULongLong *counters) {
+  for (int i = 0; i < NUM_STATS_COUNTERS; ++i)
+    counters[i] += stats.counters[i].load(std::memory_order_relaxed);
+}
+
+#if FMT_USE_FORMAT_TIMING
+// Adds the time of one formatting call with the specified format string
+// to the calling thread's histogram.
+template <typename Char>
+void record_format_time(const Char *format, std::size_t size,
+                        ULongLong ns) {
+  ThreadStats *stats = current_thread_stats();
+  if (!stats)
+    return;
+  const char *data = reinterpret_cast<const char*>(format);
+  std::size_t num_bytes = size * sizeof(Char);
+  std::size_t hash = hash_bytes(data, num_bytes);
+  std::lock_guard<std::mutex> lock(stats->timing_mutex);
+  typedef FormatTimingMap::iterator Iterator;
+  std::pair<Iterator, Iterator> range = stats->timings.equal_range(hash);
+  Iterator it = range.first;
+  for (; it != range.second; ++it) {
+    const std::string &content = it->second.content;
+    if (content.size() == num_bytes &&
+        memcmp(content.data(), data, num_bytes) == 0) {
+      break;
+    }
+  }
+  if (it == range.second) {
+    if (stats->timings.size() >= MAX_FORMAT_TIMINGS)
+      return;
+    FormatTimingEntry entry;
+    entry.content.assign(data, num_bytes);
+    entry.timing = FormatTiming();
+    entry.timing.format.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      Char c = format[i];
+      entry.timing.format.push_back(
+            c >= 0 && c < 0x80 ? static_cast<char>(c) : '?');
+    }
+    it = stats->timings.insert(std::make_pair(hash, entry));
+  }
+  FormatTiming &timing = it->second.timing;
+  ++timing.count;
+  timing.total_ns += ns;
+  int bucket = 0;
+  while (bucket < FormatTiming::NUM_BUCKETS - 1 && (ns >> (bucket + 1)) != 0)
+    ++bucket;
+  ++timing.buckets[bucket];
+}
+
+// Adds the timing b to a.
+FMT_FUNC void merge_timing(FormatTiming &a, const FormatTiming &b) {
+  a.count += b.count;
+  a.total_ns += b.total_ns;
+  for (int i = 0; i < FormatTiming::NUM_BUCKETS; ++i)
+    a.buckets[i] += b.buckets[i];
+}
+
+FMT_FUNC bool has_greater_total(const FormatTiming &a,
+                                const FormatTiming &b) {
+  return a.total_ns > b.total_ns;
+}
+#endif
+}  // namespace internal
+}  // namespace fmt
+
+FMT_FUNC void fmt::internal::add_stat(StatsCounter counter, ULongLong value) {
+  if (ThreadStats *stats = current_thread_stats())
+    stats->counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+FMT_FUNC fmt::Stats fmt::thread_stats() {
+  ULongLong counters[internal::NUM_STATS_COUNTERS] = {};
+  if (internal::ThreadStats *stats = internal::current_thread_stats())
+    internal::load_counters(*stats, counters);
+  return internal::make_stats(counters);
+}
+
+FMT_FUNC fmt::Stats fmt::collect_stats() {
+  internal::StatsRegistry &registry = internal::stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  ULongLong counters[internal::NUM_STATS_COUNTERS];
+  std::copy(registry.exited, registry.exited + internal::NUM_STATS_COUNTERS,
+            counters);
+  for (std::size_t i = 0, n = registry.threads.size(); i < n; ++i)
+    internal::load_counters(*registry.threads[i], counters);
+  return internal::make_stats(counters);
+}
+
+FMT_FUNC void fmt::reset_stats() {
+  internal::StatsRegistry &registry = internal::stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::fill_n(registry.exited, internal::NUM_STATS_COUNTERS, 0);
+  for (std::size_t i = 0, n = registry.threads.size(); i < n; ++i) {
+    internal::ThreadStats &stats = *registry.threads[i];
+    for (int j = 0; j < internal::NUM_STATS_COUNTERS; ++j)
+      stats.counters[j].store(0, std::memory_order_relaxed);
+#if FMT_USE_FORMAT_TIMING
+    std::lock_guard<std::mutex> timing_lock(stats.timing_mutex);
+    stats.timings.clear();
+#endif
+  }
+#if FMT_USE_FORMAT_TIMING
+  registry.exited_timings.clear();
+#endif
+}
+
+#if FMT_USE_FORMAT_TIMING
+FMT_FUNC std::vector<fmt::FormatTiming> fmt::collect_format_timings() {
+  std::map<std::string, FormatTiming> merged;
+  internal::StatsRegistry &registry = internal::stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (std::size_t i = 0, n = registry.exited_timings.size(); i < n; ++i) {
+    const FormatTiming &timing = registry.exited_timings[i];
+    FormatTiming &result = merged[timing.format];
+    result.format = timing.format;
+    internal::merge_timing(result, timing);
+  }
+  for (std::size_t i = 0, n = registry.threads.size(); i < n; ++i) {
+    internal::ThreadStats &stats = *registry.threads[i];
+    std::lock_guard<std::mutex> timing_lock(stats.timing_mutex);
+    for (internal::FormatTimingMap::const_iterator
+         it = stats.timings.begin(), end = stats.timings.end();
+         it != end; ++it) {
+      const FormatTiming &timing = it->second.timing;
+      FormatTiming &result = merged[timing.format];
+      result.format = timing.format;
+      internal::merge_timing(result, timing);
+    }
+  }
+  std::vector<FormatTiming> timings;
+  timings.reserve(merged.size());
+  for (std::map<std::string, FormatTiming>::const_iterator
+       it = merged.begin(), end = merged.end(); it != end; ++it) {
+    timings.push_back(it->second);
+  }
+  std::stable_sort(timings.begin(), timings.end(),
+                   internal::has_greater_total);
+  return timings;
+}
+
+namespace {
+// Records the time from construction to destruction in the timing
+// histogram of a format string.
+template <typename Char>
+class FormatTimer {
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  fmt::BasicStringRef<Char> format_;
+  Clock::time_point start_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(FormatTimer);
+
+ public:
+  explicit FormatTimer(fmt::BasicStringRef<Char> format)
+  : format_(format), start_(Clock::now()) {}
+
+  ~FormatTimer() {
+    fmt::ULongLong ns = static_cast<fmt::ULongLong>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start_).count());
+    fmt::internal::record_format_time(format_.data(), format_.size(), ns);
+  }
+};
+}  // namespace
+#endif
+#endif  // FMT_USE_STATS
+
+template <typename Char>
+bool fmt::BasicFormatter<Char>::format(
+    BasicStringRef<Char> format_str, internal::FormatErrorInfo &error) {
+#if FMT_USE_FORMAT_TIMING
+  FormatTimer<Char> timer(format_str);
+#endif
+  const Char *s = format_str.data();
+  const Char *end = s + format_str.size();
+  const Char *start = s;
+  while ((s = find_special(s, end, Char('{'), Char('}'))) != end) {
+    Char c = *s++;
+    if (s != end && *s == c) {
+      write(writer_, start, s);
+      start = ++s;
+      continue;
+    }
+    if (c == '}') {
+      error.message = "unmatched '}' in format string";
+      return false;
+    }
+    write(writer_, start, s - 1);
+    FormatField<Char> field(s, end, is_field_closed(s, end));
+    const Char *p = field.data();
+    Arg arg = is_name_start(*p) ?
+          parse_arg_name(p, error.message) : parse_arg_index(p, error.message);
+    if (error.message)
+      return false;
+    const Char *field_end = format(p, arg, error);
+    if (!field_end)
+      return false;
+    start = s = field.map(field_end);
+  }
+  write(writer_, start, end);
+  return true;
+}
+
+template <typename Char>
+void fmt::BasicFormatter<Char>::format(BasicStringRef<Char> format_str) {
+  internal::FormatErrorInfo error;
+  if (!format(format_str, error))
+    throw_format_error(error);
+}
+
+template <typename Char>
+std::size_t fmt::BasicFormatter<Char>::count(BasicStringRef<Char> format_str) {
+  std::size_t size = 0;
+  const Char *s = format_str.data();
+  const Char *end = s + format_str.size();
+  const Char *start = s;
+  while ((s = find_special(s, end, Char('{'), Char('}'))) != end) {
+    Char c = *s++;
+    if (s != end && *s == c) {
+      size += s - start;
+      start = ++s;
+      continue;
+    }
+    if (c == '}')
+      FMT_THROW(FormatError("unmatched '}' in format string"));
+    size += s - 1 - start;
+    FormatField<Char> field(s, end, is_field_closed(s, end));
+    const Char *p = field.data();
+    Arg arg = is_name_start(*p) ? parse_arg_name(p) : parse_arg_index(p);
+    if (*p == '}') {
+      if (std::size_t arg_size = DefaultSizeVisitor().visit(arg)) {
+        size += arg_size;
+        start = s = field.map(p + 1);
+        continue;
+      }
+    }
+    writer_.clear();
+    start = s = field.map(format(p, arg));
+    size += writer_.size();
+  }
+  return size + (end - start);
+}
+
+template <typename Char>
+void fmt::BasicCompiledFormat<Char>::compile() {
+  using internal::ArgRef;
+  using internal::FormatItem;
+  const Char *format = this->format_.c_str();
+  const Char *s = format;
+  const Char *start = s;
+  ArgIndexer indexer;
+  while (Char c = *(s = find_special(s, Char('{'), Char('}')))) {
+    ++s;
+    if (*s == c) {
+      this->add_item(start, s);
+      start = ++s;
+      continue;
+    }
+    if (c == '}')
+      FMT_THROW(FormatError("unmatched '}' in format string"));
+    FormatItem &item = this->add_item(start, s - 1);
+    item.arg = parse_arg_ref(s, format, indexer);
+    ArgIndexer saved_indexer = indexer;
+    const Char *end = parse_compiled_spec(s, format, item, indexer);
+    if (!end) {
+      if (*s != ':')
+        FMT_THROW(FormatError("missing '}' in format string"));
+      // Defer parsing until the argument type is known.
+      indexer = saved_indexer;
+      item.width_arg = item.precision_arg = ArgRef();
+      item.flags = FormatItem::PARSE_AT_RUNTIME;
+      for (end = s; *end != '}'; ++end) {
+        if (!*end)
+          FMT_THROW(FormatError("missing '}' in format string"));
+      }
+      ++end;
+    }
+    add_name(item.arg);
+    add_name(item.width_arg);
+    add_name(item.precision_arg);
+    start = s = end;
+  }
+  if (start != s)
+    this->add_item(start, s);
+}
+
+template <typename Char>
+void fmt::BasicCompiledFormat<Char>::add_name(internal::ArgRef &ref) {
+  if (ref.kind != internal::ArgRef::NAME)
+    return;
+  const Char *format = this->format_.c_str();
+  std::size_t num_names = names_.size();
+  unsigned i = 0;
+  for (; i != num_names; ++i) {
+    const internal::ArgRef &name = names_[i];
+    if (name.name_size == ref.name_size &&
+        std::char_traits<Char>::compare(format + name.index,
+            format + ref.index, ref.name_size) == 0) {
+      break;
+    }
+  }
+  if (i == num_names)
+    names_.push_back(ref);
+  ref.index = i;
+}
+
+template <typename Char>
+void fmt::BasicCompiledFormat<Char>::format(
+    BasicWriter<Char> &w, ArgList args) const {
+  using internal::ArgRef;
+  using internal::FormatItem;
+#if FMT_USE_FORMAT_TIMING
+  FormatTimer<Char> timer(this->format_);
+#endif
+  BasicFormatter<Char> formatter(args, w);
+  const Char *format = this->format_.c_str();
+  // Look up each distinct name once rather than for every reference to it.
+  internal::MemoryBuffer<Arg, 16> named_args;
+  if (std::size_t num_names = names_.size()) {
+    internal::ArgMap<Char> map;
+    map.init(args);
+    named_args.resize(num_names);
+    for (std::size_t i = 0; i != num_names; ++i) {
+      const ArgRef &name = names_[i];
+      const Arg *arg = map.find(
+            BasicStringRef<Char>(format + name.index, name.name_size));
+      if (arg)
+        named_args[i] = *arg;
+      else
+        named_args[i].type = Arg::NONE;
+    }
+  }
+  const Arg *named = &named_args[0];
+  for (std::vector<FormatItem>::const_iterator
+       it = this->items_.begin(), end = this->items_.end(); it != end; ++it) {
+    const FormatItem &item = *it;
+    this->write_text(w, item);
+    if (item.arg.kind == ArgRef::NONE)
+      continue;
+    Arg arg = get_compiled_arg(args, named, item.arg);
+    const Char *s = format + item.spec_offset;
+    if (arg.type == Arg::CUSTOM) {
+      arg.custom.format(&formatter, arg.custom.value, &s);
+      continue;
+    }
+    if ((item.flags & FormatItem::PARSE_AT_RUNTIME) != 0) {
+      formatter.format(s, arg);
+      continue;
+    }
+    if ((item.flags & FormatItem::CHECK_NUMERIC_ALIGN) != 0)
+      require_numeric_argument(arg, '=');
+    if (item.sign) {
+      const char *sign = &item.sign;
+      check_sign(sign, arg);
+    }
+    if ((item.flags & FormatItem::CHECK_HASH) != 0)
+      require_numeric_argument(arg, '#');
+    if ((item.flags & FormatItem::CHECK_ZERO) != 0)
+      require_numeric_argument(arg, '0');
+    FormatSpec spec = item.spec;
+    if (item.width_arg.kind != ArgRef::NONE) {
+      spec.width_ = get_dynamic_spec(
+            get_compiled_arg(args, named, item.width_arg), true);
+    }
+    if (item.precision_arg.kind != ArgRef::NONE) {
+      spec.precision_ = static_cast<int>(get_dynamic_spec(
+            get_compiled_arg(args, named, item.precision_arg), false));
+    }
+    if ((item.flags & FormatItem::CHECK_PRECISION) != 0 &&
+        (arg.type <= Arg::LAST_INTEGER_TYPE || arg.type == Arg::POINTER)) {
+      FMT_THROW(FormatError(
+          fmt::format("precision not allowed in {} format specifier",
+          arg.type == Arg::POINTER ? "pointer" : "integer")));
+    }
+    internal::ArgFormatter<Char>(formatter, spec, s).visit(arg);
+  }
+}
+
+template <typename Char>
+void fmt::BasicCompiledPrintfFormat<Char>::compile() {
+  using internal::FormatItem;
+  const Char *s = this->format_.c_str();
+  const Char *start = s;
+  ArgIndexer indexer;
+  while (Char c = *(s = find_special(s, Char('%'), Char('%')))) {
+    ++s;
+    if (*s == c) {
+      this->add_item(start, s);
+      start = ++s;
+      continue;
+    }
+    FormatItem &item = this->add_item(start, s - 1);
+    FormatSpec &spec = item.spec;
+    spec.align_ = ALIGN_RIGHT;
+
+    // Parse argument index, flags and width.
+    unsigned arg_index = UINT_MAX;
+    c = *s;
+    if (c >= '0' && c <= '9') {
+      // Parse an argument index (if followed by '$') or a width possibly
+      // preceded with '0' flag(s).
+      unsigned value = parse_nonnegative_int(s);
+      if (*s == '$') {  // value is an argument index
+        ++s;
+        arg_index = value;
+      } else {
+        if (c == '0')
+          spec.fill_ = '0';
+        spec.width_ = value;
+      }
+    }
+    if (spec.width_ == 0) {
+      internal::PrintfFormatter<Char>::parse_flags(spec, s);
+      // Parse width.
+      if (*s >= '0' && *s <= '9') {
+        spec.width_ = parse_nonnegative_int(s);
+      } else if (*s == '*') {
+        ++s;
+        item.width_arg = get_printf_arg_ref(s, indexer);
       }
-      if (value > INT_MAX)
-        FMT_THROW(FormatError("number is too big"));
-      spec.width_ = static_cast<int>(value);
     }
 
     // Parse precision.
     if (*s == '.') {
       ++s;
-      spec.precision_ = 0;
       if ('0' <= *s && *s <= '9') {
         spec.precision_ = parse_nonnegative_int(s);
-      } else if (*s == '{') {
+      } else if (*s == '*') {
         ++s;
-        Arg precision_arg =
-            is_name_start(*s) ? parse_arg_name(s) : parse_arg_index(s);
-        if (*s++ != '}')
-          FMT_THROW(FormatError("invalid format string"));
-        ULongLong value = 0;
-        switch (precision_arg.type) {
-          case Arg::INT:
-            if (precision_arg.int_value < 0)
-              FMT_THROW(FormatError("negative precision"));
-            value = precision_arg.int_value;
-            break;
-          case Arg::UINT:
-            value = precision_arg.uint_value;
-            break;
-          case Arg::LONG_LONG:
-            if (precision_arg.long_long_value < 0)
-              FMT_THROW(FormatError("negative precision"));
-            value = precision_arg.long_long_value;
-            break;
-          case Arg::ULONG_LONG:
-            value = precision_arg.ulong_long_value;
-            break;
-          default:
-            FMT_THROW(FormatError("precision is not integer"));
-        }
-        if (value > INT_MAX)
-          FMT_THROW(FormatError("number is too big"));
-        spec.precision_ = static_cast<int>(value);
-      } else {
-        FMT_THROW(FormatError("missing precision specifier"));
-      }
-      if (arg.type <= Arg::LAST_INTEGER_TYPE || arg.type == Arg::POINTER) {
-        FMT_THROW(FormatError(
-            fmt::format("precision not allowed in {} format specifier",
-            arg.type == Arg::POINTER ? "pointer" : "integer")));
+        item.precision_arg = get_printf_arg_ref(s, indexer);
       }
     }
 
+    item.arg = get_printf_arg_ref(s, indexer, arg_index);
+    item.length = parse_length(s);
+
     // Parse type.
-    if (*s != '}' && *s)
-      spec.type_ = static_cast<char>(*s++);
+    if (!*s)
+      FMT_THROW(FormatError("invalid format string"));
+    spec.type_ = static_cast<char>(*s++);
+    start = s;
   }
+  if (start != s)
+    this->add_item(start, s);
+}
 
-  if (*s++ != '}')
-    FMT_THROW(FormatError("missing '}' in format string"));
-
-  // Format argument.
-  internal::ArgFormatter<Char>(*this, spec, s - 1).visit(arg);
-  return s;
+template <typename Char>
+void fmt::BasicCompiledPrintfFormat<Char>::format(
+    BasicWriter<Char> &w, ArgList args) const {
+  using internal::ArgRef;
+  using internal::FormatItem;
+  for (std::vector<FormatItem>::const_iterator
+       it = this->items_.begin(), end = this->items_.end(); it != end; ++it) {
+    const FormatItem &item = *it;
+    this->write_text(w, item);
+    if (item.arg.kind == ArgRef::NONE)
+      continue;
+    FormatSpec spec = item.spec;
+    if (item.width_arg.kind != ArgRef::NONE) {
+      spec.width_ = WidthHandler(spec).visit(
+            get_compiled_arg(args, 0, item.width_arg));
+    }
+    if (item.precision_arg.kind != ArgRef::NONE) {
+      spec.precision_ = PrecisionHandler().visit(
+            get_compiled_arg(args, 0, item.precision_arg));
+    }
+    internal::format_printf_arg(
+          w, spec, get_compiled_arg(args, 0, item.arg), item.length);
+  }
 }
 
 template <typename Char>
-void fmt::BasicFormatter<Char>::format(BasicCStringRef<Char> format_str) {
-  const Char *s = format_str.c_str();
-  const Char *start = s;
-  while (*s) {
-    Char c = *s++;
-    if (c != '{' && c != '}') continue;
-    if (*s == c) {
-      write(writer_, start, s);
-      start = ++s;
+void fmt::internal::format_static(
+    BasicWriter<Char> &w, const Char *format,
+    const StaticFormatItem *items, std::size_t num_items, ArgList args) {
+  BasicFormatter<Char> formatter(args, w);
+  for (const StaticFormatItem *item = items, *end = items + num_items;
+       item != end; ++item) {
+    if (item->text_size != 0)
+      w << BasicStringRef<Char>(format + item->text_offset, item->text_size);
+    if (item->arg_index < 0)
+      continue;
+    Arg arg = args[static_cast<unsigned>(item->arg_index)];
+    const Char *s = format + item->spec_offset;
+    if (arg.type == Arg::CUSTOM) {
+      arg.custom.format(&formatter, arg.custom.value, &s);
       continue;
     }
-    if (c == '}')
-      FMT_THROW(FormatError("unmatched '}' in format string"));
-    write(writer_, start, s - 1);
-    Arg arg = is_name_start(*s) ? parse_arg_name(s) : parse_arg_index(s);
-    start = s = format(s, arg);
+    FormatSpec spec(item->width, item->type, item->fill);
+    spec.align_ = item->align;
+    spec.flags_ = item->flags;
+    spec.precision_ = item->precision;
+    if (item->width_index >= 0) {
+      spec.width_ = get_dynamic_spec(
+            args[static_cast<unsigned>(item->width_index)], true);
+    }
+    if (item->precision_index >= 0) {
+      spec.precision_ = static_cast<int>(get_dynamic_spec(
+            args[static_cast<unsigned>(item->precision_index)], false));
+    }
+    ArgFormatter<Char>(formatter, spec, s).visit(arg);
+  }
+}
+
+template <typename Char>
+void fmt::BasicFormatRecord<Char>::destroy_custom_args() {
+  for (std::size_t i = 0; i < num_custom_args_; ++i)
+    custom_args_[i].destroy(custom_args_[i].value);
+  num_custom_args_ = 0;
+}
+
+template <typename Char>
+void fmt::BasicFormatRecord<Char>::capture(
+    BasicStringRef<Char> format_str, ArgList args) {
+  typedef internal::NamedArg<Char> NamedArg;
+  destroy_custom_args();
+  format_ = 0;
+
+  // Compute the storage size. The storage consists of the argument array,
+  // named arguments, copies of custom arguments and strings in this order
+  // which is the order of decreasing alignment.
+  RecordStrings strings;
+  // The copy of the format string is null-terminated so that the storage
+  // is never empty.
+  strings.reserve(format_str.data(), format_str.size() + 1);
+  std::size_t num_args = 0, num_named_args = 0, num_custom_args = 0;
+  for (;; ++num_args) {
+    Arg arg = args[static_cast<unsigned>(num_args)];
+    if (arg.type == Arg::NONE)
+      break;
+    if (arg.type == Arg::NAMED_ARG) {
+      const NamedArg &named = *static_cast<const NamedArg*>(arg.pointer);
+      strings.reserve(named.name.data(), named.name.size());
+      ++num_named_args;
+      arg = named;
+    }
+    reserve_arg(strings, arg, num_custom_args);
+  }
+  // Arguments are stored as values followed by packed types if the latter
+  // don't fit into types_.
+  std::size_t num_values = num_args;
+  if (num_args >= ArgList::MAX_PACKED_ARGS) {
+    num_values += (num_args + ArgList::MAX_PACKED_ARGS - 1) /
+        ArgList::MAX_PACKED_ARGS;
+  }
+  std::size_t named_offset = num_values * sizeof(internal::Value);
+  std::size_t custom_offset = named_offset + num_named_args * sizeof(NamedArg);
+  std::size_t strings_offset =
+      custom_offset + num_custom_args * sizeof(internal::CustomArgCopy);
+  std::size_t size = strings_offset + strings.size();
+  if (size > capacity_) {
+    char *data = new char[size];
+    delete [] data_;
+    data_ = data;
+    capacity_ = size;
+  }
+
+  NamedArg *named_args = reinterpret_cast<NamedArg*>(data_ + named_offset);
+  custom_args_ =
+      reinterpret_cast<internal::CustomArgCopy*>(data_ + custom_offset);
+  strings.set_data(data_ + strings_offset);
+  internal::Value *values = reinterpret_cast<internal::Value*>(data_);
+  ULongLong types = 0;
+  for (std::size_t i = 0; i < num_args; ++i) {
+    Arg arg = args[static_cast<unsigned>(i)];
+    if (arg.type == Arg::NAMED_ARG) {
+      const NamedArg &named = *static_cast<const NamedArg*>(arg.pointer);
+      NamedArg *copy = new (named_args++) NamedArg(named);
+      copy->name = BasicStringRef<Char>(
+            strings.copy(named.name.data(), named.name.size()),
+            named.name.size());
+      copy_arg(strings, *copy, custom_args_, num_custom_args_);
+      arg.pointer = copy;
+    } else {
+      copy_arg(strings, arg, custom_args_, num_custom_args_);
+    }
+    std::size_t shift = i % ArgList::MAX_PACKED_ARGS * 4;
+    types |= static_cast<ULongLong>(arg.type) << shift;
+    values[i] = arg;
+    if (num_values != num_args &&
+        (shift == 60 || i + 1 == num_args)) {
+      values[num_args + i / ArgList::MAX_PACKED_ARGS].ulong_long_value = types;
+      types = 0;
+    }
   }
-  write(writer_, start, s);
+  types_ = types;
+  num_args_ = num_args;
+  format_ = strings.copy(format_str.data(), format_str.size());
+  format_size_ = format_str.size();
+  const Char terminator = 0;
+  strings.copy(&terminator, 1);
 }
 
 FMT_FUNC void fmt::report_system_error(
@@ -1229,23 +3594,56 @@ FMT_FUNC void fmt::report_windows_error(
 }
 #endif
 
-FMT_FUNC void fmt::print(std::FILE *f, CStringRef format_str, ArgList args) {
-  MemoryWriter w;
+FMT_FUNC void fmt::print(std::FILE *f, StringRef format_str, ArgList args) {
+  PrintBuffer buffer;
+  internal::BufferWriter<char> w(buffer.get());
   w.write(format_str, args);
   std::fwrite(w.data(), 1, w.size(), f);
 }
 
-FMT_FUNC void fmt::print(CStringRef format_str, ArgList args) {
+FMT_FUNC void fmt::print(StringRef format_str, ArgList args) {
+  print(stdout, format_str, args);
+}
+
+FMT_FUNC void fmt::print(
+    std::FILE *f, const CompiledFormat &format_str, ArgList args) {
+  PrintBuffer buffer;
+  internal::BufferWriter<char> w(buffer.get());
+  format_str.format(w, args);
+  std::fwrite(w.data(), 1, w.size(), f);
+}
+
+FMT_FUNC void fmt::print(const CompiledFormat &format_str, ArgList args) {
   print(stdout, format_str, args);
 }
 
-FMT_FUNC void fmt::print(std::ostream &os, CStringRef format_str, ArgList args) {
+FMT_FUNC void fmt::set_buffer_cache_limit(std::size_t limit) {
+#if FMT_USE_BUFFER_CACHE
+  buffer_cache_limit.store(limit, std::memory_order_relaxed);
+#else
+  (void)limit;
+#endif
+}
+
+FMT_FUNC std::size_t fmt::formatted_size(StringRef format_str, ArgList args) {
   MemoryWriter w;
+  return BasicFormatter<char>(args, w).count(format_str);
+}
+
+FMT_FUNC std::size_t fmt::formatted_size(
+    WStringRef format_str, ArgList args) {
+  WMemoryWriter w;
+  return BasicFormatter<wchar_t>(args, w).count(format_str);
+}
+
+FMT_FUNC void fmt::print(std::ostream &os, StringRef format_str, ArgList args) {
+  PrintBuffer buffer;
+  internal::BufferWriter<char> w(buffer.get());
   w.write(format_str, args);
   os.write(w.data(), w.size());
 }
 
-FMT_FUNC void fmt::print_colored(Color c, CStringRef format, ArgList args) {
+FMT_FUNC void fmt::print_colored(Color c, StringRef format, ArgList args) {
   char escape[] = "\x1b[30m";
   escape[3] = '0' + static_cast<char>(c);
   std::fputs(escape, stdout);
@@ -1253,14 +3651,498 @@ FMT_FUNC void fmt::print_colored(Color c, CStringRef format, ArgList args) {
   std::fputs(RESET_COLOR, stdout);
 }
 
-FMT_FUNC int fmt::fprintf(std::FILE *f, CStringRef format, ArgList args) {
-  MemoryWriter w;
+FMT_FUNC int fmt::fprintf(std::FILE *f, StringRef format, ArgList args) {
+  PrintBuffer buffer;
+  internal::BufferWriter<char> w(buffer.get());
   printf(w, format, args);
   std::size_t size = w.size();
   return std::fwrite(w.data(), 1, size, f) < size ? -1 : static_cast<int>(size);
 }
 
-#ifndef FMT_HEADER_ONLY
+FMT_FUNC int fmt::fprintf(
+    std::FILE *f, const CompiledPrintfFormat &format, ArgList args) {
+  PrintBuffer buffer;
+  internal::BufferWriter<char> w(buffer.get());
+  format.format(w, args);
+  std::size_t size = w.size();
+  return std::fwrite(w.data(), 1, size, f) < size ? -1 : static_cast<int>(size);
+}
+
+namespace {
+const char *const WEEKDAYS[] = {
+  "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday",
+  "Saturday"
+};
+
+const char *const MONTHS[] = {
+  "January", "February", "March", "April", "May", "June", "July",
+  "August", "September", "October", "November", "December"
+};
+
+// Writes time to a buffer according to a strftime-like format string.
+template <typename Char>
+class TimeWriter {
+ private:
+  fmt::Buffer<Char> &buffer_;
+  const std::tm &time_;
+  fmt::ULongLong subsec_;
+  int subsec_digits_;
+  std::vector<std::size_t> *seconds_offsets_;
+
+  void write_char(char c) { buffer_.push_back(c); }
+
+  // Writes a value in the range [0, 99] as two digits.
+  void write2(unsigned value) {
+    unsigned index = value * 2;
+    buffer_.push_back(fmt::internal::Data::DIGITS[index]);
+    buffer_.push_back(fmt::internal::Data::DIGITS[index + 1]);
+  }
+
+  // Writes a value with at least num_digits digits padded with zeros.
+  void write_int(int value, unsigned num_digits, char fill = '0') {
+    if (value >= 0 && value < 100 && num_digits == 2 && fill == '0')
+      return write2(static_cast<unsigned>(value));
+    unsigned abs_value = static_cast<unsigned>(value);
+    if (value < 0) {
+      write_char('-');
+      abs_value = 0 - abs_value;
+    }
+    unsigned count = fmt::internal::count_digits(abs_value);
+    for (; count < num_digits; ++count)
+      write_char(fill);
+    fmt::FormatInt digits(abs_value);
+    buffer_.append(digits.data(), digits.data() + digits.size());
+  }
+
+  void write_name(const char *const *names, int index, int num_names,
+                  bool full) {
+    if (index < 0 || index >= num_names)
+      FMT_THROW(fmt::FormatError("time field out of range"));
+    const char *name = names[index];
+    buffer_.append(name, name + (full ? strlen(name) : 3));
+  }
+
+  void write_year() { write_int(time_.tm_year + 1900, 4); }
+
+  void write_hour12() {
+    int hour = time_.tm_hour % 12;
+    write_int(hour == 0 ? 12 : hour, 2);
+  }
+
+  void write_am_pm() {
+    write_char(time_.tm_hour < 12 ? 'A' : 'P');
+    write_char('M');
+  }
+
+  void write_seconds() {
+    if (seconds_offsets_)
+      seconds_offsets_->push_back(buffer_.size());
+    write_int(time_.tm_sec, 2);
+    if (subsec_digits_ != 0) {
+      write_char('.');
+      write_subsec(buffer_.size(), subsec_, subsec_digits_);
+    }
+  }
+
+ public:
+  TimeWriter(fmt::Buffer<Char> &buffer, const std::tm &time,
+             fmt::ULongLong subsec, int subsec_digits,
+             std::vector<std::size_t> *seconds_offsets)
+  : buffer_(buffer), time_(time), subsec_(subsec),
+    subsec_digits_(subsec_digits), seconds_offsets_(seconds_offsets) {}
+
+  // Writes num_digits low-order decimal digits of value to the buffer at
+  // the position offset, extending the buffer if necessary.
+  void write_subsec(std::size_t offset, fmt::ULongLong value,
+                    int num_digits) {
+    if (buffer_.size() < offset + num_digits)
+      buffer_.resize(offset + num_digits);
+    for (Char *p = &buffer_[offset] + num_digits; num_digits > 0;
+         --num_digits) {
+      *--p = static_cast<char>('0' + value % 10);
+      value /= 10;
+    }
+  }
+
+  void write(const Char *s, const Char *end) {
+    while (s != end) {
+      const Char *start = s;
+      while (s != end && *s != '%')
+        ++s;
+      buffer_.append(start, s);
+      if (s == end)
+        break;
+      if (++s == end)
+        FMT_THROW(fmt::FormatError("invalid time format"));
+      switch (*s++) {
+      case '%':
+        write_char('%');
+        break;
+      case 'n':
+        write_char('\n');
+        break;
+      case 't':
+        write_char('\t');
+        break;
+      case 'a':
+        write_name(WEEKDAYS, time_.tm_wday, 7, false);
+        break;
+      case 'A':
+        write_name(WEEKDAYS, time_.tm_wday, 7, true);
+        break;
+      case 'b': case 'h':
+        write_name(MONTHS, time_.tm_mon, 12, false);
+        break;
+      case 'B':
+        write_name(MONTHS, time_.tm_mon, 12, true);
+        break;
+      case 'C': {
+        int year = time_.tm_year + 1900;
+        write_int(year >= 0 ? year / 100 : -((99 - year) / 100), 2);
+        break;
+      }
+      case 'd':
+        write_int(time_.tm_mday, 2);
+        break;
+      case 'D':
+        write_int(time_.tm_mon + 1, 2);
+        write_char('/');
+        write_int(time_.tm_mday, 2);
+        write_char('/');
+        write_int(((time_.tm_year + 1900) % 100 + 100) % 100, 2);
+        break;
+      case 'e':
+        write_int(time_.tm_mday, 2, ' ');
+        break;
+      case 'F':
+        write_year();
+        write_char('-');
+        write_int(time_.tm_mon + 1, 2);
+        write_char('-');
+        write_int(time_.tm_mday, 2);
+        break;
+      case 'H':
+        write_int(time_.tm_hour, 2);
+        break;
+      case 'I':
+        write_hour12();
+        break;
+      case 'j':
+        write_int(time_.tm_yday + 1, 3);
+        break;
+      case 'm':
+        write_int(time_.tm_mon + 1, 2);
+        break;
+      case 'M':
+        write_int(time_.tm_min, 2);
+        break;
+      case 'p':
+        write_am_pm();
+        break;
+      case 'r':
+        write_hour12();
+        write_char(':');
+        write_int(time_.tm_min, 2);
+        write_char(':');
+        write_seconds();
+        write_char(' ');
+        write_am_pm();
+        break;
+      case 'R':
+        write_int(time_.tm_hour, 2);
+        write_char(':');
+        write_int(time_.tm_min, 2);
+        break;
+      case 'S':
+        write_seconds();
+        break;
+      case 'T':
+        write_int(time_.tm_hour, 2);
+        write_char(':');
+        write_int(time_.tm_min, 2);
+        write_char(':');
+        write_seconds();
+        break;
+      case 'u':
+        write_int(time_.tm_wday == 0 ? 7 : time_.tm_wday, 1);
+        break;
+      case 'w':
+        write_int(time_.tm_wday, 1);
+        break;
+      case 'y':
+        write_int(((time_.tm_year + 1900) % 100 + 100) % 100, 2);
+        break;
+      case 'Y':
+        write_year();
+        break;
+      default:
+        FMT_THROW(fmt::FormatError("invalid time format"));
+      }
+    }
+  }
+};
+
+// The default time format, "%Y-%m-%d %H:%M:%S".
+const char DEFAULT_TIME_FORMAT[] = "%Y-%m-%d %H:%M:%S";
+
+// Returns floor(a / b) for b > 0.
+inline fmt::LongLong floor_div(fmt::LongLong a, fmt::LongLong b) {
+  return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+}  // namespace
+
+template <typename Char>
+fmt::BasicStringRef<Char> fmt::internal::parse_time_format(
+    const Char *&format_str) {
+  const Char *s = format_str;
+  if (*s == ':')
+    ++s;
+  const Char *end = s;
+  while (*end && *end != '}')
+    ++end;
+  if (*end != '}')
+    FMT_THROW(FormatError("missing '}' in format string"));
+  format_str = end + 1;
+  return BasicStringRef<Char>(s, end - s);
+}
+
+template <typename Char>
+void fmt::internal::format_time(
+    Buffer<Char> &buffer, BasicStringRef<Char> format, const std::tm &time,
+    ULongLong subsec, int subsec_digits,
+    std::vector<std::size_t> *seconds_offsets) {
+  TimeWriter<Char> w(buffer, time, subsec, subsec_digits, seconds_offsets);
+  if (format.size() != 0) {
+    w.write(format.data(), format.data() + format.size());
+    return;
+  }
+  enum { DEFAULT_FORMAT_SIZE = sizeof(DEFAULT_TIME_FORMAT) - 1 };
+  Char default_format[DEFAULT_FORMAT_SIZE];
+  std::copy(DEFAULT_TIME_FORMAT,
+            DEFAULT_TIME_FORMAT + DEFAULT_FORMAT_SIZE, default_format);
+  w.write(default_format, default_format + DEFAULT_FORMAT_SIZE);
+}
+
+FMT_FUNC std::tm fmt::internal::utc_time(LongLong seconds) {
+  // Converts days since the epoch to a civil date in the proleptic
+  // Gregorian calendar, using eras of 400 years starting from March 1.
+  LongLong days = floor_div(seconds, 86400);
+  int secs = static_cast<int>(seconds - days * 86400);
+  std::tm time = std::tm();
+  time.tm_hour = secs / 3600;
+  time.tm_min = secs / 60 % 60;
+  time.tm_sec = secs % 60;
+  // 1970-01-01 was a Thursday.
+  time.tm_wday = static_cast<int>((days % 7 + 11) % 7);
+  LongLong z = days + 719468;
+  LongLong era = floor_div(z, 146097);
+  int day_of_era = static_cast<int>(z - era * 146097);
+  int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+                     day_of_era / 146096) / 365;
+  int day_of_year = day_of_era -
+      (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  int month = (5 * day_of_year + 2) / 153;  // 0 is March
+  time.tm_mday = day_of_year - (153 * month + 2) / 5 + 1;
+  time.tm_mon = month < 10 ? month + 2 : month - 10;
+  LongLong year = year_of_era + era * 400 + (month >= 10 ? 1 : 0);
+  time.tm_year = static_cast<int>(year - 1900);
+  bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+  // Days from January 1 to March 1.
+  int jan_to_mar = 59 + (leap ? 1 : 0);
+  time.tm_yday = month < 10 ? day_of_year + jan_to_mar
+                            : day_of_year - (365 - 59);
+  return time;
+}
+
+template <typename Char>
+fmt::BasicTimeFormat<Char>::BasicTimeFormat(BasicStringRef<Char> format)
+: format_(format.data(), format.size()), minute_(0), subsec_digits_(0) {
+  // Formatting the epoch both checks the format and fills the cache.
+  internal::format_time(cache_, BasicStringRef<Char>(format_),
+                        internal::utc_time(0), 0, 0, &seconds_offsets_);
+}
+
+template <typename Char>
+void fmt::BasicTimeFormat<Char>::format(
+    BasicWriter<Char> &w, LongLong seconds, ULongLong subsec,
+    int subsec_digits) {
+  LongLong minute = floor_div(seconds, 60);
+  if (minute != minute_ || subsec_digits != subsec_digits_) {
+    cache_.clear();
+    seconds_offsets_.clear();
+    internal::format_time(cache_, BasicStringRef<Char>(format_),
+                          internal::utc_time(seconds), subsec,
+                          subsec_digits, &seconds_offsets_);
+    minute_ = minute;
+    subsec_digits_ = subsec_digits;
+  } else {
+    std::tm time = std::tm();
+    TimeWriter<Char> tw(cache_, time, 0, 0, 0);
+    unsigned sec = static_cast<unsigned>(seconds - minute * 60);
+    for (std::vector<std::size_t>::const_iterator
+         it = seconds_offsets_.begin(), end = seconds_offsets_.end();
+         it != end; ++it) {
+      cache_[*it] = internal::Data::DIGITS[sec * 2];
+      cache_[*it + 1] = internal::Data::DIGITS[sec * 2 + 1];
+      if (subsec_digits != 0)
+        tw.write_subsec(*it + 3, subsec, subsec_digits);
+    }
+  }
+  w.buffer().append(&cache_[0], &cache_[0] + cache_.size());
+}
+
+#if FMT_USE_PARALLEL_FORMAT
+FMT_FUNC unsigned fmt::internal::default_num_threads() {
+  unsigned num_threads = std::thread::hardware_concurrency();
+  return num_threads != 0 ? num_threads : 1;
+}
+
+namespace {
+// A single run of a ParallelFormatter. Worker threads take chunks in order
+// from a shared counter and format them into a ring of buffers while the
+// calling thread writes the formatted chunks in order, freeing the buffers.
+// A worker waits if the buffer for its chunk still holds an unwritten chunk
+// which bounds the memory used by the run.
+template <typename Char>
+class ParallelRun {
+ private:
+  struct Chunk {
+    fmt::BasicMemoryWriter<Char> writer;
+
+    // The index of the chunk held by the buffer + 1 if it has been
+    // formatted and 0 otherwise.
+    std::size_t ready;
+
+    Chunk() : ready(0) {}
+  };
+
+  fmt::internal::ParallelFormatter<Char> &formatter_;
+  std::size_t num_chunks_;
+  std::size_t num_buffers_;
+  std::unique_ptr<Chunk[]> chunks_;
+  std::atomic<std::size_t> next_chunk_;
+
+  // The number of chunks written, guarded by mutex_.
+  std::size_t num_written_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable free_;
+  std::vector<std::thread> threads_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(ParallelRun);
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    ready_.notify_all();
+    free_.notify_all();
+  }
+
+  void join() {
+    for (std::size_t i = 0, n = threads_.size(); i < n; ++i) {
+      if (threads_[i].joinable())
+        threads_[i].join();
+    }
+  }
+
+  void work() {
+    for (;;) {
+      std::size_t index = next_chunk_.fetch_add(1, std::memory_order_relaxed);
+      if (index >= num_chunks_)
+        return;
+      Chunk &chunk = chunks_[index % num_buffers_];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && index >= num_written_ + num_buffers_)
+          free_.wait(lock);
+        if (stop_)
+          return;
+      }
+      chunk.writer.clear();
+      FMT_TRY {
+        formatter_.format_chunk(index, chunk.writer);
+      } FMT_CATCH(...) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!error_)
+            error_ = std::current_exception();
+        }
+        stop();
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunk.ready = index + 1;
+      }
+      ready_.notify_one();
+    }
+  }
+
+ public:
+  ParallelRun(fmt::internal::ParallelFormatter<Char> &formatter,
+              std::size_t num_chunks, unsigned num_threads)
+  : formatter_(formatter), num_chunks_(num_chunks),
+    num_buffers_(num_threads * 4u), chunks_(new Chunk[num_buffers_]),
+    next_chunk_(0), num_written_(0), stop_(false) {
+    threads_.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i)
+      threads_.push_back(std::thread(&ParallelRun::work, this));
+  }
+
+  // Stops and joins the worker threads if writing a chunk has thrown.
+  ~ParallelRun() {
+    stop();
+    join();
+  }
+
+  void run() {
+    for (std::size_t index = 0; index < num_chunks_; ++index) {
+      Chunk &chunk = chunks_[index % num_buffers_];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && chunk.ready != index + 1)
+          ready_.wait(lock);
+        if (stop_)
+          break;
+      }
+      const fmt::BasicMemoryWriter<Char> &w = chunk.writer;
+      formatter_.write(fmt::BasicStringRef<Char>(w.data(), w.size()));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++num_written_;
+      }
+      free_.notify_all();
+    }
+    join();
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+};
+}  // namespace
+
+template <typename Char>
+void fmt::internal::ParallelFormatter<Char>::run(
+    std::size_t num_chunks, unsigned num_threads) {
+  if (num_threads > num_chunks)
+    num_threads = static_cast<unsigned>(num_chunks);
+  if (num_threads <= 1) {
+    BasicMemoryWriter<Char> w;
+    for (std::size_t i = 0; i < num_chunks; ++i) {
+      w.clear();
+      format_chunk(i, w);
+      write(BasicStringRef<Char>(w.data(), w.size()));
+    }
+    return;
+  }
+  ParallelRun<Char>(*this, num_chunks, num_threads).run();
+}
+#endif  // FMT_USE_PARALLEL_FORMAT
+
+#if !defined(FMT_HEADER_ONLY) || defined(FMT_INSTANTIATE_TEMPLATES)
 
 template struct fmt::internal::BasicData<void>;
 
@@ -1268,13 +4150,69 @@ template struct fmt::internal::BasicData<void>;
 
 template void fmt::internal::FixedBuffer<char>::grow(std::size_t);
 
+template void fmt::internal::format_time(
+    Buffer<char> &buffer, StringRef format, const std::tm &time,
+    ULongLong subsec, int subsec_digits,
+    std::vector<std::size_t> *seconds_offsets);
+
+template fmt::StringRef fmt::internal::parse_time_format(
+    const char *&format_str);
+
+template fmt::BasicTimeFormat<char>::BasicTimeFormat(StringRef format);
+
+template void fmt::BasicTimeFormat<char>::format(
+    BasicWriter<char> &w, LongLong seconds, ULongLong subsec,
+    int subsec_digits);
+
+template void fmt::internal::align_output(
+    Buffer<char> &buffer, std::size_t start, const FormatSpec &spec);
+
 template const char *fmt::BasicFormatter<char>::format(
     const char *&format_str, const fmt::internal::Arg &arg);
 
-template void fmt::BasicFormatter<char>::format(CStringRef format);
+template const char *fmt::BasicFormatter<char>::parse_spec(
+    const char *s, const fmt::internal::Arg &arg, FormatSpec &spec);
+
+template void fmt::BasicWriter<char>::write_arg(
+    const fmt::internal::Arg &arg, FormatSpec spec);
+
+template void fmt::BasicWriter<char>::write_double(
+    float value, const FormatSpec &spec);
+
+template void fmt::BasicWriter<char>::write_double(
+    double value, const FormatSpec &spec);
+
+template void fmt::BasicWriter<char>::write_double(
+    long double value, const FormatSpec &spec);
+
+template void fmt::BasicFormatter<char>::format(StringRef format);
+
+template bool fmt::BasicFormatter<char>::format(
+    StringRef format, internal::FormatErrorInfo &error);
+
+template std::size_t fmt::BasicFormatter<char>::count(StringRef format);
 
 template void fmt::internal::PrintfFormatter<char>::format(
-  BasicWriter<char> &writer, CStringRef format);
+  BasicWriter<char> &writer, StringRef format);
+
+template void fmt::BasicCompiledFormat<char>::compile();
+
+template void fmt::BasicCompiledFormat<char>::format(
+    BasicWriter<char> &w, ArgList args) const;
+
+template void fmt::BasicCompiledPrintfFormat<char>::compile();
+
+template void fmt::BasicCompiledPrintfFormat<char>::format(
+    BasicWriter<char> &w, ArgList args) const;
+
+template void fmt::internal::format_static<char>(
+    BasicWriter<char> &w, const char *format,
+    const StaticFormatItem *items, std::size_t num_items, ArgList args);
+
+template void fmt::BasicFormatRecord<char>::destroy_custom_args();
+
+template void fmt::BasicFormatRecord<char>::capture(
+    StringRef format_str, ArgList args);
 
 template int fmt::internal::CharTraits<char>::format_float(
     char *buffer, std::size_t size, const char *format,
@@ -1284,18 +4222,80 @@ template int fmt::internal::CharTraits<char>::format_float(
     char *buffer, std::size_t size, const char *format,
     unsigned width, int precision, long double value);
 
+#if FMT_USE_PARALLEL_FORMAT
+template void fmt::internal::ParallelFormatter<char>::run(
+    std::size_t num_chunks, unsigned num_threads);
+#endif
+
 // Explicit instantiations for wchar_t.
 
 template void fmt::internal::FixedBuffer<wchar_t>::grow(std::size_t);
 
+template void fmt::internal::format_time(
+    Buffer<wchar_t> &buffer, WStringRef format, const std::tm &time,
+    ULongLong subsec, int subsec_digits,
+    std::vector<std::size_t> *seconds_offsets);
+
+template fmt::WStringRef fmt::internal::parse_time_format(
+    const wchar_t *&format_str);
+
+template fmt::BasicTimeFormat<wchar_t>::BasicTimeFormat(WStringRef format);
+
+template void fmt::BasicTimeFormat<wchar_t>::format(
+    BasicWriter<wchar_t> &w, LongLong seconds, ULongLong subsec,
+    int subsec_digits);
+
+template void fmt::internal::align_output(
+    Buffer<wchar_t> &buffer, std::size_t start, const FormatSpec &spec);
+
 template const wchar_t *fmt::BasicFormatter<wchar_t>::format(
     const wchar_t *&format_str, const fmt::internal::Arg &arg);
 
+template const wchar_t *fmt::BasicFormatter<wchar_t>::parse_spec(
+    const wchar_t *s, const fmt::internal::Arg &arg, FormatSpec &spec);
+
+template void fmt::BasicWriter<wchar_t>::write_arg(
+    const fmt::internal::Arg &arg, FormatSpec spec);
+
+template void fmt::BasicWriter<wchar_t>::write_double(
+    float value, const FormatSpec &spec);
+
+template void fmt::BasicWriter<wchar_t>::write_double(
+    double value, const FormatSpec &spec);
+
+template void fmt::BasicWriter<wchar_t>::write_double(
+    long double value, const FormatSpec &spec);
+
 template void fmt::BasicFormatter<wchar_t>::format(
-    BasicCStringRef<wchar_t> format);
+    BasicStringRef<wchar_t> format);
+
+template bool fmt::BasicFormatter<wchar_t>::format(
+    BasicStringRef<wchar_t> format, internal::FormatErrorInfo &error);
+
+template std::size_t fmt::BasicFormatter<wchar_t>::count(
+    BasicStringRef<wchar_t> format);
 
 template void fmt::internal::PrintfFormatter<wchar_t>::format(
-    BasicWriter<wchar_t> &writer, WCStringRef format);
+    BasicWriter<wchar_t> &writer, WStringRef format);
+
+template void fmt::BasicCompiledFormat<wchar_t>::compile();
+
+template void fmt::BasicCompiledFormat<wchar_t>::format(
+    BasicWriter<wchar_t> &w, ArgList args) const;
+
+template void fmt::BasicCompiledPrintfFormat<wchar_t>::compile();
+
+template void fmt::BasicCompiledPrintfFormat<wchar_t>::format(
+    BasicWriter<wchar_t> &w, ArgList args) const;
+
+template void fmt::internal::format_static<wchar_t>(
+    BasicWriter<wchar_t> &w, const wchar_t *format,
+    const StaticFormatItem *items, std::size_t num_items, ArgList args);
+
+template void fmt::BasicFormatRecord<wchar_t>::destroy_custom_args();
+
+template void fmt::BasicFormatRecord<wchar_t>::capture(
+    WStringRef format_str, ArgList args);
 
 template int fmt::internal::CharTraits<wchar_t>::format_float(
     wchar_t *buffer, std::size_t size, const wchar_t *format,
@@ -1305,7 +4305,12 @@ template int fmt::internal::CharTraits<wchar_t>::format_float(
     wchar_t *buffer, std::size_t size, const wchar_t *format,
     unsigned width, int precision, long double value);
 
-#endif  // FMT_HEADER_ONLY
+#if FMT_USE_PARALLEL_FORMAT
+template void fmt::internal::ParallelFormatter<wchar_t>::run(
+    std::size_t num_chunks, unsigned num_threads);
+#endif
+
+#endif  // !FMT_HEADER_ONLY || FMT_INSTANTIATE_TEMPLATES
 
 #if _MSC_VER
 # pragma warning(pop)
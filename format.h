@@ -34,12 +34,17 @@
 #include <cmath>
 #include <cstddef>  // for std::ptrdiff_t
 #include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
 #include <algorithm>
+#include <iterator>
 #include <limits>
 #include <stdexcept>
 #include <string>
-#include <sstream>
-#include <map>
+#include <ostream>
+#include <streambuf>
+#include <vector>
 
 #if _SECURE_SCL
 # include <iterator>
@@ -152,6 +157,83 @@ inline uint32_t clzll(uint64_t x) {
 # include <utility>  // for std::move
 #endif
 
+#ifndef FMT_USE_CONSTEXPR
+// Compile-time checking of format strings requires relaxed constexpr
+// (C++14) available in GCC since version 5 and in Visual C++ since
+// version 2017.
+# if defined(__cpp_constexpr) && __cpp_constexpr >= 201304
+#  define FMT_USE_CONSTEXPR 1
+# else
+#  define FMT_USE_CONSTEXPR \
+    (FMT_HAS_FEATURE(cxx_relaxed_constexpr) || _MSC_VER >= 1910)
+# endif
+#endif
+
+#if FMT_USE_CONSTEXPR
+# define FMT_CONSTEXPR constexpr
+# include <type_traits>  // for std::is_base_of
+# include <utility>  // for std::declval
+#else
+# define FMT_CONSTEXPR
+#endif
+
+#ifndef FMT_USE_IS_COPY_CONSTRUCTIBLE
+# define FMT_USE_IS_COPY_CONSTRUCTIBLE \
+   ((__cplusplus >= 201103L && \
+       (!FMT_GCC_VERSION || FMT_GCC_VERSION >= 407)) || _MSC_VER >= 1800)
+#endif
+
+#if FMT_USE_IS_COPY_CONSTRUCTIBLE
+# include <type_traits>  // for std::is_copy_constructible
+#endif
+
+// Define FMT_USE_CHRONO to 0 to disable formatting of
+// std::chrono::system_clock time points.
+#ifndef FMT_USE_CHRONO
+# define FMT_USE_CHRONO (__cplusplus >= 201103L || \
+    (FMT_GCC_VERSION >= 408 && FMT_HAS_GXX_CXX11) || _MSC_VER >= 1700)
+#endif
+
+#if FMT_USE_CHRONO
+# include <chrono>
+#endif
+
+// Define FMT_USE_STATS to 1 to collect per-thread counters of buffer
+// growth, snprintf fallbacks and other slow paths (see fmt::Stats).
+// Requires thread_local. The counters have no cost when it is 0.
+#ifndef FMT_USE_STATS
+# define FMT_USE_STATS 0
+#endif
+
+// Define FMT_USE_FORMAT_TIMING to 1 to also record histograms of
+// formatting time per format string (see fmt::FormatTiming).
+#ifndef FMT_USE_FORMAT_TIMING
+# define FMT_USE_FORMAT_TIMING 0
+#endif
+
+#if FMT_USE_FORMAT_TIMING && !FMT_USE_STATS
+# error "FMT_USE_FORMAT_TIMING requires FMT_USE_STATS"
+#endif
+
+// Define FMT_USE_PARALLEL_FORMAT to 0 to disable parallel_format which
+// requires C++11 threads.
+#ifndef FMT_USE_PARALLEL_FORMAT
+# define FMT_USE_PARALLEL_FORMAT (FMT_USE_VARIADIC_TEMPLATES && \
+   (__cplusplus >= 201103L || \
+       (FMT_GCC_VERSION >= 408 && FMT_HAS_GXX_CXX11) || _MSC_VER >= 1900))
+#endif
+
+// Define FMT_EXTERN_TEMPLATES to 1 to declare the char and wchar_t
+// instantiations of the formatting cores (BasicFormatter, PrintfFormatter,
+// BasicWriter::write_arg and write_double, CharTraits::format_float) extern,
+// so that they are compiled once instead of in every translation unit.
+// Requires extern templates (C++11). With FMT_HEADER_ONLY exactly one
+// translation unit must define FMT_INSTANTIATE_TEMPLATES before including
+// format.h to provide the instantiations.
+#ifndef FMT_EXTERN_TEMPLATES
+# define FMT_EXTERN_TEMPLATES 0
+#endif
+
 // Define FMT_USE_NOEXCEPT to make C++ Format use noexcept (C++11 feature).
 #ifndef FMT_NOEXCEPT
 # if FMT_USE_NOEXCEPT || FMT_HAS_FEATURE(cxx_noexcept) || \
@@ -192,6 +274,25 @@ FMT_GCC_EXTENSION typedef unsigned long long ULongLong;
 using std::move;
 #endif
 
+#if FMT_USE_STATS
+namespace internal {
+// Formatting statistics counters in the order of the fields of fmt::Stats.
+enum StatsCounter {
+  BUFFER_GROWS, INLINE_BUFFER_SPILLS, BYTES_ALLOCATED, DOUBLE_SNPRINTF_CALLS,
+  DOUBLE_SNPRINTF_RETRIES, OSTREAM_FALLBACKS, ARG_MAP_BUILDS,
+  NUM_STATS_COUNTERS
+};
+
+// Adds value to a counter of the calling thread.
+void add_stat(StatsCounter counter, ULongLong value);
+}  // namespace internal
+
+# define FMT_ADD_STAT(counter, value) \
+  fmt::internal::add_stat(fmt::internal::counter, value)
+#else
+# define FMT_ADD_STAT(counter, value) (void)0
+#endif
+
 template <typename Char>
 class BasicWriter;
 
@@ -201,6 +302,12 @@ typedef BasicWriter<wchar_t> WWriter;
 template <typename Char>
 class BasicFormatter;
 
+template <typename Char>
+class BasicCompiledFormat;
+
+template <typename Char>
+class BasicCompiledPrintfFormat;
+
 template <typename Char, typename T>
 void format(BasicFormatter<Char> &f, const Char *&format_str, const T &value);
 
@@ -302,13 +409,13 @@ typedef BasicStringRef<wchar_t> WStringRef;
   +-------------+--------------------------+
 
   This class is most useful as a parameter type to allow passing
-  different types of strings to a function, for example::
+  different types of strings to a function that requires a terminating
+  null character, for example::
 
-    template <typename... Args>
-    std::string format(CStringRef format_str, const Args & ... args);
+    File open(CStringRef path);
 
-    format("{}", 42);
-    format(std::string("{}"), 42);
+    open("file.txt");
+    open(std::string("file.txt"));
   \endrst
  */
 template <typename Char>
@@ -329,6 +436,9 @@ class BasicCStringRef {
 
   /** Returns the pointer to a C string. */
   const Char *c_str() const { return data_; }
+
+  /** Converts the reference to a string reference computing the size. */
+  operator BasicStringRef<Char>() const { return BasicStringRef<Char>(data_); }
 };
 
 typedef BasicCStringRef<char> CStringRef;
@@ -343,6 +453,23 @@ class FormatError : public std::runtime_error {
   : std::runtime_error(message.c_str()) {}
 };
 
+/**
+  \rst
+  The result of a formatting function that reports errors without throwing
+  exceptions such as :func:`fmt::try_format`.
+  \endrst
+ */
+struct FormatResult {
+  /** The error message or a null pointer if formatting succeeded. */
+  const char *error;
+
+  /**
+    The size of the output. If an error occurred, the output contains the
+    text preceding the invalid replacement field.
+   */
+  std::size_t size;
+};
+
 namespace internal {
 // The number of characters to store in the MemoryBuffer object itself
 // to avoid dynamic memory allocation.
@@ -358,6 +485,15 @@ inline stdext::checked_array_iterator<T*> make_ptr(T *ptr, std::size_t size) {
 template <typename T>
 inline T *make_ptr(T *ptr, std::size_t) { return ptr; }
 #endif
+
+// Fills n characters starting at out with a single block fill.
+inline void fill_chars(char *out, std::size_t n, char fill) {
+  std::memset(out, static_cast<unsigned char>(fill), n);
+}
+
+inline void fill_chars(wchar_t *out, std::size_t n, wchar_t fill) {
+  std::wmemset(out, fill, n);
+}
 }  // namespace internal
 
 /**
@@ -440,12 +576,99 @@ void Buffer<T>::append(const U *begin, const U *end) {
   size_ += num_elements;
 }
 
+/**
+  \rst
+  The default policy of :class:`fmt::BasicMemoryWriter` that grows the
+  capacity geometrically by a factor of 1.5. It has no state, so it doesn't
+  add to the size of the writer.
+  \endrst
+ */
+class DefaultGrowthPolicy {
+ public:
+  /**
+    Returns the capacity of a buffer that has *capacity* elements and needs
+    to hold at least *size* elements.
+   */
+  static std::size_t next_capacity(std::size_t capacity, std::size_t size) {
+    return (std::max)(size, capacity + capacity / 2);
+  }
+};
+
+/**
+  \rst
+  A policy that determines the capacity a :class:`fmt::BasicMemoryWriter`
+  grows to when it runs out of space and can be changed at runtime. It is
+  used by passing it as the *Policy* template argument of the writer.
+  A default-constructed policy grows the capacity geometrically by a factor
+  of 1.5.
+
+  **Example**::
+
+    fmt::BasicMemoryWriter<char, std::allocator<char>,
+                           fmt::internal::INLINE_BUFFER_SIZE,
+                           fmt::GrowthPolicy> out;
+    // Grow in 1 MB steps instead of reallocating geometrically.
+    out.set_growth_policy(fmt::GrowthPolicy::chunked(1 << 20));
+  \endrst
+ */
+class GrowthPolicy {
+ private:
+  unsigned numerator_;
+  unsigned denominator_;
+  std::size_t chunk_size_;
+
+  GrowthPolicy(unsigned numerator, unsigned denominator,
+               std::size_t chunk_size)
+  : numerator_(numerator), denominator_(denominator),
+    chunk_size_(chunk_size) {}
+
+ public:
+  /** Constructs the default policy. */
+  GrowthPolicy() : numerator_(3), denominator_(2), chunk_size_(0) {}
+
+  /**
+    \rst
+    Returns a policy that grows the capacity by a factor of
+    *numerator* / *denominator*. If the factor is not greater than 1, the
+    buffer grows to exactly the requested size.
+    \endrst
+   */
+  static GrowthPolicy geometric(unsigned numerator, unsigned denominator) {
+    return GrowthPolicy(numerator, denominator != 0 ? denominator : 1, 0);
+  }
+
+  /**
+    \rst
+    Returns a policy that rounds the requested size up to a multiple of
+    *chunk_size* elements, so the capacity grows linearly.
+    \endrst
+   */
+  static GrowthPolicy chunked(std::size_t chunk_size) {
+    return GrowthPolicy(1, 1, chunk_size);
+  }
+
+  /**
+    Returns the capacity of a buffer that has *capacity* elements and needs
+    to hold at least *size* elements.
+   */
+  std::size_t next_capacity(std::size_t capacity, std::size_t size) const {
+    if (chunk_size_ != 0)
+      return (size + chunk_size_ - 1) / chunk_size_ * chunk_size_;
+    std::size_t new_capacity = capacity;
+    if (numerator_ > denominator_)
+      new_capacity += capacity / denominator_ * (numerator_ - denominator_);
+    return (std::max)(size, new_capacity);
+  }
+};
+
 namespace internal {
 
 // A memory buffer for POD types with the first SIZE elements stored in
-// the object itself.
-template <typename T, std::size_t SIZE, typename Allocator = std::allocator<T> >
-class MemoryBuffer : private Allocator, public Buffer<T> {
+// the object itself. Like the allocator, the growth policy is a base class
+// so that the stateless default policy takes no space.
+template <typename T, std::size_t SIZE, typename Allocator = std::allocator<T>,
+          typename Policy = DefaultGrowthPolicy>
+class MemoryBuffer : private Allocator, private Policy, public Buffer<T> {
  private:
   T data_[SIZE];
 
@@ -462,12 +685,31 @@ class MemoryBuffer : private Allocator, public Buffer<T> {
       : Allocator(alloc), Buffer<T>(data_, SIZE) {}
   ~MemoryBuffer() { free(); }
 
+  const Policy &growth_policy() const { return *this; }
+  void set_growth_policy(const Policy &policy) {
+    Policy &this_policy = *this;
+    this_policy = policy;
+  }
+
+  // Reduces the capacity to the size, moving the data back to the inline
+  // storage if it fits there.
+  void shrink_to_fit();
+
+  // Clears the buffer and frees dynamically allocated memory.
+  void release() {
+    free();
+    this->ptr_ = data_;
+    this->size_ = 0;
+    this->capacity_ = SIZE;
+  }
+
 #if FMT_USE_RVALUE_REFERENCES
  private:
   // Move data from other to this buffer.
   void move(MemoryBuffer &other) {
     Allocator &this_alloc = *this, &other_alloc = other;
     this_alloc = std::move(other_alloc);
+    set_growth_policy(other.growth_policy());
     this->size_ = other.size_;
     this->capacity_ = other.capacity_;
     if (other.ptr_ == other.data_) {
@@ -499,10 +741,10 @@ class MemoryBuffer : private Allocator, public Buffer<T> {
   Allocator get_allocator() const { return *this; }
 };
 
-template <typename T, std::size_t SIZE, typename Allocator>
-void MemoryBuffer<T, SIZE, Allocator>::grow(std::size_t size) {
+template <typename T, std::size_t SIZE, typename Allocator, typename Policy>
+void MemoryBuffer<T, SIZE, Allocator, Policy>::grow(std::size_t size) {
   std::size_t new_capacity =
-      (std::max)(size, this->capacity_ + this->capacity_ / 2);
+      growth_policy().next_capacity(this->capacity_, size);
   T *new_ptr = this->allocate(new_capacity);
   // The following code doesn't throw, so the raw pointer above doesn't leak.
   std::copy(this->ptr_,
@@ -511,6 +753,10 @@ void MemoryBuffer<T, SIZE, Allocator>::grow(std::size_t size) {
   T *old_ptr = this->ptr_;
   this->capacity_ = new_capacity;
   this->ptr_ = new_ptr;
+  FMT_ADD_STAT(BUFFER_GROWS, 1);
+  FMT_ADD_STAT(BYTES_ALLOCATED, new_capacity * sizeof(T));
+  if (old_ptr == data_)
+    FMT_ADD_STAT(INLINE_BUFFER_SPILLS, 1);
   // deallocate may throw (at least in principle), but it doesn't matter since
   // the buffer already uses the new storage and will deallocate it in case
   // of exception.
@@ -518,6 +764,26 @@ void MemoryBuffer<T, SIZE, Allocator>::grow(std::size_t size) {
     this->deallocate(old_ptr, old_capacity);
 }
 
+template <typename T, std::size_t SIZE, typename Allocator, typename Policy>
+void MemoryBuffer<T, SIZE, Allocator, Policy>::shrink_to_fit() {
+  if (this->ptr_ == data_ || this->size_ == this->capacity_)
+    return;
+  T *new_ptr = data_;
+  std::size_t new_capacity = SIZE;
+  if (this->size_ > SIZE) {
+    new_capacity = this->size_;
+    new_ptr = this->allocate(new_capacity);
+    FMT_ADD_STAT(BYTES_ALLOCATED, new_capacity * sizeof(T));
+  }
+  std::copy(this->ptr_,
+            this->ptr_ + this->size_, make_ptr(new_ptr, new_capacity));
+  T *old_ptr = this->ptr_;
+  std::size_t old_capacity = this->capacity_;
+  this->ptr_ = new_ptr;
+  this->capacity_ = new_capacity;
+  this->deallocate(old_ptr, old_capacity);
+}
+
 // A fixed-size buffer.
 template <typename Char>
 class FixedBuffer : public fmt::Buffer<Char> {
@@ -528,6 +794,211 @@ class FixedBuffer : public fmt::Buffer<Char> {
   void grow(std::size_t size);
 };
 
+// A buffer that appends to a contiguous container such as std::basic_string
+// or std::vector. The unused capacity of the container is used before
+// reallocating and the container is resized to the size of the output when
+// the buffer is destroyed.
+template <typename Container>
+class ContainerBuffer : public fmt::Buffer<typename Container::value_type> {
+ private:
+  Container &container_;
+  // The size of the container before appending.
+  std::size_t offset_;
+
+ protected:
+  void grow(std::size_t size) {
+    std::size_t available = container_.capacity() - offset_;
+    std::size_t new_capacity = size <= available ? available :
+        (std::max)(size, this->capacity_ + this->capacity_ / 2);
+    container_.resize(offset_ + new_capacity);
+    this->ptr_ = &container_[offset_];
+    this->capacity_ = new_capacity;
+  }
+
+ public:
+  explicit ContainerBuffer(Container &c) : container_(c), offset_(c.size()) {}
+  ~ContainerBuffer() { container_.resize(offset_ + this->size_); }
+};
+
+// A buffer for formatting a string that is returned to the caller. The
+// output is written to the inline storage of a MemoryBuffer and the string
+// is constructed from it once, so short outputs don't allocate until the
+// result is created.
+template <typename Char>
+class StringBuffer : public MemoryBuffer<Char, INLINE_BUFFER_SIZE> {
+ public:
+  // Returns the output as a string and leaves the buffer empty.
+  std::basic_string<Char> str() {
+    std::basic_string<Char> result(&(*this)[0], this->size());
+    this->clear();
+    return result;
+  }
+};
+
+// A buffer that stores the output in a list of chunks. Only the data written
+// since the last commit is exposed through the Buffer interface; commit turns
+// it into a segment and moves the window past it in the same chunk. When the
+// window doesn't fit into the current chunk, only the uncommitted data is
+// copied to a new chunk, so the data written before is never moved.
+// Chunks of chunk_size elements are kept in a pool for reuse after reset.
+template <typename Char>
+class SegmentedBuffer : public fmt::Buffer<Char> {
+ private:
+  struct Chunk {
+    Char *data;
+    std::size_t capacity;
+  };
+
+  std::size_t chunk_size_;
+  std::vector<Chunk> chunks_;  // Chunks in use, the last one is current.
+  std::vector<Chunk> pool_;    // Free chunks of chunk_size_ elements.
+  std::vector< BasicStringRef<Char> > segments_;
+  std::size_t committed_size_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SegmentedBuffer);
+
+  // Returns a chunk to the pool or frees it if it has a nonstandard size.
+  // The caller must reserve space in pool_.
+  void free(const Chunk &chunk) {
+    if (chunk.capacity == chunk_size_)
+      pool_.push_back(chunk);
+    else
+      delete [] chunk.data;
+  }
+
+ protected:
+  void grow(std::size_t size);
+
+ public:
+  explicit SegmentedBuffer(std::size_t chunk_size)
+  : chunk_size_(chunk_size != 0 ? chunk_size : 1), committed_size_(0) {}
+  ~SegmentedBuffer();
+
+  // Returns the total size of the output.
+  std::size_t total_size() const { return committed_size_ + this->size_; }
+
+  // Turns the data written since the last commit into a segment.
+  void commit();
+
+  // Returns the output as a list of segments.
+  const std::vector< BasicStringRef<Char> > &segments() {
+    commit();
+    return segments_;
+  }
+
+  // Clears the output returning the chunks to the pool.
+  void reset();
+};
+
+template <typename Char>
+SegmentedBuffer<Char>::~SegmentedBuffer() {
+  for (std::size_t i = 0, n = chunks_.size(); i < n; ++i)
+    delete [] chunks_[i].data;
+  for (std::size_t i = 0, n = pool_.size(); i < n; ++i)
+    delete [] pool_[i].data;
+}
+
+template <typename Char>
+void SegmentedBuffer<Char>::grow(std::size_t size) {
+  // Reserve space first so that nothing throws after the allocation.
+  chunks_.reserve(chunks_.size() + 1);
+  pool_.reserve(pool_.size() + 1);
+  Chunk chunk;
+  if (size <= chunk_size_ && !pool_.empty()) {
+    chunk = pool_.back();
+    pool_.pop_back();
+  } else {
+    // Output written through a BasicWriter reference is not committed, so
+    // grow oversized windows geometrically to keep copying linear.
+    chunk.capacity = (std::max)(
+          (std::max)(size, chunk_size_), this->capacity_ + this->capacity_ / 2);
+    chunk.data = new Char[chunk.capacity];
+    FMT_ADD_STAT(BYTES_ALLOCATED, chunk.capacity * sizeof(Char));
+  }
+  FMT_ADD_STAT(BUFFER_GROWS, 1);
+  std::copy(this->ptr_, this->ptr_ + this->size_,
+            make_ptr(chunk.data, chunk.capacity));
+  // The current chunk has no committed data if the window starts at its
+  // beginning, so it can be released.
+  if (!chunks_.empty() && this->ptr_ == chunks_.back().data) {
+    free(chunks_.back());
+    chunks_.pop_back();
+  }
+  chunks_.push_back(chunk);
+  this->ptr_ = chunk.data;
+  this->capacity_ = chunk.capacity;
+}
+
+template <typename Char>
+void SegmentedBuffer<Char>::commit() {
+  std::size_t size = this->size_;
+  if (size == 0)
+    return;
+  Char *data = this->ptr_;
+  if (!segments_.empty()) {
+    BasicStringRef<Char> &last = segments_.back();
+    if (last.data() + last.size() == data) {
+      last = BasicStringRef<Char>(last.data(), last.size() + size);
+      data = 0;
+    }
+  }
+  if (data)
+    segments_.push_back(BasicStringRef<Char>(data, size));
+  committed_size_ += size;
+  this->ptr_ += size;
+  this->capacity_ -= size;
+  this->size_ = 0;
+}
+
+template <typename Char>
+void SegmentedBuffer<Char>::reset() {
+  pool_.reserve(pool_.size() + chunks_.size());
+  for (std::size_t i = 0, n = chunks_.size(); i < n; ++i)
+    free(chunks_[i]);
+  chunks_.clear();
+  segments_.clear();
+  committed_size_ = 0;
+  this->ptr_ = 0;
+  this->size_ = 0;
+  this->capacity_ = 0;
+}
+
+// A buffer that writes to an array and truncates the output to the array
+// size. The output that doesn't fit is temporarily stored in an internal
+// buffer, so the total output size is available via size().
+template <typename Char>
+class TruncatingBuffer : public fmt::Buffer<Char> {
+ private:
+  Char *array_;
+  std::size_t array_size_;
+  MemoryBuffer<Char, INLINE_BUFFER_SIZE> overflow_;
+
+ protected:
+  void grow(std::size_t size) {
+    overflow_.resize(size);
+    if (this->ptr_ == array_) {
+      std::copy(array_, array_ + this->size_,
+                make_ptr(&overflow_[0], overflow_.size()));
+    }
+    // Use all the storage of the overflow buffer.
+    overflow_.resize(overflow_.capacity());
+    this->ptr_ = &overflow_[0];
+    this->capacity_ = overflow_.size();
+  }
+
+ public:
+  TruncatingBuffer(Char *array, std::size_t size)
+  : fmt::Buffer<Char>(array, size), array_(array), array_size_(size) {}
+
+  // Copies the part of the output that fits into the array.
+  void flush() {
+    if (this->ptr_ != array_) {
+      std::size_t n = (std::min)(this->size_, array_size_);
+      std::copy(this->ptr_, this->ptr_ + n, make_ptr(array_, array_size_));
+    }
+  }
+};
+
 #ifndef _MSC_VER
 // Portable version of signbit.
 inline int getsign(double x) {
@@ -662,6 +1133,10 @@ struct BasicData {
   static const uint32_t POWERS_OF_10_32[];
   static const uint64_t POWERS_OF_10_64[];
   static const char DIGITS[];
+  // Normalized 64-bit significands and binary exponents of powers of 10
+  // 10^-348, 10^-340, ..., 10^340 used by the floating-point formatter.
+  static const uint64_t POW10_SIGNIFICANDS[];
+  static const int16_t POW10_EXPONENTS[];
 };
 
 typedef BasicData<> Data;
@@ -709,9 +1184,68 @@ inline unsigned count_digits(uint32_t n) {
 }
 #endif
 
+// Returns the number of significant bits in n or 1 if n is 0.
+inline unsigned count_bits(uint32_t n) {
+#ifdef FMT_BUILTIN_CLZ
+  return 32 - FMT_BUILTIN_CLZ(n | 1);
+#else
+  unsigned count = 1;
+  while ((n >>= 1) != 0)
+    ++count;
+  return count;
+#endif
+}
+
+inline unsigned count_bits(uint64_t n) {
+#ifdef FMT_BUILTIN_CLZLL
+  return 64 - FMT_BUILTIN_CLZLL(n | 1);
+#else
+  unsigned count = 1;
+  while ((n >>= 1) != 0)
+    ++count;
+  return count;
+#endif
+}
+
+// Returns the number of elements in [first, last) if it can be computed
+// without iterating over the range and 0 otherwise.
+template <typename It>
+inline std::size_t range_size(It first, It last,
+                              std::random_access_iterator_tag) {
+  return static_cast<std::size_t>(last - first);
+}
+
+template <typename It>
+inline std::size_t range_size(It, It, std::input_iterator_tag) { return 0; }
+
+// Writes exactly 8 decimal digits of value, which must be less than 10^8,
+// into buffer. Instead of dividing by 100 for each pair of digits, value is
+// converted to a 7.57 fixed-point representation of value / 10^6 with one
+// multiplication, and each next pair is moved into the integer part by
+// multiplying the fraction by 100. The multiplier is rounded up and the
+// error stays below one unit of the last pair for values less than 10^8.
+template <typename Char>
+inline void format_decimal8(Char *buffer, uint32_t value) {
+  const uint64_t ONE = static_cast<uint64_t>(1) << 57;
+  uint64_t t = value * (ONE / 1000000 + 1);
+  for (int i = 0; i < 8; i += 2) {
+    unsigned index = static_cast<unsigned>(t >> 57) * 2;
+    buffer[i] = Data::DIGITS[index];
+    buffer[i + 1] = Data::DIGITS[index + 1];
+    t = (t & (ONE - 1)) * 100;
+  }
+}
+
 // Formats a decimal unsigned integer value writing into buffer.
-template <typename UInt, typename Char>
-inline void format_decimal(Char *buffer, UInt value, unsigned num_digits) {
+template <typename Char>
+inline void format_decimal(Char *buffer, uint32_t value, unsigned num_digits) {
+  if (num_digits >= 8) {
+    num_digits -= 8;
+    format_decimal8(buffer + num_digits, value % 100000000);
+    value /= 100000000;
+    if (num_digits == 0)
+      return;
+  }
   --num_digits;
   while (value >= 100) {
     // Integer division is slow so do it for a group of two digits instead
@@ -732,6 +1266,59 @@ inline void format_decimal(Char *buffer, UInt value, unsigned num_digits) {
   buffer[0] = Data::DIGITS[index];
 }
 
+template <typename UInt, typename Char>
+inline void format_decimal(Char *buffer, UInt value, unsigned num_digits) {
+  // Split off groups of 8 digits until the rest can be formatted with
+  // 32-bit arithmetic which is faster than 64-bit on most platforms.
+  while (static_cast<uint64_t>(value) > 0xffffffffu) {
+    num_digits -= 8;
+    format_decimal8(buffer + num_digits,
+                    static_cast<uint32_t>(value % 100000000));
+    value /= 100000000;
+  }
+  format_decimal(buffer, static_cast<uint32_t>(value), num_digits);
+}
+
+// The maximum number of digits produced by grisu_format.
+enum { MAX_GRISU_DIGITS = 32 };
+
+// Generates decimal digits of a finite positive double value using the Grisu
+// algorithm. If precision is negative, produces the shortest sequence of
+// digits that round-trips, otherwise precision digits rounded correctly,
+// where precision is either the number of significant digits or, if fixed
+// is true, the number of digits after the decimal point. On success writes
+// the digits to buffer, which should have space for at least
+// MAX_GRISU_DIGITS characters, stores the number of digits in size and
+// the decimal exponent of the last digit in exp, so that the value is
+// equal or close to digits * 10^exp, and returns true. Trailing zeros may
+// be omitted. In the precision mode returns false if the result cannot be
+// guaranteed to be correct, in which case the caller should use a slower
+// method such as snprintf.
+bool grisu_format(double value, char *buffer, int &size, int &exp,
+                  int precision = -1, bool fixed = false);
+
+// Same as grisu_format in the shortest mode but produces the shortest
+// sequence of digits that round-trips at float precision.
+void grisu_format_float(float value, char *buffer, int &size, int &exp);
+
+// Appends the UTF-8 string s to out converted to wide characters, which are
+// UTF-16 code units if wchar_t is 16 bits wide and code points otherwise.
+// Returns false and leaves the size of out unchanged if s is not valid UTF-8.
+bool utf8_to_wchar(StringRef s, Buffer<wchar_t> &out);
+
+// Appends the wide string s to out converted to UTF-8. Returns false and
+// leaves the size of out unchanged if s is not a valid UTF-16 or UTF-32
+// string depending on the size of wchar_t.
+bool wchar_to_utf8(WStringRef s, Buffer<char> &out);
+
+// Appends a wide string to out converting it to UTF-8.
+// Throws FormatError if s cannot be converted.
+void append_wide(Buffer<char> &out, WStringRef s);
+
+inline void append_wide(Buffer<wchar_t> &out, WStringRef s) {
+  out.append(s.data(), s.data() + s.size());
+}
+
 #ifndef _WIN32
 # define FMT_USE_WINDOWS_H 0
 #elif !defined(FMT_USE_WINDOWS_H)
@@ -798,12 +1385,19 @@ struct Value {
     FormatFunc format;
   };
 
+  // A floating-point value that remembers if it was passed as float.
+  struct DoubleValue {
+    double value;
+    bool is_float;
+  };
+
   union {
     int int_value;
     unsigned uint_value;
     LongLong long_long_value;
     ULongLong ulong_long_value;
     double double_value;
+    DoubleValue double_info;
     long double long_double_value;
     const void *pointer;
     StringValue<char> string;
@@ -876,6 +1470,11 @@ FMT_CONVERTIBLE_TO_INT(float);
 FMT_CONVERTIBLE_TO_INT(double);
 FMT_CONVERTIBLE_TO_INT(long double);
 
+// The type of an argument as a compile-time constant. It is used to get
+// argument types from MakeValue when checking format strings at compile time.
+template <int TYPE>
+struct ArgTypeTag { enum { value = TYPE }; };
+
 template<bool B, class T = void>
 struct EnableIf {};
 
@@ -888,6 +1487,44 @@ struct Conditional { typedef T type; };
 template<class T, class F>
 struct Conditional<false, T, F> { typedef F type; };
 
+// Checks if objects of type T can be copied. Without
+// std::is_copy_constructible no types are considered copyable.
+template <typename T>
+struct IsCopyConstructible {
+#if FMT_USE_IS_COPY_CONSTRUCTIBLE
+  enum { value = std::is_copy_constructible<T>::value };
+#else
+  enum { value = 0 };
+#endif
+};
+
+// A copy of an argument of a custom type stored in a format record.
+struct CustomArgCopy {
+  // A pointer to the copy or null if the argument cannot be copied.
+  const void *value;
+  void (*destroy)(const void *value);
+};
+
+template <typename T, bool COPYABLE = IsCopyConstructible<T>::value>
+struct CustomArgCopier {
+  static void copy(const void *, CustomArgCopy &result) {
+    result.value = 0;
+    result.destroy = 0;
+  }
+};
+
+template <typename T>
+struct CustomArgCopier<T, true> {
+  static void destroy(const void *value) {
+    delete static_cast<const T*>(value);
+  }
+
+  static void copy(const void *value, CustomArgCopy &result) {
+    result.value = new T(*static_cast<const T*>(value));
+    result.destroy = &destroy;
+  }
+};
+
 // A helper function to suppress bogus "conditional expression is constant"
 // warnings.
 inline bool check(bool value) { return value; }
@@ -927,9 +1564,16 @@ class MakeValue : public Arg {
   }
 
   // Formats an argument of a custom type, such as a user-defined class.
+  // If formatter is null, copies the argument to the CustomArgCopy object
+  // pointed to by format_str_ptr instead (see BasicFormatRecord).
   template <typename T>
   static void format_custom_arg(
       void *formatter, const void *arg, void *format_str_ptr) {
+    if (!formatter) {
+      CustomArgCopier<T>::copy(
+            arg, *static_cast<CustomArgCopy*>(format_str_ptr));
+      return;
+    }
     format(*static_cast<BasicFormatter<Char>*>(formatter),
            *static_cast<const Char**>(format_str_ptr),
            *static_cast<const T*>(arg));
@@ -940,7 +1584,8 @@ class MakeValue : public Arg {
 
 #define FMT_MAKE_VALUE_(Type, field, TYPE, rhs) \
   MakeValue(Type value) { field = rhs; } \
-  static uint64_t type(Type) { return Arg::TYPE; }
+  static uint64_t type(Type) { return Arg::TYPE; } \
+  static ArgTypeTag<Arg::TYPE> type_tag(Type);
 
 #define FMT_MAKE_VALUE(Type, field, TYPE) \
   FMT_MAKE_VALUE_(Type, field, TYPE, value)
@@ -962,6 +1607,8 @@ class MakeValue : public Arg {
   static uint64_t type(long) {
     return sizeof(long) == sizeof(int) ? Arg::INT : Arg::LONG_LONG;
   }
+  static ArgTypeTag<sizeof(long) == sizeof(int) ?
+                    Arg::INT : Arg::LONG_LONG> type_tag(long);
 
   MakeValue(unsigned long value) {
     if (check(sizeof(unsigned long) == sizeof(unsigned)))
@@ -973,11 +1620,25 @@ class MakeValue : public Arg {
     return sizeof(unsigned long) == sizeof(unsigned) ?
           Arg::UINT : Arg::ULONG_LONG;
   }
+  static ArgTypeTag<sizeof(unsigned long) == sizeof(unsigned) ?
+                    Arg::UINT : Arg::ULONG_LONG> type_tag(unsigned long);
 
   FMT_MAKE_VALUE(LongLong, long_long_value, LONG_LONG)
   FMT_MAKE_VALUE(ULongLong, ulong_long_value, ULONG_LONG)
-  FMT_MAKE_VALUE(float, double_value, DOUBLE)
-  FMT_MAKE_VALUE(double, double_value, DOUBLE)
+  MakeValue(float value) {
+    double_info.value = value;
+    double_info.is_float = true;
+  }
+  static uint64_t type(float) { return Arg::DOUBLE; }
+  static ArgTypeTag<Arg::DOUBLE> type_tag(float);
+
+  MakeValue(double value) {
+    double_info.value = value;
+    double_info.is_float = false;
+  }
+  static uint64_t type(double) { return Arg::DOUBLE; }
+  static ArgTypeTag<Arg::DOUBLE> type_tag(double);
+
   FMT_MAKE_VALUE(long double, long_double_value, LONG_DOUBLE)
   FMT_MAKE_VALUE(signed char, int_value, CHAR)
   FMT_MAKE_VALUE(unsigned char, int_value, CHAR)
@@ -987,10 +1648,12 @@ class MakeValue : public Arg {
     int_value = value;
   }
   static uint64_t type(wchar_t) { return Arg::CHAR; }
+  static ArgTypeTag<Arg::CHAR> type_tag(wchar_t);
 
 #define FMT_MAKE_STR_VALUE(Type, TYPE) \
   MakeValue(Type value) { set_string(value); } \
-  static uint64_t type(Type) { return Arg::TYPE; }
+  static uint64_t type(Type) { return Arg::TYPE; } \
+  static ArgTypeTag<Arg::TYPE> type_tag(Type);
 
   FMT_MAKE_VALUE(char *, string.value, CSTRING)
   FMT_MAKE_VALUE(const char *, string.value, CSTRING)
@@ -1004,7 +1667,8 @@ class MakeValue : public Arg {
   MakeValue(typename WCharHelper<Type, Char>::Supported value) { \
     set_string(value); \
   } \
-  static uint64_t type(Type) { return Arg::TYPE; }
+  static uint64_t type(Type) { return Arg::TYPE; } \
+  static ArgTypeTag<Arg::TYPE> type_tag(Type);
 
   FMT_MAKE_WSTR_VALUE(wchar_t *, WSTRING)
   FMT_MAKE_WSTR_VALUE(const wchar_t *, WSTRING)
@@ -1031,6 +1695,9 @@ class MakeValue : public Arg {
   static uint64_t type(const T &) {
     return IsConvertibleToInt<T>::value ? Arg::INT : Arg::CUSTOM;
   }
+  template <typename T>
+  static ArgTypeTag<IsConvertibleToInt<T>::value ?
+                    Arg::INT : Arg::CUSTOM> type_tag(const T &);
 
   // Additional template param `Char_` is needed here because make_type always
   // uses MakeValue<char>.
@@ -1039,6 +1706,8 @@ class MakeValue : public Arg {
 
   template <typename Char_>
   static uint64_t type(const NamedArg<Char_> &) { return Arg::NAMED_ARG; }
+  template <typename Char_>
+  static ArgTypeTag<Arg::NAMED_ARG> type_tag(const NamedArg<Char_> &);
 };
 
 template <typename Char>
@@ -1107,6 +1776,9 @@ class ArgVisitor {
     return FMT_DISPATCH(visit_unhandled_arg());
   }
 
+  Result visit_float(float value) {
+    return FMT_DISPATCH(visit_double(value));
+  }
   Result visit_double(double value) {
     return FMT_DISPATCH(visit_any_double(value));
   }
@@ -1149,7 +1821,11 @@ class ArgVisitor {
     case Arg::CHAR:
       return FMT_DISPATCH(visit_char(arg.int_value));
     case Arg::DOUBLE:
-      return FMT_DISPATCH(visit_double(arg.double_value));
+      if (arg.double_info.is_float) {
+        return FMT_DISPATCH(visit_float(
+              static_cast<float>(arg.double_info.value)));
+      }
+      return FMT_DISPATCH(visit_double(arg.double_info.value));
     case Arg::LONG_DOUBLE:
       return FMT_DISPATCH(visit_long_double(arg.long_double_value));
     case Arg::CSTRING: {
@@ -1196,10 +1872,17 @@ class ArgList {
     // This is done to reduce compiled code size as storing larger objects
     // may require more code (at least on x86-64) even if the same amount of
     // data is actually copied to stack. It saves ~10% on the bloat test.
+    //
+    // Larger lists created by the formatting functions use the same
+    // compact representation with the types of all arguments packed into
+    // words that follow the values (see the large list constructor).
     const internal::Value *values_;
     const internal::Arg *args_;
   };
 
+  // The type stored in the last packed position of a large list.
+  enum { LARGE_LIST = 0xf };
+
   internal::Arg::Type type(unsigned index) const {
     unsigned shift = index * 4;
     uint64_t mask = 0xf;
@@ -1207,6 +1890,21 @@ class ArgList {
           (types_ & (mask << shift)) >> shift);
   }
 
+  bool is_large() const {
+    return static_cast<int>(type(MAX_PACKED_ARGS - 1)) == LARGE_LIST;
+  }
+
+  // Returns the number of arguments in a large list.
+  unsigned large_size() const { return static_cast<unsigned>(types_); }
+
+  // Returns the type of an argument in a large list.
+  internal::Arg::Type large_type(unsigned index) const {
+    ULongLong types =
+        values_[large_size() + index / MAX_PACKED_ARGS].ulong_long_value;
+    unsigned shift = index % MAX_PACKED_ARGS * 4;
+    return static_cast<internal::Arg::Type>((types >> shift) & 0xf);
+  }
+
   template <typename Char>
   friend class internal::ArgMap;
 
@@ -1218,27 +1916,51 @@ class ArgList {
 
   ArgList(ULongLong types, const internal::Value *values)
   : types_(types), values_(values) {}
+
+  // Constructs a list from an array of arguments terminated by an argument
+  // of type NONE. Accessing arguments past the first MAX_PACKED_ARGS takes
+  // time linear in the index, so prefer large lists for many arguments.
   ArgList(ULongLong types, const internal::Arg *args)
   : types_(types), args_(args) {}
 
+  // Constructs a large list of num_args >= MAX_PACKED_ARGS arguments.
+  // values should point to num_args values followed by
+  // (num_args + MAX_PACKED_ARGS - 1) / MAX_PACKED_ARGS words with packed
+  // types of the arguments in ulong_long_value, MAX_PACKED_ARGS per word.
+  ArgList(const internal::Value *values, unsigned num_args)
+  : types_(static_cast<ULongLong>(LARGE_LIST) << (4 * MAX_PACKED_ARGS - 4) |
+           num_args),
+    values_(values) {}
+
   /** Returns the argument at specified index. */
   internal::Arg operator[](unsigned index) const {
     using internal::Arg;
-    Arg arg;
+    // Only "none" arguments are value-initialized, the others are copied
+    // as a whole, so that the hot path doesn't zero the argument first.
+    if (is_large()) {
+      if (index >= large_size())
+        return Arg();
+      Arg arg;
+      internal::Value &val = arg;
+      val = values_[index];
+      arg.type = large_type(index);
+      return arg;
+    }
     bool use_values = type(MAX_PACKED_ARGS - 1) == Arg::NONE;
     if (index < MAX_PACKED_ARGS) {
       Arg::Type arg_type = type(index);
+      if (arg_type == Arg::NONE)
+        return Arg();
+      Arg arg;
       internal::Value &val = arg;
-      if (arg_type != Arg::NONE)
-        val = use_values ? values_[index] : args_[index];
+      val = use_values ? values_[index] : args_[index];
       arg.type = arg_type;
       return arg;
     }
     if (use_values) {
       // The index is greater than the number of arguments that can be stored
       // in values, so return a "none" argument.
-      arg.type = Arg::NONE;
-      return arg;
+      return Arg();
     }
     for (unsigned i = MAX_PACKED_ARGS; i <= index; ++i) {
       if (args_[i].type == Arg::NONE)
@@ -1252,29 +1974,84 @@ struct FormatSpec;
 
 namespace internal {
 
+// A map from argument names to named arguments. Up to MAX_LINEAR_SIZE
+// arguments are stored in an array that is searched linearly and more are
+// stored in an open addressing hash table. Neither allocates memory unless
+// the table doesn't fit into the inline storage of INLINE_SIZE entries.
+// If several arguments have the same name the first of them is found.
 template <typename Char>
 class ArgMap {
  private:
-  typedef std::map<fmt::BasicStringRef<Char>, internal::Arg> MapType;
-  typedef typename MapType::value_type Pair;
+  enum { MAX_LINEAR_SIZE = 8, INLINE_SIZE = 64 };
 
-  MapType map_;
+  MemoryBuffer<const NamedArg<Char>*, INLINE_SIZE> entries_;
+  bool initialized_;
 
- public:
-  void init(const ArgList &args);
+  // The hash table size - 1 or 0 if the arguments are searched linearly.
+  std::size_t mask_;
 
-  const internal::Arg* find(const fmt::BasicStringRef<Char> &name) const {
-    typename MapType::const_iterator it = map_.find(name);
-    return it != map_.end() ? &it->second : 0;
+  static std::size_t hash(fmt::BasicStringRef<Char> name) {
+    // FNV-1a hash.
+    std::size_t h = 2166136261u;
+    for (const Char *s = name.data(), *end = s + name.size(); s != end; ++s)
+      h = (h ^ static_cast<std::size_t>(*s)) * 16777619u;
+    return h;
   }
-};
 
-class FormatterBase {
- private:
-  ArgList args_;
-  int next_arg_index_;
+  static bool equal(fmt::BasicStringRef<Char> lhs,
+                    fmt::BasicStringRef<Char> rhs) {
+    return lhs.size() == rhs.size() &&
+        std::char_traits<Char>::compare(
+          lhs.data(), rhs.data(), lhs.size()) == 0;
+  }
 
-  // Returns the argument with specified index.
+  // Returns the hash table entry that holds the argument with the specified
+  // name or the empty entry where such argument should be inserted.
+  const NamedArg<Char> *const *find_entry(
+      fmt::BasicStringRef<Char> name) const {
+    const NamedArg<Char> *const *entries = &entries_[0];
+    for (std::size_t i = hash(name) & mask_; ; i = (i + 1) & mask_) {
+      if (!entries[i] || equal(entries[i]->name, name))
+        return entries + i;
+    }
+  }
+
+  void add(const NamedArg<Char> *arg) {
+    if (!mask_) {
+      entries_.push_back(arg);
+      return;
+    }
+    const NamedArg<Char> **entry =
+        const_cast<const NamedArg<Char>**>(find_entry(arg->name));
+    if (!*entry)
+      *entry = arg;
+  }
+
+  // Adds all named arguments from the list.
+  void add(const ArgList &args);
+
+ public:
+  ArgMap() : initialized_(false), mask_(0) {}
+
+  void init(const ArgList &args);
+
+  const internal::Arg* find(const fmt::BasicStringRef<Char> &name) const {
+    if (mask_)
+      return *find_entry(name);
+    for (std::size_t i = 0, n = entries_.size(); i != n; ++i) {
+      if (equal(entries_[i]->name, name))
+        return entries_[i];
+    }
+    return 0;
+  }
+};
+
+class FormatterBase {
+ private:
+  ArgList args_;
+  int next_arg_index_;
+
+  // Returns the argument with specified index.
   Arg do_get_arg(unsigned arg_index, const char *&error);
 
  protected:
@@ -1301,11 +2078,27 @@ class FormatterBase {
   }
 };
 
+// An error detected by a formatting function that doesn't throw.
+struct FormatErrorInfo {
+  // A static error message or a null pointer if there is no error.
+  const char *message;
+
+  // The format code and the name of the argument type for an unknown
+  // format code. They are used to give a more detailed message if the
+  // error is thrown.
+  char code;
+  const char *type_name;
+
+  FormatErrorInfo() : message(0), code(0), type_name(0) {}
+};
+
 // A printf formatter.
 template <typename Char>
 class PrintfFormatter : private FormatterBase {
  private:
-  void parse_flags(FormatSpec &spec, const Char *&s);
+  static void parse_flags(FormatSpec &spec, const Char *&s);
+
+  friend class BasicCompiledPrintfFormat<Char>;
 
   // Returns the argument with specified index or, if arg_index is equal
   // to the maximum unsigned value, the next argument.
@@ -1317,7 +2110,7 @@ class PrintfFormatter : private FormatterBase {
 
  public:
   explicit PrintfFormatter(const ArgList &args) : FormatterBase(args) {}
-  void format(BasicWriter<Char> &writer, BasicCStringRef<Char> format_str);
+  void format(BasicWriter<Char> &writer, BasicStringRef<Char> format_str);
 };
 }  // namespace internal
 
@@ -1338,9 +2131,18 @@ class BasicFormatter : private internal::FormatterBase {
 
   // Parses argument index and returns corresponding argument.
   internal::Arg parse_arg_index(const Char *&s);
+  internal::Arg parse_arg_index(const Char *&s, const char *&error);
 
   // Parses argument name and returns corresponding argument.
   internal::Arg parse_arg_name(const Char *&s);
+  internal::Arg parse_arg_name(const Char *&s, const char *&error);
+
+  // Non-throwing versions of format and parse_spec. They report errors
+  // via error and return a null pointer on error.
+  const Char *format(const Char *&format_str, const internal::Arg &arg,
+                     internal::FormatErrorInfo &error);
+  const Char *parse_spec(const Char *s, const internal::Arg &arg,
+                         FormatSpec &spec, const char *&error);
 
  public:
   BasicFormatter(const ArgList &args, BasicWriter<Char> &w)
@@ -1348,9 +2150,28 @@ class BasicFormatter : private internal::FormatterBase {
 
   BasicWriter<Char> &writer() { return writer_; }
 
-  void format(BasicCStringRef<Char> format_str);
+  void format(BasicStringRef<Char> format_str);
+
+  // Formats format_str reporting errors via error instead of throwing
+  // exceptions. Returns false on error. Exceptions thrown by memory
+  // allocation, by the output buffer and by format functions of
+  // user-defined types are propagated.
+  bool format(BasicStringRef<Char> format_str,
+              internal::FormatErrorInfo &error);
 
   const Char *format(const Char *&format_str, const internal::Arg &arg);
+
+  // Parses the format specification of a replacement field for arguments
+  // of the type of arg. s points to ':' or '}' past the argument id.
+  // Returns a pointer past the closing brace.
+  const Char *parse_spec(
+      const Char *s, const internal::Arg &arg, FormatSpec &spec);
+
+  // Returns the size of the output of format(format_str) without keeping
+  // the output. The size of literal text and of simple replacement fields
+  // is computed directly while other fields are formatted one at a time
+  // into the writer which is cleared before each of them.
+  std::size_t count(BasicStringRef<Char> format_str);
 };
 
 enum Alignment {
@@ -1601,14 +2422,18 @@ inline uint64_t make_type(const T &arg) { return MakeValue<char>::type(arg); }
 
 template <unsigned N>
 struct ArgArray {
-  // Computes the argument array size by adding 1 to N, which is the number of
-  // arguments, if N is zero, because array of zero size is invalid, or if N
-  // is greater than ArgList::MAX_PACKED_ARGS to accommodate for an extra
-  // argument that marks the end of the list.
-  enum { SIZE = N + (N == 0 || N >= ArgList::MAX_PACKED_ARGS ? 1 : 0) };
+  enum {
+    // The number of words with packed types of a large argument list.
+    NUM_TYPE_WORDS =
+      (N + ArgList::MAX_PACKED_ARGS - 1) / ArgList::MAX_PACKED_ARGS,
+    // Computes the argument array size by adding 1 to N, which is the number
+    // of arguments, if N is zero, because array of zero size is invalid, or
+    // the number of type words if N is not less than
+    // ArgList::MAX_PACKED_ARGS and the types don't fit into ArgList.
+    SIZE = N == 0 ? 1 : N + (N >= ArgList::MAX_PACKED_ARGS ? NUM_TYPE_WORDS : 0)
+  };
 
-  typedef typename Conditional<
-    (N < ArgList::MAX_PACKED_ARGS), Value, Arg>::type Type[SIZE];
+  typedef Value Type[SIZE];
 };
 
 #if FMT_USE_VARIADIC_TEMPLATES
@@ -1617,45 +2442,38 @@ inline uint64_t make_type(const Arg &first, const Args & ... tail) {
   return make_type(first) | (make_type(tail...) << 4);
 }
 
-inline void do_set_types(Arg *) {}
+inline void set_types(Value *, unsigned) {}
 
+// Packs the types of a large argument list into the words following
+// the values.
 template <typename T, typename... Args>
-inline void do_set_types(Arg *args, const T &arg, const Args & ... tail) {
-  args->type = static_cast<Arg::Type>(MakeValue<T>::type(arg));
-  do_set_types(args + 1, tail...);
+inline void set_types(Value *types, unsigned index,
+                      const T &arg, const Args & ... tail) {
+  ULongLong &word = types[index / ArgList::MAX_PACKED_ARGS].ulong_long_value;
+  unsigned shift = index % ArgList::MAX_PACKED_ARGS * 4;
+  if (shift == 0)
+    word = 0;
+  word |= make_type(arg) << shift;
+  set_types(types, index + 1, tail...);
 }
 
-template <typename... Args>
-inline void set_types(Arg *array, const Args & ... args) {
-  if (check(sizeof...(Args) > ArgList::MAX_PACKED_ARGS))
-    do_set_types(array, args...);
-  array[sizeof...(Args)].type = Arg::NONE;
-}
-
-template <typename... Args>
-inline void set_types(Value *, const Args & ...) {
-  // Do nothing as types are passed separately from values.
-}
-
-template <typename Char, typename Value>
+template <typename Char>
 inline void store_args(Value *) {}
 
-template <typename Char, typename Arg, typename T, typename... Args>
-inline void store_args(Arg *args, const T &arg, const Args & ... tail) {
-  // Assign only the Value subobject of Arg and don't overwrite type (if any)
-  // that is assigned by set_types.
-  Value &value = *args;
-  value = MakeValue<Char>(arg);
-  store_args<Char>(args + 1, tail...);
+template <typename Char, typename T, typename... Args>
+inline void store_args(Value *values, const T &arg, const Args & ... tail) {
+  *values = MakeValue<Char>(arg);
+  store_args<Char>(values + 1, tail...);
 }
 
 template <typename Char, typename... Args>
 ArgList make_arg_list(typename ArgArray<sizeof...(Args)>::Type array,
                       const Args & ... args) {
-  if (check(sizeof...(Args) >= ArgList::MAX_PACKED_ARGS))
-    set_types(array, args...);
   store_args<Char>(array, args...);
-  return ArgList(make_type(args...), array);
+  if (check(sizeof...(Args) < ArgList::MAX_PACKED_ARGS))
+    return ArgList(make_type(args...), array);
+  set_types(array + sizeof...(Args), 0, args...);
+  return ArgList(array, static_cast<unsigned>(sizeof...(Args)));
 }
 #else
 
@@ -1819,6 +2637,200 @@ class SystemError : public internal::RuntimeError {
   int error_code() const { return error_code_; }
 };
 
+namespace internal {
+
+// A reference to an argument in a compiled format string.
+struct ArgRef {
+  enum Kind { NONE, INDEX, NAME };
+
+  Kind kind;
+  // The argument index or, for a named argument, the offset of the name
+  // in the format string. BasicCompiledFormat replaces the offset with the
+  // index of the name in its table of distinct names.
+  unsigned index;
+  unsigned name_size;
+
+  ArgRef(Kind k = NONE, unsigned i = 0, unsigned size = 0)
+  : kind(k), index(i), name_size(size) {}
+};
+
+// A part of a compiled format string consisting of a literal text and an
+// optional replacement field that follows it. Offsets are relative to the
+// start of the format string.
+struct FormatItem {
+  // Flags of the checks that depend on the argument type and are done
+  // when the format is applied.
+  enum {
+    CHECK_NUMERIC_ALIGN = 1, CHECK_SIGN = 2, CHECK_HASH = 4, CHECK_ZERO = 8,
+    CHECK_PRECISION = 0x10,
+    // The replacement field couldn't be parsed without knowing the argument
+    // type and is parsed when the format is applied. This is used for custom
+    // format specifiers.
+    PARSE_AT_RUNTIME = 0x20
+  };
+
+  std::size_t text_offset;
+  std::size_t text_size;
+  ArgRef arg;
+  ArgRef width_arg;
+  ArgRef precision_arg;
+  FormatSpec spec;
+  // The offset of the format specification (starting with ':' or '}') in
+  // the format string.
+  std::size_t spec_offset;
+  unsigned flags;
+  char sign;
+  // The length modifier of a printf format specification.
+  char length;
+
+  FormatItem(std::size_t offset, std::size_t size)
+  : text_offset(offset), text_size(size), spec_offset(0), flags(0),
+    sign(0), length(0) {}
+};
+
+// The base class of compiled format strings.
+template <typename Char>
+class CompiledFormatBase {
+ protected:
+  std::basic_string<Char> format_;
+  std::vector<FormatItem> items_;
+
+  explicit CompiledFormatBase(BasicStringRef<Char> format_str)
+  : format_(format_str.data(), format_str.size()) {}
+
+  // Adds an item corresponding to the literal text [start, end).
+  FormatItem &add_item(const Char *start, const Char *end) {
+    const Char *data = format_.c_str();
+    items_.push_back(FormatItem(start - data, end - start));
+    return items_.back();
+  }
+
+  // Writes the literal text of the item.
+  void write_text(BasicWriter<Char> &w, const FormatItem &item) const {
+    if (item.text_size != 0) {
+      w << BasicStringRef<Char>(
+             format_.c_str() + item.text_offset, item.text_size);
+    }
+  }
+
+ public:
+  /** Returns the format string. */
+  BasicCStringRef<Char> format_str() const { return format_.c_str(); }
+};
+
+// A part of a format string checked at compile time consisting of a literal
+// text and an optional replacement field that follows it. Unlike FormatItem
+// it is a literal type and all the checks have already been done for it.
+struct StaticFormatItem {
+  std::size_t text_offset;
+  std::size_t text_size;
+  // The offset of the format specification (starting with ':' or '}') in
+  // the format string.
+  std::size_t spec_offset;
+  // The indices of the formatted argument and of the arguments giving
+  // dynamic width and precision or -1 if there are no such arguments.
+  int arg_index;
+  int width_index;
+  int precision_index;
+  unsigned width;
+  int precision;
+  unsigned flags;
+  wchar_t fill;
+  Alignment align;
+  char type;
+
+  FMT_CONSTEXPR StaticFormatItem()
+  : text_offset(0), text_size(0), spec_offset(0), arg_index(-1),
+    width_index(-1), precision_index(-1), width(0), precision(-1), flags(0),
+    fill(' '), align(ALIGN_DEFAULT), type(0) {}
+};
+
+// Formats arguments according to the items of a format string checked at
+// compile time.
+template <typename Char>
+void format_static(BasicWriter<Char> &w, const Char *format,
+                   const StaticFormatItem *items, std::size_t num_items,
+                   ArgList args);
+}  // namespace internal
+
+/**
+  \rst
+  A format string that is parsed once and can be applied to different
+  argument lists with no parsing overhead. It uses the same syntax as
+  :func:`fmt::format`. Syntax errors are reported by the constructor while
+  errors that depend on the argument types are reported when the format is
+  applied.
+
+  **Example**::
+
+    static const fmt::CompiledFormat message("{}: {:.2f} ms");
+    std::string s = fmt::format(message, "elapsed", 1.23);
+  \endrst
+ */
+template <typename Char>
+class BasicCompiledFormat : public internal::CompiledFormatBase<Char> {
+ private:
+  // References to the distinct argument names in the format string which
+  // are looked up once per call.
+  std::vector<internal::ArgRef> names_;
+
+  // Parses the format string.
+  void compile();
+
+  // Replaces the name offset in a reference to a named argument with
+  // the index of the name in names_.
+  void add_name(internal::ArgRef &ref);
+
+ public:
+  /**
+    Parses the format string. Throws :class:`fmt::FormatError` if the string
+    is invalid.
+   */
+  explicit BasicCompiledFormat(BasicStringRef<Char> format_str)
+  : internal::CompiledFormatBase<Char>(format_str) {
+    compile();
+  }
+
+  /** Formats arguments and writes the output to the writer *w*. */
+  void format(BasicWriter<Char> &w, ArgList args) const;
+};
+
+typedef BasicCompiledFormat<char> CompiledFormat;
+typedef BasicCompiledFormat<wchar_t> WCompiledFormat;
+
+/**
+  \rst
+  A precompiled printf format string. See :class:`fmt::BasicCompiledFormat`.
+
+  **Example**::
+
+    static const fmt::CompiledPrintfFormat message("%s: %.2f ms");
+    std::string s = fmt::sprintf(message, "elapsed", 1.23);
+  \endrst
+ */
+template <typename Char>
+class BasicCompiledPrintfFormat : public internal::CompiledFormatBase<Char> {
+ private:
+  // Parses the format string.
+  void compile();
+
+ public:
+  /**
+    Parses the format string. Throws :class:`fmt::FormatError` if the string
+    is invalid.
+   */
+  explicit BasicCompiledPrintfFormat(BasicStringRef<Char> format_str)
+  : internal::CompiledFormatBase<Char>(format_str) {
+    compile();
+  }
+
+  /** Formats arguments and writes the output to the writer *w*. */
+  void format(BasicWriter<Char> &w, ArgList args) const;
+};
+
+typedef BasicCompiledPrintfFormat<char> CompiledPrintfFormat;
+typedef BasicCompiledPrintfFormat<wchar_t> WCompiledPrintfFormat;
+
 /**
   \rst
   This template provides operations for formatting and writing data into
@@ -1859,6 +2871,13 @@ class BasicWriter {
   static CharPtr fill_padding(CharPtr buffer,
       unsigned total_size, std::size_t content_size, wchar_t fill);
 
+  // Grows the buffer once by the field width or the content size, whichever
+  // is greater, fills the padding and returns a pointer to the content area.
+  // ALIGN_RIGHT and ALIGN_NUMERIC pad on the left, ALIGN_CENTER on both
+  // sides and other alignments on the right.
+  CharPtr grow_padded(std::size_t size, unsigned width,
+                      Alignment align, Char fill);
+
   // Grows the buffer by n characters and returns a pointer to the newly
   // allocated area.
   CharPtr grow_buffer(std::size_t n) {
@@ -1905,10 +2924,27 @@ class BasicWriter {
   template <typename T, typename Spec>
   void write_int(T value, Spec spec);
 
-  // Formats a floating-point number (double or long double).
+  // Formats a floating-point number (float, double or long double).
   template <typename T>
   void write_double(T value, const FormatSpec &spec);
 
+  // Formats a finite nonnegative double using the built-in floating-point
+  // formatter. Returns false if the value should be formatted with snprintf.
+  // If is_float is true, the shortest representation is computed at float
+  // precision.
+  bool write_double_grisu(double value, char type, char sign,
+                          const FormatSpec &spec, bool is_float = false);
+
+  bool write_double_grisu(
+      float value, char type, char sign, const FormatSpec &spec) {
+    return write_double_grisu(static_cast<double>(value), type, sign, spec,
+                              true);
+  }
+
+  bool write_double_grisu(long double, char, char, const FormatSpec &) {
+    return false;
+  }
+
   // Writes a formatted string.
   template <typename StrChar>
   CharPtr write_str(
@@ -1935,6 +2971,18 @@ class BasicWriter {
   template<typename T>
   void append_float_length(Char *&, T) {}
 
+  // Formats an argument according to spec. Custom arguments are not
+  // supported.
+  void write_arg(const internal::Arg &arg, FormatSpec spec);
+
+  template <typename T>
+  void write_element(const T &value, const FormatSpec &spec) {
+    internal::Arg arg = internal::MakeValue<Char>(value);
+    arg.type = static_cast<internal::Arg::Type>(
+          internal::MakeValue<Char>::type(value));
+    write_arg(arg, spec);
+  }
+
   template <typename Impl, typename Char_>
   friend class internal::BasicArgFormatter;
 
@@ -1985,6 +3033,49 @@ class BasicWriter {
     return std::basic_string<Char>(&buffer_[0], buffer_.size());
   }
 
+  /** Returns the output buffer. */
+  Buffer<Char> &buffer() FMT_NOEXCEPT { return buffer_; }
+
+  /**
+    \rst
+    Writes a wide string. If this is a ``char`` writer the string is
+    converted to UTF-8 directly in the output buffer without intermediate
+    copies. Throws `~fmt::FormatError` if the string is not valid UTF-16,
+    or UTF-32 where ``wchar_t`` is 32 bits wide.
+
+    **Example**::
+
+      fmt::MemoryWriter out;
+      out.write_wide(L"\u00e9t\u00e9");
+      // out.str() == "\xc3\xa9t\xc3\xa9"
+    \endrst
+   */
+  BasicWriter &write_wide(WStringRef s) {
+    internal::append_wide(buffer_, s);
+    return *this;
+  }
+
+  /**
+    \rst
+    Writes a preformatted string padded to *width* characters with *fill*
+    according to *align*. The buffer is grown once for the whole field, so
+    this is the cheapest way to write column-aligned output. Strings that
+    are not shorter than *width* are written as is.
+
+    **Example**::
+
+      fmt::MemoryWriter out;
+      out.write_padded("name", 8).write_padded("42", 6, fmt::ALIGN_RIGHT);
+      // out.str() == "name        42"
+    \endrst
+   */
+  BasicWriter &write_padded(BasicStringRef<Char> s, unsigned width,
+                            Alignment align = ALIGN_LEFT, Char fill = ' ') {
+    std::copy(s.data(), s.data() + s.size(),
+              grow_padded(s.size(), width, align, fill));
+    return *this;
+  }
+
   /**
     \rst
     Writes formatted data.
@@ -2010,10 +3101,43 @@ class BasicWriter {
     See also :ref:`syntax`.
     \endrst
    */
-  void write(BasicCStringRef<Char> format, ArgList args) {
+  void write(BasicStringRef<Char> format, ArgList args) {
     BasicFormatter<Char>(args, *this).format(format);
   }
-  FMT_VARIADIC_VOID(write, BasicCStringRef<Char>)
+  FMT_VARIADIC_VOID(write, BasicStringRef<Char>)
+
+  /**
+    Writes data formatted according to a compiled format string.
+   */
+  void write(const BasicCompiledFormat<Char> &format, ArgList args) {
+    format.format(*this, args);
+  }
+  FMT_VARIADIC_VOID(write, const BasicCompiledFormat<Char> &)
+
+  /**
+    \rst
+    Formats the elements of the range [*first*, *last*) according to *spec*
+    separating them with *sep*. The same specification is used for all
+    elements without parsing it again and, if the iterators are random
+    access, the buffer is grown only once for a range of integers.
+    Elements of user-defined types are not supported; use `fmt::join` to
+    format them.
+
+    **Example**::
+
+      std::vector<double> v;
+      v.push_back(1.234);
+      v.push_back(5.678);
+      fmt::FormatSpec spec(0, 'f');
+      spec.precision_ = 1;
+      fmt::MemoryWriter out;
+      out.write_range(v.begin(), v.end(), spec, ", ");
+      // out.str() == "1.2, 5.7"
+    \endrst
+   */
+  template <typename It>
+  void write_range(It first, It last, const FormatSpec &spec,
+                   BasicStringRef<Char> sep);
 
   BasicWriter &operator<<(int value) {
     write_decimal(value);
@@ -2043,11 +3167,28 @@ class BasicWriter {
     return *this << IntFormatSpec<ULongLong>(value);
   }
 
+  /**
+    \rst
+    Formats *value* using the shortest representation that round-trips
+    and writes it to the stream.
+    \endrst
+   */
   BasicWriter &operator<<(double value) {
     write_double(value, FormatSpec());
     return *this;
   }
 
+  /**
+    \rst
+    Formats *value* using the shortest representation that round-trips
+    at float precision and writes it to the stream.
+    \endrst
+   */
+  BasicWriter &operator<<(float value) {
+    write_double(value, FormatSpec());
+    return *this;
+  }
+
   /**
     \rst
     Formats *value* using the general format for floating-point numbers
@@ -2112,21 +3253,11 @@ template <typename Char>
 template <typename StrChar>
 typename BasicWriter<Char>::CharPtr BasicWriter<Char>::write_str(
       const StrChar *s, std::size_t size, const AlignSpec &spec) {
-  CharPtr out = CharPtr();
-  if (spec.width() > size) {
-    out = grow_buffer(spec.width());
-    Char fill = internal::CharTraits<Char>::cast(spec.fill());
-    if (spec.align() == ALIGN_RIGHT) {
-      std::fill_n(out, spec.width() - size, fill);
-      out += spec.width() - size;
-    } else if (spec.align() == ALIGN_CENTER) {
-      out = fill_padding(out, spec.width(), size, fill);
-    } else {
-      std::fill_n(out + size, spec.width() - size, fill);
-    }
-  } else {
-    out = grow_buffer(size);
-  }
+  // Numeric alignment only applies to numbers, so strings and non-finite
+  // values are padded on the right as with the default alignment.
+  Alignment align = spec.align() == ALIGN_NUMERIC ? ALIGN_LEFT : spec.align();
+  CharPtr out = grow_padded(size, spec.width(), align,
+                            internal::CharTraits<Char>::cast(spec.fill()));
   std::copy(s, s + size, out);
   return out;
 }
@@ -2139,13 +3270,34 @@ typename BasicWriter<Char>::CharPtr
   std::size_t padding = total_size - content_size;
   std::size_t left_padding = padding / 2;
   Char fill_char = internal::CharTraits<Char>::cast(fill);
-  std::fill_n(buffer, left_padding, fill_char);
+  internal::fill_chars(get(buffer), left_padding, fill_char);
   buffer += left_padding;
   CharPtr content = buffer;
-  std::fill_n(buffer + content_size, padding - left_padding, fill_char);
+  internal::fill_chars(get(buffer + content_size),
+                       padding - left_padding, fill_char);
   return content;
 }
 
+template <typename Char>
+typename BasicWriter<Char>::CharPtr
+  BasicWriter<Char>::grow_padded(
+    std::size_t size, unsigned width, Alignment align, Char fill) {
+  if (width <= size)
+    return grow_buffer(size);
+  CharPtr out = grow_buffer(width);
+  std::size_t padding = width - size;
+  switch (align) {
+  case ALIGN_RIGHT: case ALIGN_NUMERIC:
+    internal::fill_chars(get(out), padding, fill);
+    return out + padding;
+  case ALIGN_CENTER:
+    return fill_padding(out, width, size, fill);
+  default:
+    internal::fill_chars(get(out + size), padding, fill);
+    return out;
+  }
+}
+
 template <typename Char>
 template <typename Spec>
 typename BasicWriter<Char>::CharPtr
@@ -2161,52 +3313,27 @@ typename BasicWriter<Char>::CharPtr
     if (prefix_size > 0 && prefix[prefix_size - 1] == '0')
       --prefix_size;
     unsigned number_size = prefix_size + spec.precision();
-    AlignSpec subspec(number_size, '0', ALIGN_NUMERIC);
-    if (number_size >= width)
-      return prepare_int_buffer(num_digits, subspec, prefix, prefix_size);
-    buffer_.reserve(width);
-    unsigned fill_size = width - number_size;
-    if (align != ALIGN_LEFT) {
-      CharPtr p = grow_buffer(fill_size);
-      std::fill(p, p + fill_size, fill);
-    }
-    CharPtr result = prepare_int_buffer(
-        num_digits, subspec, prefix, prefix_size);
-    if (align == ALIGN_LEFT) {
-      CharPtr p = grow_buffer(fill_size);
-      std::fill(p, p + fill_size, fill);
-    }
-    return result;
+    // The field is reserved once: padding, prefix, zeros, then digits.
+    CharPtr p = grow_padded(number_size, width,
+                            align == ALIGN_LEFT ? ALIGN_LEFT : ALIGN_RIGHT,
+                            fill);
+    p = std::copy(prefix, prefix + prefix_size, p);
+    unsigned num_zeros = spec.precision() - num_digits;
+    internal::fill_chars(get(p), num_zeros, static_cast<Char>('0'));
+    return p + num_zeros + num_digits - 1;
   }
   unsigned size = prefix_size + num_digits;
-  if (width <= size) {
-    CharPtr p = grow_buffer(size);
-    std::copy(prefix, prefix + prefix_size, p);
-    return p + size - 1;
-  }
-  CharPtr p = grow_buffer(width);
-  CharPtr end = p + width;
-  if (align == ALIGN_LEFT) {
-    std::copy(prefix, prefix + prefix_size, p);
-    p += size;
-    std::fill(p, end, fill);
-  } else if (align == ALIGN_CENTER) {
-    p = fill_padding(p, width, size, fill);
-    std::copy(prefix, prefix + prefix_size, p);
-    p += size;
-  } else {
-    if (align == ALIGN_NUMERIC) {
-      if (prefix_size != 0) {
-        p = std::copy(prefix, prefix + prefix_size, p);
-        size -= prefix_size;
-      }
-    } else {
-      std::copy(prefix, prefix + prefix_size, end - size);
-    }
-    std::fill(p, end - size, fill);
-    p = end;
+  if (align == ALIGN_NUMERIC && width > size) {
+    CharPtr p = grow_buffer(width);
+    p = std::copy(prefix, prefix + prefix_size, p);
+    internal::fill_chars(get(p), width - size, fill);
+    return p + (width - prefix_size) - 1;
   }
-  return p - 1;
+  // Integers are right-aligned by default.
+  CharPtr p = grow_padded(size, width,
+                          align == ALIGN_DEFAULT ? ALIGN_RIGHT : align, fill);
+  std::copy(prefix, prefix + prefix_size, p);
+  return p + size - 1;
 }
 
 template <typename Char>
@@ -2238,13 +3365,9 @@ void BasicWriter<Char>::write_int(T value, Spec spec) {
       prefix[prefix_size++] = '0';
       prefix[prefix_size++] = spec.type();
     }
-    unsigned num_digits = 0;
-    do {
-      ++num_digits;
-    } while ((n >>= 4) != 0);
+    unsigned num_digits = (internal::count_bits(n) + 3) / 4;
     Char *p = get(prepare_int_buffer(
       num_digits, spec, prefix, prefix_size));
-    n = abs_value;
     const char *digits = spec.type() == 'x' ?
         "0123456789abcdef" : "0123456789ABCDEF";
     do {
@@ -2258,12 +3381,8 @@ void BasicWriter<Char>::write_int(T value, Spec spec) {
       prefix[prefix_size++] = '0';
       prefix[prefix_size++] = spec.type();
     }
-    unsigned num_digits = 0;
-    do {
-      ++num_digits;
-    } while ((n >>= 1) != 0);
+    unsigned num_digits = internal::count_bits(n);
     Char *p = get(prepare_int_buffer(num_digits, spec, prefix, prefix_size));
-    n = abs_value;
     do {
       *p-- = '0' + (n & 1);
     } while ((n >>= 1) != 0);
@@ -2273,12 +3392,8 @@ void BasicWriter<Char>::write_int(T value, Spec spec) {
     UnsignedType n = abs_value;
     if (spec.flag(HASH_FLAG))
       prefix[prefix_size++] = '0';
-    unsigned num_digits = 0;
-    do {
-      ++num_digits;
-    } while ((n >>= 3) != 0);
+    unsigned num_digits = (internal::count_bits(n) + 2) / 3;
     Char *p = get(prepare_int_buffer(num_digits, spec, prefix, prefix_size));
-    n = abs_value;
     do {
       *p-- = '0' + (n & 7);
     } while ((n >>= 3) != 0);
@@ -2291,6 +3406,32 @@ void BasicWriter<Char>::write_int(T value, Spec spec) {
   }
 }
 
+template <typename Char>
+template <typename It>
+void BasicWriter<Char>::write_range(It first, It last, const FormatSpec &spec,
+                                   BasicStringRef<Char> sep) {
+  if (first == last)
+    return;
+  typedef typename std::iterator_traits<It>::value_type T;
+  typedef std::numeric_limits<T> Limits;
+  if (internal::check(Limits::is_integer)) {
+    // Reserve space for the worst case which is binary or octal output with
+    // a sign and a prefix.
+    char type = spec.type();
+    unsigned size = (type == 'b' || type == 'B' ?
+          Limits::digits : Limits::digits / 3 + 1) + 3;
+    std::size_t count = internal::range_size(first, last,
+          typename std::iterator_traits<It>::iterator_category());
+    buffer_.reserve(buffer_.size() +
+                    count * ((std::max)(size, spec.width()) + sep.size()));
+  }
+  write_element(*first, spec);
+  for (++first; first != last; ++first) {
+    buffer_.append(sep.data(), sep.data() + sep.size());
+    write_element(*first, spec);
+  }
+}
+
 template <typename Char>
 template <typename T>
 void BasicWriter<Char>::write_double(
@@ -2358,6 +3499,9 @@ void BasicWriter<Char>::write_double(
     return;
   }
 
+  if (write_double_grisu(value, spec.type(), sign, spec))
+    return;
+
   std::size_t offset = buffer_.size();
   unsigned width = spec.width();
   if (sign) {
@@ -2393,6 +3537,7 @@ void BasicWriter<Char>::write_double(
   *format_ptr = '\0';
 
   // Format using snprintf.
+  FMT_ADD_STAT(DOUBLE_SNPRINTF_CALLS, 1);
   Char fill = internal::CharTraits<Char>::cast(spec.fill());
   for (;;) {
     std::size_t buffer_size = buffer_.capacity() - offset;
@@ -2438,10 +3583,156 @@ void BasicWriter<Char>::write_double(
     }
     // If n is negative we ask to increase the capacity by at least 1,
     // but as std::vector, the buffer grows exponentially.
+    FMT_ADD_STAT(DOUBLE_SNPRINTF_RETRIES, 1);
     buffer_.reserve(n >= 0 ? offset + n + 1 : buffer_.capacity() + 1);
   }
 }
 
+template <typename Char>
+bool BasicWriter<Char>::write_double_grisu(
+    double value, char type, char sign, const FormatSpec &spec,
+    bool is_float) {
+  int precision = spec.precision();
+  bool hash = spec.flag(HASH_FLAG);
+  // Use the shortest representation that round-trips if neither type nor
+  // precision are specified.
+  bool shortest = type == 0 && precision < 0 && !hash;
+  char exp_char = 'e';
+  switch (type) {
+  case 0:
+    type = 'g';
+    break;
+  case 'e': case 'f': case 'g':
+    break;
+  case 'E': case 'F': case 'G':
+    exp_char = 'E';
+    type = static_cast<char>(type - 'A' + 'a');
+    break;
+  default:
+    return false;
+  }
+  if (precision < 0)
+    precision = 6;
+  else if (precision == 0 && type == 'g')
+    precision = 1;
+  if (precision >= (type == 'f' ? 1000 : internal::MAX_GRISU_DIGITS))
+    return false;
+
+  char digits[internal::MAX_GRISU_DIGITS];
+  int num_digits = 1, exp = 0;
+  if (value == 0) {
+    digits[0] = '0';
+  } else if (shortest && is_float) {
+    internal::grisu_format_float(
+          static_cast<float>(value), digits, num_digits, exp);
+  } else if (!internal::grisu_format(
+          value, digits, num_digits, exp,
+          shortest ? -1 : (type == 'e' ? precision + 1 : precision),
+          type == 'f')) {
+    return false;
+  }
+
+  // Position of the decimal point relative to the first digit.
+  int point = num_digits + exp;
+  // Decimal exponent in the exponential notation.
+  int exp10 = point - 1;
+  bool use_exp = type == 'e';
+  int num_frac_digits = precision;
+  if (shortest) {
+    use_exp = exp10 < -4 || exp10 >= 16;
+    num_frac_digits = use_exp ?
+          num_digits - 1 : (std::max)(num_digits - point, 0);
+  } else if (type == 'g') {
+    use_exp = exp10 < -4 || exp10 >= precision;
+    if (hash) {
+      num_frac_digits = use_exp ? precision - 1 : precision - 1 - exp10;
+    } else {
+      // Remove trailing zeros.
+      while (num_digits > 1 && digits[num_digits - 1] == '0')
+        --num_digits;
+      num_frac_digits = use_exp ?
+            num_digits - 1 : (std::max)(num_digits - point, 0);
+    }
+  }
+
+  // Compute the output size.
+  bool show_point = num_frac_digits > 0 || hash;
+  std::size_t size = use_exp || point <= 0 ? 1 : point;
+  if (show_point)
+    size += 1 + num_frac_digits;
+  unsigned abs_exp10 = 0;
+  if (use_exp) {
+    abs_exp10 = exp10 < 0 ? 0 - exp10 : exp10;
+    size += abs_exp10 >= 100 ? 5 : 4;
+  }
+  if (sign)
+    ++size;
+
+  // Write padding and sign.
+  unsigned width = spec.width();
+  CharPtr out = grow_buffer((std::max)(static_cast<std::size_t>(width), size));
+  if (width > size) {
+    unsigned padding = width - static_cast<unsigned>(size);
+    Char fill = internal::CharTraits<Char>::cast(spec.fill());
+    if (spec.align() == ALIGN_LEFT) {
+      internal::fill_chars(get(out + size), padding, fill);
+    } else if (spec.align() == ALIGN_CENTER) {
+      out = fill_padding(out, width, size, fill);
+    } else {
+      if (sign && spec.align() == ALIGN_NUMERIC) {
+        *out++ = sign;
+        sign = 0;
+      }
+      internal::fill_chars(get(out), padding, fill);
+      out += padding;
+    }
+  }
+  if (sign)
+    *out++ = sign;
+
+  // Write digits.
+  if (use_exp) {
+    *out++ = digits[0];
+    if (show_point) {
+      *out++ = '.';
+      int n = (std::min)(num_digits - 1, num_frac_digits);
+      out = std::copy(digits + 1, digits + 1 + n, out);
+      std::fill_n(out, num_frac_digits - n, '0');
+      out += num_frac_digits - n;
+    }
+    *out++ = exp_char;
+    *out++ = exp10 < 0 ? '-' : '+';
+    if (abs_exp10 >= 100) {
+      *out++ = static_cast<char>('0' + abs_exp10 / 100);
+      abs_exp10 %= 100;
+    }
+    *out++ = internal::Data::DIGITS[abs_exp10 * 2];
+    *out = internal::Data::DIGITS[abs_exp10 * 2 + 1];
+    return true;
+  }
+  if (point <= 0) {
+    *out++ = '0';
+  } else {
+    int n = (std::min)(num_digits, point);
+    out = std::copy(digits, digits + n, out);
+    std::fill_n(out, point - n, '0');
+    out += point - n;
+  }
+  if (show_point) {
+    *out++ = '.';
+    // Write zeros between the decimal point and the first digit.
+    int num_zeros = (std::min)((std::max)(-point, 0), num_frac_digits);
+    std::fill_n(out, num_zeros, '0');
+    out += num_zeros;
+    int start = (std::max)(point, 0);
+    int n = (std::max)(
+          (std::min)(num_digits - start, num_frac_digits - num_zeros), 0);
+    out = std::copy(digits + start, digits + start + n, out);
+    std::fill_n(out, num_frac_digits - num_zeros - n, '0');
+  }
+  return true;
+}
+
 /**
   \rst
   This class template provides operations for formatting and writing data
@@ -2474,12 +3765,24 @@ void BasicWriter<Char>::write_double(
 
   The output can be converted to an ``std::string`` with ``out.str()`` or
   accessed as a C string with ``out.c_str()``.
+
+  The first *SIZE* characters are stored in the writer object itself and
+  memory is only allocated with *Allocator* if the output is longer, so
+  the inline size can be chosen to fit the typical output at the call site::
+
+     fmt::BasicMemoryWriter<char, std::allocator<char>, 64> out;
+
+  The buffer grows according to *Policy*, which is
+  :class:`fmt::DefaultGrowthPolicy` unless :class:`fmt::GrowthPolicy` is
+  passed to set the policy at runtime.
   \endrst
  */
-template <typename Char, typename Allocator = std::allocator<Char> >
+template <typename Char, typename Allocator = std::allocator<Char>,
+          std::size_t SIZE = internal::INLINE_BUFFER_SIZE,
+          typename Policy = DefaultGrowthPolicy>
 class BasicMemoryWriter : public BasicWriter<Char> {
  private:
-  internal::MemoryBuffer<Char, internal::INLINE_BUFFER_SIZE, Allocator> buffer_;
+  internal::MemoryBuffer<Char, SIZE, Allocator, Policy> buffer_;
 
  public:
   explicit BasicMemoryWriter(const Allocator& alloc = Allocator())
@@ -2506,6 +3809,23 @@ class BasicMemoryWriter : public BasicWriter<Char> {
     return *this;
   }
 #endif
+
+  /** Sets the policy used to grow the buffer when it runs out of space. */
+  void set_growth_policy(const Policy &policy) {
+    buffer_.set_growth_policy(policy);
+  }
+
+  /**
+    Reduces the capacity of the buffer to the size of the output, returning
+    the unused memory to the allocator.
+   */
+  void shrink_to_fit() { buffer_.shrink_to_fit(); }
+
+  /**
+    Clears the output and frees the memory allocated by the writer so that
+    a long-lived writer doesn't keep the memory for its largest output.
+   */
+  void release() { buffer_.release(); }
 };
 
 typedef BasicMemoryWriter<char> MemoryWriter;
@@ -2513,26 +3833,125 @@ typedef BasicMemoryWriter<wchar_t> WMemoryWriter;
 
 /**
   \rst
-  This class template provides operations for formatting and writing data
-  into a fixed-size array. For writing into a dynamically growing buffer
-  use :class:`fmt::BasicMemoryWriter`.
-  
-  Any write method will throw ``std::runtime_error`` if the output doesn't fit
-  into the array.
+  This class template provides operations for formatting and writing large
+  documents. The output is stored in a list of fixed-size chunks rather than
+  a contiguous buffer, so growing the output never copies the data written
+  by earlier ``write`` and ``<<`` operations. The output is accessed as a
+  list of segments that can be passed to a scatter write such as ``writev``
+  without copying.
 
   You can use one of the following typedefs for common character types:
 
-  +--------------+---------------------------+
-  | Type         | Definition                |
-  +==============+===========================+
-  | ArrayWriter  | BasicArrayWriter<char>    |
-  +--------------+---------------------------+
-  | WArrayWriter | BasicArrayWriter<wchar_t> |
-  +--------------+---------------------------+
+  +------------------+-------------------------------+
+  | Type             | Definition                    |
+  +==================+===============================+
+  | SegmentedWriter  | BasicSegmentedWriter<char>    |
+  +------------------+-------------------------------+
+  | WSegmentedWriter | BasicSegmentedWriter<wchar_t> |
+  +------------------+-------------------------------+
+
+  **Example**::
+
+     fmt::SegmentedWriter out;
+     for (int i = 0; i < 1000000; ++i)
+       out.write("{}: {}\n", i, names[i]);
+     const std::vector<fmt::StringRef> &segments = out.segments();
+
+  The writer can be used wherever a :class:`fmt::BasicWriter` is expected.
+  Output written through a ``BasicWriter`` reference is kept in the current
+  chunk until the next operation on the ``BasicSegmentedWriter`` itself, and
+  ``BasicWriter::size`` only counts that part, so use
+  :func:`fmt::BasicSegmentedWriter::size` for the total size.
   \endrst
  */
 template <typename Char>
-class BasicArrayWriter : public BasicWriter<Char> {
+class BasicSegmentedWriter : public BasicWriter<Char> {
+ private:
+  internal::SegmentedBuffer<Char> buffer_;
+
+  // The output is not contiguous.
+  const Char *data() const;
+  const Char *c_str() const;
+
+ public:
+  enum { DEFAULT_CHUNK_SIZE = 1 << 16 };
+
+  /**
+    Constructs a ``BasicSegmentedWriter`` object storing the output in
+    chunks of *chunk_size* characters.
+   */
+  explicit BasicSegmentedWriter(std::size_t chunk_size = DEFAULT_CHUNK_SIZE)
+    : BasicWriter<Char>(buffer_), buffer_(chunk_size) {}
+
+  /** Returns the total number of characters written to the output. */
+  std::size_t size() const { return buffer_.total_size(); }
+
+  /**
+    Returns the output as a list of contiguous segments in order. The
+    segments are valid until the writer is cleared or destroyed.
+   */
+  const std::vector< BasicStringRef<Char> > &segments() {
+    return buffer_.segments();
+  }
+
+  /** Returns the content of the output as an ``std::basic_string``. */
+  std::basic_string<Char> str() {
+    const std::vector< BasicStringRef<Char> > &segs = buffer_.segments();
+    std::basic_string<Char> result;
+    result.reserve(buffer_.total_size());
+    for (std::size_t i = 0, n = segs.size(); i < n; ++i)
+      result.append(segs[i].data(), segs[i].size());
+    return result;
+  }
+
+  /** Clears the output keeping the chunks for reuse. */
+  void clear() { buffer_.reset(); }
+
+  template <typename T>
+  BasicSegmentedWriter &operator<<(const T &value) {
+    buffer_.commit();
+    BasicWriter<Char>::operator<<(value);
+    return *this;
+  }
+
+  void write(BasicStringRef<Char> format, ArgList args) {
+    buffer_.commit();
+    BasicWriter<Char>::write(format, args);
+  }
+  FMT_VARIADIC_VOID(write, BasicStringRef<Char>)
+
+  void write(const BasicCompiledFormat<Char> &format, ArgList args) {
+    buffer_.commit();
+    BasicWriter<Char>::write(format, args);
+  }
+  FMT_VARIADIC_VOID(write, const BasicCompiledFormat<Char> &)
+};
+
+typedef BasicSegmentedWriter<char> SegmentedWriter;
+typedef BasicSegmentedWriter<wchar_t> WSegmentedWriter;
+
+/**
+  \rst
+  This class template provides operations for formatting and writing data
+  into a fixed-size array. For writing into a dynamically growing buffer
+  use :class:`fmt::BasicMemoryWriter`.
+  
+  Any write method will throw ``std::runtime_error`` if the output doesn't fit
+  into the array.
+
+  You can use one of the following typedefs for common character types:
+
+  +--------------+---------------------------+
+  | Type         | Definition                |
+  +==============+===========================+
+  | ArrayWriter  | BasicArrayWriter<char>    |
+  +--------------+---------------------------+
+  | WArrayWriter | BasicArrayWriter<wchar_t> |
+  +--------------+---------------------------+
+  \endrst
+ */
+template <typename Char>
+class BasicArrayWriter : public BasicWriter<Char> {
  private:
   internal::FixedBuffer<Char> buffer_;
 
@@ -2560,16 +3979,527 @@ class BasicArrayWriter : public BasicWriter<Char> {
 typedef BasicArrayWriter<char> ArrayWriter;
 typedef BasicArrayWriter<wchar_t> WArrayWriter;
 
+namespace internal {
+// A writer that appends to an existing buffer.
+template <typename Char>
+class BufferWriter : public BasicWriter<Char> {
+ public:
+  explicit BufferWriter(Buffer<Char> &buffer) : BasicWriter<Char>(buffer) {}
+};
+
+template <typename Char>
+inline void format_to(Buffer<Char> &buffer,
+                      BasicStringRef<Char> format_str, ArgList args) {
+  BufferWriter<Char>(buffer).write(format_str, args);
+}
+
+template <typename Char>
+inline std::size_t format_to_n(Char *out, std::size_t n,
+                               BasicStringRef<Char> format_str, ArgList args) {
+  TruncatingBuffer<Char> buffer(out, n);
+  format_to(buffer, format_str, args);
+  buffer.flush();
+  return buffer.size();
+}
+
+template <typename Char>
+inline FormatResult try_format(BasicWriter<Char> &w,
+                               BasicStringRef<Char> format_str, ArgList args) {
+  FormatErrorInfo error;
+  BasicFormatter<Char>(args, w).format(format_str, error);
+  FormatResult result = { error.message, w.size() };
+  return result;
+}
+
+template <typename Char>
+inline FormatResult try_format_to_n(
+    Char *out, std::size_t n, BasicStringRef<Char> format_str, ArgList args) {
+  TruncatingBuffer<Char> buffer(out, n);
+  BufferWriter<Char> w(buffer);
+  FormatResult result = try_format(w, format_str, args);
+  buffer.flush();
+  return result;
+}
+
+template <typename Char>
+inline std::basic_string<Char> format_to_string(
+    BasicStringRef<Char> format_str, ArgList args) {
+  StringBuffer<Char> buffer;
+  format_to(buffer, format_str, args);
+  return buffer.str();
+}
+}  // namespace internal
+
+/**
+  \rst
+  A format string together with copies of formatting arguments which can be
+  formatted later, possibly in a different thread. Strings and named
+  arguments are copied to the record's own storage which is reused by
+  subsequent captures, so capturing doesn't allocate memory once the
+  storage is large enough. Arguments of custom types are copied with their
+  copy constructors and are only supported if ``std::is_copy_constructible``
+  is available; capturing a custom argument that cannot be copied throws
+  `~fmt::FormatError`. Pointers are captured as addresses, so the data they
+  point to is not copied.
+
+  **Example**::
+
+    fmt::FormatRecord record;
+    record.capture("Elapsed time: {0:.2f} seconds", 1.23);
+    // Later, possibly in a different thread:
+    fmt::MemoryWriter w;
+    record.format(w);
+  \endrst
+ */
+template <typename Char>
+class BasicFormatRecord {
+ private:
+  char *data_;
+  std::size_t capacity_;
+  const Char *format_;
+  std::size_t format_size_;
+  ULongLong types_;
+  std::size_t num_args_;
+  internal::CustomArgCopy *custom_args_;
+  std::size_t num_custom_args_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(BasicFormatRecord);
+
+  void destroy_custom_args();
+
+ public:
+  /** Constructs an empty record. */
+  BasicFormatRecord()
+  : data_(0), capacity_(0), format_(0), format_size_(0), types_(0),
+    num_args_(0), custom_args_(0), num_custom_args_(0) {}
+
+  ~BasicFormatRecord() {
+    destroy_custom_args();
+    delete [] data_;
+  }
+
+#if FMT_USE_RVALUE_REFERENCES
+  BasicFormatRecord(BasicFormatRecord &&other)
+  : data_(0), capacity_(0), format_(0), format_size_(0), types_(0),
+    num_args_(0), custom_args_(0), num_custom_args_(0) {
+    swap(other);
+  }
+
+  BasicFormatRecord &operator=(BasicFormatRecord &&other) {
+    swap(other);
+    return *this;
+  }
+#endif
+
+  /** Exchanges the contents of this record with *other*. */
+  void swap(BasicFormatRecord &other) {
+    std::swap(data_, other.data_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(format_, other.format_);
+    std::swap(format_size_, other.format_size_);
+    std::swap(types_, other.types_);
+    std::swap(num_args_, other.num_args_);
+    std::swap(custom_args_, other.custom_args_);
+    std::swap(num_custom_args_, other.num_custom_args_);
+  }
+
+  /** Returns true if the record doesn't hold a format string. */
+  bool empty() const { return format_ == 0; }
+
+  /**
+    Copies the format string and arguments to the record replacing its
+    previous content.
+   */
+  void capture(BasicStringRef<Char> format_str, ArgList args);
+  FMT_VARIADIC_VOID(capture, BasicStringRef<Char>)
+
+  /** Returns the captured arguments. */
+  ArgList args() const {
+    const internal::Value *values =
+        reinterpret_cast<const internal::Value*>(data_);
+    if (num_args_ < ArgList::MAX_PACKED_ARGS)
+      return ArgList(types_, values);
+    return ArgList(values, static_cast<unsigned>(num_args_));
+  }
+
+  /** Formats the captured arguments and writes the output to *w*. */
+  void format(BasicWriter<Char> &w) const {
+    FMT_ASSERT(format_, "empty record");
+    BasicFormatter<Char>(args(), w).format(
+          BasicStringRef<Char>(format_, format_size_));
+  }
+
+  /** Formats the captured arguments and returns the result as a string. */
+  std::basic_string<Char> str() const {
+    internal::StringBuffer<Char> buffer;
+    internal::BufferWriter<Char> w(buffer);
+    format(w);
+    return buffer.str();
+  }
+};
+
+typedef BasicFormatRecord<char> FormatRecord;
+typedef BasicFormatRecord<wchar_t> WFormatRecord;
+
+namespace internal {
+// A stream buffer that writes to a Buffer object. The unused capacity of
+// the buffer is used as the put area so that no intermediate string is
+// created. The output is added to the buffer when the stream buffer is
+// synchronized or destroyed.
+template <typename Char>
+class FormatBuf : public std::basic_streambuf<Char> {
+ private:
+  typedef typename std::basic_streambuf<Char>::int_type int_type;
+  typedef typename std::basic_streambuf<Char>::traits_type traits_type;
+
+  Buffer<Char> &buffer_;
+
+  void set_put_area() {
+    std::size_t size = buffer_.size();
+    if (buffer_.capacity() == size) {
+      this->setp(0, 0);
+      return;
+    }
+    Char *data = &buffer_[0];
+    this->setp(data + size, data + buffer_.capacity());
+  }
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(FormatBuf);
+
+ protected:
+  int_type overflow(int_type ch) {
+    sync();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+      buffer_.push_back(traits_type::to_char_type(ch));
+    set_put_area();
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const Char *s, std::streamsize count) {
+    sync();
+    buffer_.append(s, s + count);
+    set_put_area();
+    return count;
+  }
+
+  int sync() {
+    if (Char *end = this->pptr()) {
+      buffer_.resize(buffer_.size() + (end - this->pbase()));
+      this->setp(end, this->epptr());
+    }
+    return 0;
+  }
+
+ public:
+  explicit FormatBuf(Buffer<Char> &buffer) : buffer_(buffer) {
+    set_put_area();
+  }
+
+  ~FormatBuf() { sync(); }
+};
+
+// Applies the precision, fill, alignment and width of spec to the output
+// written to buffer starting from the position start.
+template <typename Char>
+void align_output(Buffer<Char> &buffer, std::size_t start,
+                  const FormatSpec &spec);
+}  // namespace internal
+
+/**
+  \rst
+  Formats values of type *T* that are passed as formatting arguments.
+  Specialize it to write values of a user-defined type directly to the
+  writer without going through ``std::ostream``. The precision, fill,
+  alignment and width from the format specification are applied to the
+  output in the same way as to strings.
+
+  **Example**::
+
+    class Price { ... };
+
+    namespace fmt {
+    template <>
+    struct Formatter<Price> {
+      template <typename Char>
+      static void format(BasicWriter<Char> &w, const Price &p) {
+        w << p.cents() / 100 << '.' << pad(p.cents() % 100, 2, '0');
+      }
+    };
+    }
+
+    std::string s = fmt::format("{:>8}", Price(123456));
+    // s == " 1234.56"
+
+  The default implementation writes the value with ``operator<<`` to
+  an ``std::basic_ostream`` whose stream buffer appends to the writer's
+  buffer.
+  \endrst
+ */
+template <typename T>
+struct Formatter {
+  template <typename Char>
+  static void format(BasicWriter<Char> &w, const T &value) {
+    FMT_ADD_STAT(OSTREAM_FALLBACKS, 1);
+    internal::FormatBuf<Char> buf(w.buffer());
+    std::basic_ostream<Char> os(&buf);
+    // Rethrow errors such as buffer overflow instead of setting badbit.
+    os.exceptions(std::ios_base::badbit);
+    os << value;
+  }
+};
+
 // Formats a value.
 template <typename Char, typename T>
 void format(BasicFormatter<Char> &f, const Char *&format_str, const T &value) {
-  std::basic_ostringstream<Char> os;
-  os << value;
-  std::basic_string<Char> str = os.str();
-  internal::Arg arg = internal::MakeValue<Char>(str);
-  arg.type = static_cast<internal::Arg::Type>(
-        internal::MakeValue<Char>::type(str));
-  format_str = f.format(format_str, arg);
+  internal::Arg arg;
+  arg.type = internal::Arg::STRING;
+  FormatSpec spec;
+  format_str = f.parse_spec(format_str, arg, spec);
+  if (spec.type_ && spec.type_ != 's')
+    internal::report_unknown_type(spec.type_, "string");
+  Buffer<Char> &buffer = f.writer().buffer();
+  std::size_t start = buffer.size();
+  Formatter<T>::format(f.writer(), value);
+  if (spec.width_ != 0 || spec.precision_ >= 0)
+    internal::align_output(buffer, start, spec);
+}
+
+namespace internal {
+// Writes time formatted according to the strftime-like format string
+// format to buffer. If subsec_digits is nonzero, seconds are followed by
+// a decimal point and subsec_digits digits of subsec. If seconds_offsets
+// is not null, the positions of seconds in buffer are added to it.
+template <typename Char>
+void format_time(Buffer<Char> &buffer, BasicStringRef<Char> format,
+                 const std::tm &time, ULongLong subsec, int subsec_digits,
+                 std::vector<std::size_t> *seconds_offsets);
+
+// Converts time in seconds since the epoch to UTC.
+std::tm utc_time(LongLong seconds);
+
+// Returns the time format in a replacement field and advances format_str
+// past the closing brace. format_str should point to ':' or '}'.
+template <typename Char>
+BasicStringRef<Char> parse_time_format(const Char *&format_str);
+
+#if FMT_USE_CHRONO
+// Time since the epoch split into whole seconds and a decimal fraction
+// with as many digits as are needed to represent Duration, up to 9.
+struct SplitTime {
+  LongLong seconds;
+  ULongLong subsec;
+  int subsec_digits;
+
+  template <typename Duration>
+  explicit SplitTime(const std::chrono::time_point<
+                       std::chrono::system_clock, Duration> &time) {
+    typedef typename Duration::period Period;
+    Duration d = time.time_since_epoch();
+    std::chrono::seconds secs =
+        std::chrono::duration_cast<std::chrono::seconds>(d);
+    if (secs > d)
+      secs -= std::chrono::seconds(1);
+    seconds = secs.count();
+    subsec = 0;
+    subsec_digits = 0;
+    if (Period::den == 1 || Period::num >= Period::den)
+      return;
+    ULongLong scale = 1;
+    while (scale < static_cast<ULongLong>(Period::den) && subsec_digits < 9) {
+      scale *= 10;
+      ++subsec_digits;
+    }
+    ULongLong nanos = static_cast<ULongLong>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d - secs)
+          .count());
+    subsec = nanos / (1000000000 / scale);
+  }
+};
+#endif
+}  // namespace internal
+
+/**
+  \rst
+  Formats ``std::tm`` according to the format specification which uses the
+  conversion specifiers of ``strftime``, for example::
+
+    std::tm tm = ...;
+    std::string s = fmt::format("{:%Y-%m-%d %H:%M:%S}", tm);
+
+  The output doesn't depend on the locale. The names of weekdays and months
+  and the AM/PM designations are those of the C locale. An empty
+  specification is the same as ``%Y-%m-%d %H:%M:%S``.
+  \endrst
+ */
+template <typename Char>
+void format(BasicFormatter<Char> &f, const Char *&format_str,
+            const std::tm &time) {
+  internal::format_time(f.writer().buffer(),
+                        internal::parse_time_format(format_str), time, 0, 0,
+                        static_cast<std::vector<std::size_t>*>(0));
+}
+
+#if FMT_USE_CHRONO
+/**
+  \rst
+  Formats a ``std::chrono::system_clock`` time point in UTC. The format
+  specification is the same as for ``std::tm`` except that ``%S`` includes
+  the fractional part of seconds if the time point is more precise than
+  seconds::
+
+    using namespace std::chrono;
+    auto t = time_point_cast<milliseconds>(system_clock::now());
+    std::string s = fmt::format("{:%H:%M:%S}", t);
+    // s == "14:02:07.351"
+  \endrst
+ */
+template <typename Char, typename Duration>
+void format(BasicFormatter<Char> &f, const Char *&format_str,
+            const std::chrono::time_point<
+              std::chrono::system_clock, Duration> &time) {
+  internal::SplitTime t(time);
+  internal::format_time(f.writer().buffer(),
+                        internal::parse_time_format(format_str),
+                        internal::utc_time(t.seconds), t.subsec,
+                        t.subsec_digits,
+                        static_cast<std::vector<std::size_t>*>(0));
+}
+#endif
+
+/**
+  \rst
+  A time format that caches its last output. When consecutive timestamps
+  fall into the same minute, only seconds and their fractional part are
+  written over the cached text instead of formatting the whole timestamp.
+  Times are in UTC. The format specification is the same as for
+  ``std::tm``.
+
+  A cache isn't safe to use from several threads at once, so keep one per
+  thread, for example, in a ``thread_local`` variable.
+
+  **Example**::
+
+    thread_local fmt::TimeFormat time_format("%Y-%m-%d %H:%M:%S");
+    fmt::MemoryWriter w;
+    time_format.format(w, std::chrono::system_clock::now());
+  \endrst
+ */
+template <typename Char>
+class BasicTimeFormat {
+ private:
+  std::basic_string<Char> format_;
+  internal::MemoryBuffer<Char, 64> cache_;
+  std::vector<std::size_t> seconds_offsets_;
+
+  // The minute since the epoch and the number of fractional digits of
+  // the cached output.
+  LongLong minute_;
+  int subsec_digits_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(BasicTimeFormat);
+
+ public:
+  /**
+    Constructs a time format. Throws :class:`fmt::FormatError` if the
+    format string is invalid.
+   */
+  explicit BasicTimeFormat(BasicStringRef<Char> format);
+
+  /**
+    Writes the time *seconds* since the epoch to the writer *w*. If
+    *subsec_digits* is nonzero, seconds are followed by a decimal point and
+    *subsec_digits* digits of *subsec*.
+   */
+  void format(BasicWriter<Char> &w, LongLong seconds,
+              ULongLong subsec = 0, int subsec_digits = 0);
+
+#if FMT_USE_CHRONO
+  /** Writes a ``std::chrono::system_clock`` time point to the writer *w*. */
+  template <typename Duration>
+  void format(BasicWriter<Char> &w, const std::chrono::time_point<
+                std::chrono::system_clock, Duration> &time) {
+    internal::SplitTime t(time);
+    format(w, t.seconds, t.subsec, t.subsec_digits);
+  }
+#endif
+};
+
+typedef BasicTimeFormat<char> TimeFormat;
+typedef BasicTimeFormat<wchar_t> WTimeFormat;
+
+/**
+  \rst
+  A range of elements and a separator, returned by `fmt::join`.
+  \endrst
+ */
+template <typename It, typename Char>
+struct ArgJoin {
+  It first;
+  It last;
+  BasicStringRef<Char> sep;
+
+  ArgJoin(It f, It l, BasicStringRef<Char> s) : first(f), last(l), sep(s) {}
+};
+
+/**
+  \rst
+  Returns an object that formats the elements of the range [*first*,
+  *last*) separated by *sep* when passed as a formatting argument. The
+  format specification of the replacement field is parsed once and applied
+  to each element.
+
+  **Example**::
+
+    std::vector<int> v;
+    v.push_back(1);
+    v.push_back(2);
+    std::string s = fmt::format("{:02}", fmt::join(v.begin(), v.end(), ", "));
+    // s == "01, 02"
+  \endrst
+ */
+template <typename It>
+inline ArgJoin<It, char> join(It first, It last, StringRef sep) {
+  return ArgJoin<It, char>(first, last, sep);
+}
+
+template <typename It>
+inline ArgJoin<It, wchar_t> join(It first, It last, WStringRef sep) {
+  return ArgJoin<It, wchar_t>(first, last, sep);
+}
+
+// Formats a range of elements.
+template <typename Char, typename It>
+void format(BasicFormatter<Char> &f, const Char *&format_str,
+            const ArgJoin<It, Char> &range) {
+  typedef internal::MakeValue<Char> MakeValue;
+  internal::Arg arg;
+  It it = range.first;
+  if (it == range.last) {
+    // Check the specification as for a number to accept all numeric flags.
+    arg.type = internal::Arg::DOUBLE;
+    FormatSpec spec;
+    format_str = f.parse_spec(format_str, arg, spec);
+    return;
+  }
+  arg = MakeValue(*it);
+  arg.type = static_cast<internal::Arg::Type>(MakeValue::type(*it));
+  if (arg.type != internal::Arg::CUSTOM) {
+    FormatSpec spec;
+    format_str = f.parse_spec(format_str, arg, spec);
+    f.writer().write_range(it, range.last, spec, range.sep);
+    return;
+  }
+  // Elements of user-defined types parse the specification themselves.
+  const Char *s = format_str;
+  const Char *end = f.format(s, arg);
+  for (++it; it != range.last; ++it) {
+    f.writer() << range.sep;
+    arg = MakeValue(*it);
+    arg.type = internal::Arg::CUSTOM;
+    s = format_str;
+    f.format(s, arg);
+  }
+  format_str = end;
 }
 
 // Reports a system error without throwing an exception.
@@ -2632,7 +4562,7 @@ enum Color { BLACK, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE };
   Example:
     PrintColored(fmt::RED, "Elapsed time: {0:.2f} seconds") << 1.23;
  */
-void print_colored(Color c, CStringRef format, ArgList args);
+void print_colored(Color c, StringRef format, ArgList args);
 
 /**
   \rst
@@ -2643,18 +4573,260 @@ void print_colored(Color c, CStringRef format, ArgList args);
     std::string message = format("The answer is {}", 42);
   \endrst
 */
-inline std::string format(CStringRef format_str, ArgList args) {
-  MemoryWriter w;
-  w.write(format_str, args);
-  return w.str();
+inline std::string format(StringRef format_str, ArgList args) {
+  return internal::format_to_string(format_str, args);
 }
 
-inline std::wstring format(WCStringRef format_str, ArgList args) {
-  WMemoryWriter w;
-  w.write(format_str, args);
-  return w.str();
+inline std::wstring format(WStringRef format_str, ArgList args) {
+  return internal::format_to_string(format_str, args);
+}
+
+/**
+  \rst
+  Formats arguments according to a compiled format string and returns the
+  result as a string.
+
+  **Example**::
+
+    static const fmt::CompiledFormat answer("The answer is {}");
+    std::string message = format(answer, 42);
+  \endrst
+*/
+inline std::string format(const CompiledFormat &format_str, ArgList args) {
+  internal::StringBuffer<char> buffer;
+  internal::BufferWriter<char> w(buffer);
+  format_str.format(w, args);
+  return buffer.str();
+}
+
+inline std::wstring format(const WCompiledFormat &format_str, ArgList args) {
+  internal::StringBuffer<wchar_t> buffer;
+  internal::BufferWriter<wchar_t> w(buffer);
+  format_str.format(w, args);
+  return buffer.str();
+}
+
+/**
+  \rst
+  Formats arguments and appends the output to the buffer *buf*. The buffer
+  is only reallocated if the output doesn't fit into its capacity.
+
+  **Example**::
+
+    fmt::internal::MemoryBuffer<char, 100> buf;
+    fmt::format_to(buf, "The answer is {}", 42);
+  \endrst
+ */
+inline void format_to(Buffer<char> &buf, StringRef format_str, ArgList args) {
+  internal::format_to(buf, format_str, args);
+}
+
+inline void format_to(
+    Buffer<wchar_t> &buf, WStringRef format_str, ArgList args) {
+  internal::format_to(buf, format_str, args);
 }
 
+/**
+  \rst
+  Formats arguments and appends the output to the string *s*. The existing
+  capacity of the string is reused, so formatting into a string that is
+  cleared and reused doesn't allocate memory once the string is large enough.
+
+  **Example**::
+
+    std::string s = "The answer is ";
+    fmt::format_to(s, "{}", 42);
+    // s == "The answer is 42"
+  \endrst
+ */
+inline void format_to(std::string &s, StringRef format_str, ArgList args) {
+  internal::ContainerBuffer<std::string> buf(s);
+  internal::format_to(buf, format_str, args);
+}
+
+inline void format_to(std::wstring &s, WStringRef format_str, ArgList args) {
+  internal::ContainerBuffer<std::wstring> buf(s);
+  internal::format_to(buf, format_str, args);
+}
+
+/**
+  Formats arguments and appends the output to the vector *v* reusing its
+  capacity.
+ */
+inline void format_to(
+    std::vector<char> &v, StringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::vector<char> > buf(v);
+  internal::format_to(buf, format_str, args);
+}
+
+inline void format_to(
+    std::vector<wchar_t> &v, WStringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::vector<wchar_t> > buf(v);
+  internal::format_to(buf, format_str, args);
+}
+
+/**
+  \rst
+  Formats arguments and appends the output to the string *s* that uses
+  a custom allocator. The string memory, if any needs to be allocated, comes
+  from the string's allocator and no intermediate buffer is used.
+
+  **Example**::
+
+    typedef std::basic_string<
+      char, std::char_traits<char>, ArenaAllocator<char> > ArenaString;
+    ArenaString s(ArenaAllocator<char>(arena));
+    fmt::format_to(s, "{}", 42);
+  \endrst
+ */
+template <typename Traits, typename Allocator>
+inline void format_to(std::basic_string<char, Traits, Allocator> &s,
+                      StringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::basic_string<char, Traits, Allocator> >
+      buf(s);
+  internal::format_to(buf, format_str, args);
+}
+
+template <typename Traits, typename Allocator>
+inline void format_to(std::basic_string<wchar_t, Traits, Allocator> &s,
+                      WStringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::basic_string<wchar_t, Traits, Allocator> >
+      buf(s);
+  internal::format_to(buf, format_str, args);
+}
+
+/**
+  Formats arguments and appends the output to the vector *v* that uses
+  a custom allocator.
+ */
+template <typename Allocator>
+inline void format_to(std::vector<char, Allocator> &v,
+                      StringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::vector<char, Allocator> > buf(v);
+  internal::format_to(buf, format_str, args);
+}
+
+template <typename Allocator>
+inline void format_to(std::vector<wchar_t, Allocator> &v,
+                      WStringRef format_str, ArgList args) {
+  internal::ContainerBuffer< std::vector<wchar_t, Allocator> > buf(v);
+  internal::format_to(buf, format_str, args);
+}
+
+#if FMT_USE_VARIADIC_TEMPLATES
+template <typename Traits, typename Allocator, typename... Args>
+inline void format_to(std::basic_string<char, Traits, Allocator> &s,
+                      StringRef format_str, const Args & ... args) {
+  typename internal::ArgArray<sizeof...(Args)>::Type array;
+  format_to(s, format_str, internal::make_arg_list<char>(array, args...));
+}
+
+template <typename Traits, typename Allocator, typename... Args>
+inline void format_to(std::basic_string<wchar_t, Traits, Allocator> &s,
+                      WStringRef format_str, const Args & ... args) {
+  typename internal::ArgArray<sizeof...(Args)>::Type array;
+  format_to(s, format_str, internal::make_arg_list<wchar_t>(array, args...));
+}
+
+template <typename Allocator, typename... Args>
+inline void format_to(std::vector<char, Allocator> &v,
+                      StringRef format_str, const Args & ... args) {
+  typename internal::ArgArray<sizeof...(Args)>::Type array;
+  format_to(v, format_str, internal::make_arg_list<char>(array, args...));
+}
+
+template <typename Allocator, typename... Args>
+inline void format_to(std::vector<wchar_t, Allocator> &v,
+                      WStringRef format_str, const Args & ... args) {
+  typename internal::ArgArray<sizeof...(Args)>::Type array;
+  format_to(v, format_str, internal::make_arg_list<wchar_t>(array, args...));
+}
+#endif
+
+/**
+  \rst
+  Formats arguments and writes at most *n* characters of the output to the
+  array *out*. No terminating null character is written. Returns the size
+  of the complete output which may be greater than *n* if the output has
+  been truncated.
+
+  **Example**::
+
+    char buf[10];
+    std::size_t size = fmt::format_to_n(buf, sizeof(buf), "{}", 42);
+    // buf starts with "42" and size == 2
+  \endrst
+ */
+inline std::size_t format_to_n(
+    char *out, std::size_t n, StringRef format_str, ArgList args) {
+  return internal::format_to_n(out, n, format_str, args);
+}
+
+inline std::size_t format_to_n(
+    wchar_t *out, std::size_t n, WStringRef format_str, ArgList args) {
+  return internal::format_to_n(out, n, format_str, args);
+}
+
+/**
+  \rst
+  Formats arguments and writes the output to *w* reporting errors in the
+  format string and its use with the argument types via the returned
+  `~fmt::FormatResult` instead of throwing `~fmt::FormatError`.
+  Formatting errors are detected without exceptions being thrown, so this
+  function can be used where exceptions are not acceptable including
+  builds with exceptions disabled. Memory allocation failures, output
+  overflow of fixed-size writers and exceptions thrown when formatting
+  user-defined types are still propagated.
+
+  **Example**::
+
+    fmt::MemoryWriter out;
+    fmt::FormatResult result = fmt::try_format(out, "{:d}", "abc");
+    // result.error == "unknown format code for string"
+  \endrst
+ */
+inline FormatResult try_format(Writer &w, StringRef format_str, ArgList args) {
+  return internal::try_format(w, format_str, args);
+}
+
+inline FormatResult try_format(
+    WWriter &w, WStringRef format_str, ArgList args) {
+  return internal::try_format(w, format_str, args);
+}
+
+/**
+  \rst
+  Formats arguments and writes at most *n* characters of the output to the
+  array *out* like :func:`fmt::format_to_n` reporting errors via the
+  returned `~fmt::FormatResult` like :func:`fmt::try_format`. The size in
+  the result is the size of the complete output.
+  \endrst
+ */
+inline FormatResult try_format_to_n(
+    char *out, std::size_t n, StringRef format_str, ArgList args) {
+  return internal::try_format_to_n(out, n, format_str, args);
+}
+
+inline FormatResult try_format_to_n(
+    wchar_t *out, std::size_t n, WStringRef format_str, ArgList args) {
+  return internal::try_format_to_n(out, n, format_str, args);
+}
+
+/**
+  \rst
+  Returns the number of characters in the output of
+  ``format(format_str, args)`` without producing the output. It can be used
+  to allocate a buffer of the exact size before formatting into it.
+
+  **Example**::
+
+    std::size_t size = fmt::formatted_size("{:>10}", 42);
+    // size == 10
+  \endrst
+ */
+std::size_t formatted_size(StringRef format_str, ArgList args);
+std::size_t formatted_size(WStringRef format_str, ArgList args);
+
 /**
   \rst
   Prints formatted data to the file *f*.
@@ -2664,35 +4836,67 @@ inline std::wstring format(WCStringRef format_str, ArgList args) {
     print(stderr, "Don't {}!", "panic");
   \endrst
  */
-void print(std::FILE *f, CStringRef format_str, ArgList args);
+void print(std::FILE *f, StringRef format_str, ArgList args);
+
+/**
+  \rst
+  Prints formatted data to ``stdout``.
+
+  **Example**::
+
+    print("Elapsed time: {0:.2f} seconds", 1.23);
+  \endrst
+ */
+void print(StringRef format_str, ArgList args);
+
+/**
+  Prints data formatted according to a compiled format string to the file *f*.
+ */
+void print(std::FILE *f, const CompiledFormat &format_str, ArgList args);
+
+/**
+  Prints data formatted according to a compiled format string to ``stdout``.
+ */
+void print(const CompiledFormat &format_str, ArgList args);
 
 /**
   \rst
-  Prints formatted data to ``stdout``.
+  Prints formatted data to the stream *os*.
 
   **Example**::
 
-    print("Elapsed time: {0:.2f} seconds", 1.23);
+    print(cerr, "Don't {}!", "panic");
   \endrst
  */
-void print(CStringRef format_str, ArgList args);
+void print(std::ostream &os, StringRef format_str, ArgList args);
 
 /**
   \rst
-  Prints formatted data to the stream *os*.
-
-  **Example**::
-
-    print(cerr, "Don't {}!", "panic");
+  Sets the maximum capacity, in characters, of the per-thread buffer that
+  `fmt::print` and `fmt::fprintf` reuse between calls to avoid allocating
+  memory for long output every time. If formatting grows the buffer beyond
+  *limit*, the memory is released once the call completes. The default
+  limit is ``FMT_BUFFER_CACHE_LIMIT`` (64 KiB unless defined otherwise when
+  compiling the library). The limit is shared by all threads.
+
+  The buffers are only used if the library is compiled with ``thread_local``
+  support and ``FMT_USE_BUFFER_CACHE`` is not defined to 0; otherwise this
+  function has no effect.
   \endrst
  */
-void print(std::ostream &os, CStringRef format_str, ArgList args);
+void set_buffer_cache_limit(std::size_t limit);
 
 template <typename Char>
-void printf(BasicWriter<Char> &w, BasicCStringRef<Char> format, ArgList args) {
+void printf(BasicWriter<Char> &w, BasicStringRef<Char> format, ArgList args) {
   internal::PrintfFormatter<Char>(args).format(w, format);
 }
 
+template <typename Char>
+void printf(BasicWriter<Char> &w, const BasicCompiledPrintfFormat<Char> &format,
+            ArgList args) {
+  format.format(w, args);
+}
+
 /**
   \rst
   Formats arguments and returns the result as a string.
@@ -2702,10 +4906,22 @@ void printf(BasicWriter<Char> &w, BasicCStringRef<Char> format, ArgList args) {
     std::string message = fmt::sprintf("The answer is %d", 42);
   \endrst
 */
-inline std::string sprintf(CStringRef format, ArgList args) {
-  MemoryWriter w;
+inline std::string sprintf(StringRef format, ArgList args) {
+  internal::StringBuffer<char> buffer;
+  internal::BufferWriter<char> w(buffer);
   printf(w, format, args);
-  return w.str();
+  return buffer.str();
+}
+
+/**
+  Formats arguments according to a compiled printf format string and returns
+  the result as a string.
+ */
+inline std::string sprintf(const CompiledPrintfFormat &format, ArgList args) {
+  internal::StringBuffer<char> buffer;
+  internal::BufferWriter<char> w(buffer);
+  format.format(w, args);
+  return buffer.str();
 }
 
 /**
@@ -2717,7 +4933,7 @@ inline std::string sprintf(CStringRef format, ArgList args) {
     fmt::fprintf(stderr, "Don't %s!", "panic");
   \endrst
  */
-int fprintf(std::FILE *f, CStringRef format, ArgList args);
+int fprintf(std::FILE *f, StringRef format, ArgList args);
 
 /**
   \rst
@@ -2728,7 +4944,21 @@ int fprintf(std::FILE *f, CStringRef format, ArgList args);
     fmt::printf("Elapsed time: %.2f seconds", 1.23);
   \endrst
  */
-inline int printf(CStringRef format, ArgList args) {
+inline int printf(StringRef format, ArgList args) {
+  return fprintf(stdout, format, args);
+}
+
+/**
+  Prints data formatted according to a compiled printf format string to the
+  file *f*.
+ */
+int fprintf(std::FILE *f, const CompiledPrintfFormat &format, ArgList args);
+
+/**
+  Prints data formatted according to a compiled printf format string to
+  ``stdout``.
+ */
+inline int printf(const CompiledPrintfFormat &format, ArgList args) {
   return fprintf(stdout, format, args);
 }
 
@@ -2746,20 +4976,27 @@ class FormatInt {
   // Formats value in reverse and returns the number of digits.
   char *format_decimal(ULongLong value) {
     char *buffer_end = buffer_ + BUFFER_SIZE - 1;
-    while (value >= 100) {
+    while (value >= 100000000) {
+      buffer_end -= 8;
+      internal::format_decimal8(
+            buffer_end, static_cast<uint32_t>(value % 100000000));
+      value /= 100000000;
+    }
+    uint32_t n = static_cast<uint32_t>(value);
+    while (n >= 100) {
       // Integer division is slow so do it for a group of two digits instead
       // of for every digit. The idea comes from the talk by Alexandrescu
       // "Three Optimization Tips for C++". See speed-test for a comparison.
-      unsigned index = (value % 100) * 2;
-      value /= 100;
+      unsigned index = (n % 100) * 2;
+      n /= 100;
       *--buffer_end = internal::Data::DIGITS[index + 1];
       *--buffer_end = internal::Data::DIGITS[index];
     }
-    if (value < 10) {
-      *--buffer_end = static_cast<char>('0' + value);
+    if (n < 10) {
+      *--buffer_end = static_cast<char>('0' + n);
       return buffer_end;
     }
-    unsigned index = static_cast<unsigned>(value * 2);
+    unsigned index = n * 2;
     *--buffer_end = internal::Data::DIGITS[index + 1];
     *--buffer_end = internal::Data::DIGITS[index];
     return buffer_end;
@@ -2989,16 +5226,770 @@ void arg(WStringRef, const internal::NamedArg<Char>&) FMT_DELETED_OR_UNDEFINED;
 #define FMT_CAPTURE_W(...) FMT_FOR_EACH(FMT_CAPTURE_ARG_W_, __VA_ARGS__)
 
 namespace fmt {
-FMT_VARIADIC(std::string, format, CStringRef)
-FMT_VARIADIC_W(std::wstring, format, WCStringRef)
-FMT_VARIADIC(void, print, CStringRef)
-FMT_VARIADIC(void, print, std::FILE *, CStringRef)
-FMT_VARIADIC(void, print, std::ostream &, CStringRef)
-FMT_VARIADIC(void, print_colored, Color, CStringRef)
-FMT_VARIADIC(std::string, sprintf, CStringRef)
-FMT_VARIADIC(int, printf, CStringRef)
-FMT_VARIADIC(int, fprintf, std::FILE *, CStringRef)
+FMT_VARIADIC(std::string, format, StringRef)
+FMT_VARIADIC_W(std::wstring, format, WStringRef)
+FMT_VARIADIC(void, print, StringRef)
+FMT_VARIADIC(void, print, std::FILE *, StringRef)
+FMT_VARIADIC(void, print, std::ostream &, StringRef)
+FMT_VARIADIC(void, print_colored, Color, StringRef)
+FMT_VARIADIC(std::string, sprintf, StringRef)
+FMT_VARIADIC(int, printf, StringRef)
+FMT_VARIADIC(int, fprintf, std::FILE *, StringRef)
+FMT_VARIADIC(std::string, format, const CompiledFormat &)
+FMT_VARIADIC_W(std::wstring, format, const WCompiledFormat &)
+FMT_VARIADIC(void, format_to, Buffer<char> &, StringRef)
+FMT_VARIADIC_W(void, format_to, Buffer<wchar_t> &, WStringRef)
+FMT_VARIADIC(void, format_to, std::string &, StringRef)
+FMT_VARIADIC_W(void, format_to, std::wstring &, WStringRef)
+FMT_VARIADIC(void, format_to, std::vector<char> &, StringRef)
+FMT_VARIADIC_W(void, format_to, std::vector<wchar_t> &, WStringRef)
+FMT_VARIADIC(std::size_t, format_to_n, char *, std::size_t, StringRef)
+FMT_VARIADIC_W(std::size_t, format_to_n, wchar_t *, std::size_t, WStringRef)
+FMT_VARIADIC(FormatResult, try_format, Writer &, StringRef)
+FMT_VARIADIC_W(FormatResult, try_format, WWriter &, WStringRef)
+FMT_VARIADIC(FormatResult, try_format_to_n, char *, std::size_t, StringRef)
+FMT_VARIADIC_W(FormatResult, try_format_to_n, wchar_t *, std::size_t,
+               WStringRef)
+FMT_VARIADIC(std::size_t, formatted_size, StringRef)
+FMT_VARIADIC_W(std::size_t, formatted_size, WStringRef)
+FMT_VARIADIC(void, print, const CompiledFormat &)
+FMT_VARIADIC(void, print, std::FILE *, const CompiledFormat &)
+FMT_VARIADIC(std::string, sprintf, const CompiledPrintfFormat &)
+FMT_VARIADIC(int, printf, const CompiledPrintfFormat &)
+FMT_VARIADIC(int, fprintf, std::FILE *, const CompiledPrintfFormat &)
+}
+
+#if FMT_USE_CONSTEXPR && FMT_USE_VARIADIC_TEMPLATES
+namespace fmt {
+namespace internal {
+
+// The base class of format string types created with FMT_STRING.
+struct CompileString {};
+
+template <typename Char>
+Char get_char_type(const Char *);
+
+// Reports an error in a format string checked at compile time. This function
+// is intentionally not constexpr, so calling it during constant evaluation
+// fails compilation and the diagnostic points to the call with the message.
+inline void on_format_string_error(const char *message) {
+  (void)message;
+  FMT_ASSERT(false, message);
+}
+
+// Gets the type of an argument without constructing it. Uses the same
+// overload resolution as MakeValue::type.
+template <typename Char, typename T>
+struct StaticArgType {
+  enum {
+    value = decltype(
+      MakeValue<Char>::type_tag(std::declval<const T &>()))::value
+  };
+};
+
+template <typename Char, typename... Args>
+struct StaticArgTypes {
+  // The extra element makes the array non-empty if there are no arguments.
+  Arg::Type types[sizeof...(Args) + 1];
+
+  constexpr StaticArgTypes()
+  : types{static_cast<Arg::Type>(StaticArgType<Char, Args>::value)...,
+          Arg::NONE} {}
+};
+
+// A format string parsed at compile time.
+template <std::size_t N>
+struct StaticFormat {
+  StaticFormatItem items[N];
+  std::size_t size;
+
+  constexpr StaticFormat() : items(), size(0) {}
+};
+
+// Returns the upper bound on the number of items in a format string.
+// Each item other than the last one ends with at least one brace.
+template <typename Char>
+constexpr std::size_t count_static_items(const Char *s) {
+  std::size_t count = 1;
+  for (; *s; ++s) {
+    if (*s == '{' || *s == '}')
+      ++count;
+  }
+  return count;
+}
+
+template <typename Char>
+constexpr unsigned parse_static_int(const Char *&s) {
+  const unsigned max_int =
+      static_cast<unsigned>(std::numeric_limits<int>::max());
+  unsigned value = 0;
+  do {
+    unsigned digit = static_cast<unsigned>(*s++ - '0');
+    if (value > (max_int - digit) / 10)
+      on_format_string_error("number is too big");
+    value = value * 10 + digit;
+  } while ('0' <= *s && *s <= '9');
+  return value;
+}
+
+template <typename Char>
+constexpr int parse_static_arg_index(
+    const Char *&s, int &next_index, int num_args) {
+  if (('a' <= *s && *s <= 'z') || ('A' <= *s && *s <= 'Z') || '_' == *s) {
+    on_format_string_error(
+        "named arguments are not supported in compile-time format strings");
+  }
+  int index = 0;
+  if ('0' <= *s && *s <= '9') {
+    if (next_index > 0) {
+      on_format_string_error(
+          "cannot switch from automatic to manual argument indexing");
+    }
+    next_index = -1;
+    index = static_cast<int>(parse_static_int(s));
+  } else {
+    if (next_index < 0) {
+      on_format_string_error(
+          "cannot switch from manual to automatic argument indexing");
+    }
+    index = next_index++;
+  }
+  if (index >= num_args)
+    on_format_string_error("argument index out of range");
+  return index;
+}
+
+// Parses a dynamic width or precision {...} and returns the argument index.
+template <typename Char>
+constexpr int parse_static_dynamic_spec(
+    const Char *&s, int &next_index, const Arg::Type *types, int num_args,
+    bool is_width) {
+  ++s;
+  int index = parse_static_arg_index(s, next_index, num_args);
+  if (*s++ != '}')
+    on_format_string_error("invalid format string");
+  Arg::Type type = types[index];
+  if (type < Arg::INT || type > Arg::ULONG_LONG) {
+    if (is_width)
+      on_format_string_error("width is not integer");
+    else
+      on_format_string_error("precision is not integer");
+  }
+  return index;
+}
+
+constexpr bool is_static_type_in(char type, const char *types) {
+  for (; *types; ++types) {
+    if (*types == type)
+      return true;
+  }
+  return !type;
+}
+
+// Checks that the presentation type is valid for the argument type.
+constexpr void check_static_type(
+    const StaticFormatItem &item, Arg::Type arg_type) {
+  switch (arg_type) {
+  case Arg::CHAR:
+    if (!item.type || item.type == 'c') {
+      if (item.align == ALIGN_NUMERIC || item.flags != 0)
+        on_format_string_error("invalid format specifier for char");
+      break;
+    }
+    if (!is_static_type_in(item.type, "dxXbBo"))
+      on_format_string_error("unknown format code for char");
+    break;
+  case Arg::INT: case Arg::UINT: case Arg::LONG_LONG: case Arg::ULONG_LONG:
+  case Arg::BOOL:
+    if (!is_static_type_in(item.type, "dxXbBo"))
+      on_format_string_error("unknown format code for integer");
+    break;
+  case Arg::DOUBLE: case Arg::LONG_DOUBLE:
+    if (!is_static_type_in(item.type, "eEfFgGaA"))
+      on_format_string_error("unknown format code for floating-point number");
+    break;
+  case Arg::CSTRING: case Arg::STRING: case Arg::WSTRING:
+    if (!is_static_type_in(item.type, "s"))
+      on_format_string_error("unknown format code for string");
+    break;
+  case Arg::POINTER:
+    if (!is_static_type_in(item.type, "p"))
+      on_format_string_error("unknown format code for pointer");
+    break;
+  default:
+    break;
+  }
+}
+
+constexpr void check_static_sign(Arg::Type arg_type) {
+  if (arg_type > Arg::LAST_NUMERIC_TYPE)
+    on_format_string_error("format specifier sign requires numeric argument");
+  if (arg_type == Arg::UINT || arg_type == Arg::ULONG_LONG)
+    on_format_string_error("format specifier sign requires signed argument");
+}
+
+// Parses a replacement field after the argument id and returns a pointer
+// past its closing brace. Mirrors BasicFormatter::format(s, arg) but all
+// the checks depend only on the argument types.
+template <typename Char>
+constexpr const Char *parse_static_spec(
+    const Char *s, StaticFormatItem &item, int &next_index,
+    const Arg::Type *types, int num_args) {
+  Arg::Type arg_type = types[item.arg_index];
+  if (*s == ':') {
+    if (arg_type == Arg::CUSTOM) {
+      // The format specification of a custom argument is parsed by its
+      // format function.
+      for (; *s != '}'; ++s) {
+        if (!*s)
+          on_format_string_error("missing '}' in format string");
+      }
+      return s + 1;
+    }
+    ++s;
+
+    // Parse fill and alignment.
+    if (Char c = *s) {
+      const Char *p = s + 1;
+      do {
+        Alignment align = ALIGN_DEFAULT;
+        switch (*p) {
+          case '<':
+            align = ALIGN_LEFT;
+            break;
+          case '>':
+            align = ALIGN_RIGHT;
+            break;
+          case '=':
+            align = ALIGN_NUMERIC;
+            break;
+          case '^':
+            align = ALIGN_CENTER;
+            break;
+        }
+        if (align != ALIGN_DEFAULT) {
+          item.align = align;
+          if (p != s) {
+            if (c == '}') break;
+            if (c == '{')
+              on_format_string_error("invalid fill character '{'");
+            s += 2;
+            item.fill = c;
+          } else ++s;
+          if (align == ALIGN_NUMERIC && arg_type > Arg::LAST_NUMERIC_TYPE) {
+            on_format_string_error(
+                "format specifier '=' requires numeric argument");
+          }
+          break;
+        }
+      } while (--p >= s);
+    }
+
+    // Parse sign.
+    switch (*s) {
+      case '+':
+        check_static_sign(arg_type);
+        item.flags |= SIGN_FLAG | PLUS_FLAG;
+        ++s;
+        break;
+      case '-':
+        check_static_sign(arg_type);
+        item.flags |= MINUS_FLAG;
+        ++s;
+        break;
+      case ' ':
+        check_static_sign(arg_type);
+        item.flags |= SIGN_FLAG;
+        ++s;
+        break;
+    }
+
+    if (*s == '#') {
+      if (arg_type > Arg::LAST_NUMERIC_TYPE) {
+        on_format_string_error(
+            "format specifier '#' requires numeric argument");
+      }
+      item.flags |= HASH_FLAG;
+      ++s;
+    }
+
+    // Parse zero flag.
+    if (*s == '0') {
+      if (arg_type > Arg::LAST_NUMERIC_TYPE) {
+        on_format_string_error(
+            "format specifier '0' requires numeric argument");
+      }
+      item.align = ALIGN_NUMERIC;
+      item.fill = '0';
+      ++s;
+    }
+
+    // Parse width.
+    if ('0' <= *s && *s <= '9')
+      item.width = parse_static_int(s);
+    else if (*s == '{')
+      item.width_index =
+          parse_static_dynamic_spec(s, next_index, types, num_args, true);
+
+    // Parse precision.
+    if (*s == '.') {
+      ++s;
+      item.precision = 0;
+      if ('0' <= *s && *s <= '9') {
+        item.precision = static_cast<int>(parse_static_int(s));
+      } else if (*s == '{') {
+        item.precision_index =
+            parse_static_dynamic_spec(s, next_index, types, num_args, false);
+      } else {
+        on_format_string_error("missing precision specifier");
+      }
+      if (arg_type <= Arg::LAST_INTEGER_TYPE) {
+        on_format_string_error(
+            "precision not allowed in integer format specifier");
+      }
+      if (arg_type == Arg::POINTER) {
+        on_format_string_error(
+            "precision not allowed in pointer format specifier");
+      }
+    }
+
+    // Parse type.
+    if (*s != '}' && *s)
+      item.type = static_cast<char>(*s++);
+  }
+  if (*s++ != '}')
+    on_format_string_error("missing '}' in format string");
+  check_static_type(item, arg_type);
+  return s;
+}
+
+// Parses a format string at compile time checking it against the argument
+// types.
+template <std::size_t N, typename Char, typename Types>
+constexpr StaticFormat<N> parse_static_format(
+    const Char *format, const Types &arg_types) {
+  StaticFormat<N> result;
+  const Arg::Type *types = arg_types.types;
+  int num_args = static_cast<int>(sizeof(arg_types.types) / sizeof(*types)) - 1;
+  for (int i = 0; i < num_args; ++i) {
+    if (types[i] == Arg::NAMED_ARG) {
+      on_format_string_error(
+          "named arguments are not supported in compile-time format strings");
+    }
+  }
+  int next_index = 0;
+  const Char *s = format;
+  const Char *start = s;
+  while (*s) {
+    Char c = *s++;
+    if (c != '{' && c != '}') continue;
+    StaticFormatItem &item = result.items[result.size++];
+    item.text_offset = static_cast<std::size_t>(start - format);
+    if (*s == c) {
+      item.text_size = static_cast<std::size_t>(s - start);
+      start = ++s;
+      continue;
+    }
+    if (c == '}')
+      on_format_string_error("unmatched '}' in format string");
+    item.text_size = static_cast<std::size_t>(s - 1 - start);
+    item.arg_index = parse_static_arg_index(s, next_index, num_args);
+    item.spec_offset = static_cast<std::size_t>(s - format);
+    start = s = parse_static_spec(s, item, next_index, types, num_args);
+  }
+  if (start != s) {
+    StaticFormatItem &item = result.items[result.size++];
+    item.text_offset = static_cast<std::size_t>(start - format);
+    item.text_size = static_cast<std::size_t>(s - start);
+  }
+  return result;
+}
+
+template <typename S>
+struct IsCompileString {
+  enum { value = std::is_base_of<CompileString, S>::value };
+};
+
+// Formats arguments according to a format string that is parsed and checked
+// at compile time.
+template <typename S, typename... Args>
+void write_static(BasicWriter<typename S::Char> &w, const Args & ... args) {
+  typedef typename S::Char Char;
+  enum { NUM_ITEMS = count_static_items(S::data()) };
+  static constexpr StaticFormat<NUM_ITEMS> format =
+      parse_static_format<NUM_ITEMS>(
+        S::data(), StaticArgTypes<Char, Args...>());
+  typename ArgArray<sizeof...(Args)>::Type array;
+  format_static(w, S::data(), format.items, format.size,
+                make_arg_list<Char>(array, args...));
+}
+}  // namespace internal
+
+/**
+  \rst
+  Formats arguments according to a format string created with
+  :c:macro:`FMT_STRING` and returns the result as a string.
+  \endrst
+ */
+template <typename S, typename... Args>
+inline typename internal::EnableIf<
+  internal::IsCompileString<S>::value, std::basic_string<typename S::Char>
+>::type format(S, const Args & ... args) {
+  BasicMemoryWriter<typename S::Char> w;
+  internal::write_static<S>(w, args...);
+  return w.str();
+}
+
+/**
+  \rst
+  Prints formatted data to the file *f* using a format string created with
+  :c:macro:`FMT_STRING`.
+  \endrst
+ */
+template <typename S, typename... Args>
+inline typename internal::EnableIf<internal::IsCompileString<S>::value>::type
+    print(std::FILE *f, S, const Args & ... args) {
+  MemoryWriter w;
+  internal::write_static<S>(w, args...);
+  std::fwrite(w.data(), 1, w.size(), f);
+}
+
+/**
+  \rst
+  Prints formatted data to ``stdout`` using a format string created with
+  :c:macro:`FMT_STRING`.
+  \endrst
+ */
+template <typename S, typename... Args>
+inline typename internal::EnableIf<internal::IsCompileString<S>::value>::type
+    print(S format_str, const Args & ... args) {
+  print(stdout, format_str, args...);
+}
+}
+
+/**
+  \rst
+  Constructs a format string from the string literal *s* that is parsed and
+  checked against the argument types at compile time. An invalid format
+  string or a format specification that doesn't match the argument type
+  such as ``{:d}`` for a string results in a compilation error and the
+  formatting itself doesn't parse the string. If the compiler doesn't support
+  relaxed ``constexpr`` (C++14), the macro expands to *s* and the format
+  string is checked at runtime.
+
+  Named arguments are not supported in format strings checked at compile
+  time.
+
+  **Example**::
+
+    std::string s = fmt::format(FMT_STRING("{:x}"), 42);
+    fmt::print(FMT_STRING("{:d}"), "foo");  // Compilation error.
+  \endrst
+ */
+# define FMT_STRING(s) [] { \
+    struct S : fmt::internal::CompileString { \
+      typedef decltype(fmt::internal::get_char_type(s)) Char; \
+      static constexpr const Char *data() { return s; } \
+    }; \
+    return S(); \
+  }()
+#else
+# define FMT_STRING(s) s
+#endif
+
+#if FMT_USE_STATS
+namespace fmt {
+/**
+  \rst
+  Counters of formatting events that are collected per thread when the
+  library is compiled with ``FMT_USE_STATS`` defined to 1.
+  \endrst
+ */
+struct Stats {
+  /** The number of times a memory buffer grew. */
+  ULongLong buffer_grows;
+
+  /**
+    The number of times a memory buffer grew past its inline storage,
+    for example, a :class:`fmt::MemoryWriter` past 500 characters.
+   */
+  ULongLong inline_buffer_spills;
+
+  /** The number of bytes allocated by growing memory buffers. */
+  ULongLong bytes_allocated;
+
+  /** The number of floating-point values formatted with ``snprintf``. */
+  ULongLong double_snprintf_calls;
+
+  /** The number of ``snprintf`` retries after the buffer has grown. */
+  ULongLong double_snprintf_retries;
+
+  /** The number of user-defined values formatted with ``operator<<``. */
+  ULongLong ostream_fallbacks;
+
+  /** The number of maps of named arguments built. */
+  ULongLong arg_map_builds;
+};
+
+/** Returns the statistics of the calling thread. */
+Stats thread_stats();
+
+/**
+  Returns the statistics summed over all threads including the ones that
+  have exited.
+ */
+Stats collect_stats();
+
+/** Resets the statistics and format timings of all threads to zero. */
+void reset_stats();
+
+#if FMT_USE_FORMAT_TIMING
+/**
+  \rst
+  A histogram of the time spent in formatting with one format string,
+  collected when the library is compiled with ``FMT_USE_FORMAT_TIMING``
+  defined to 1.
+  Format strings are identified by content and at most 1024 different
+  format strings are timed per thread. Non-ASCII characters of wide format
+  strings are replaced with ``?``.
+  \endrst
+ */
+struct FormatTiming {
+  enum { NUM_BUCKETS = 32 };
+
+  /** The format string. */
+  std::string format;
+
+  /** The number of formatting calls. */
+  ULongLong count;
+
+  /** The total time of the calls in nanoseconds. */
+  ULongLong total_ns;
+
+  /**
+    The number of calls that took from 2\ :sup:`i` to 2\ :sup:`i+1`
+    nanoseconds in the *i*-th bucket. The first bucket also counts faster
+    calls and the last one slower calls.
+   */
+  ULongLong buckets[NUM_BUCKETS];
+};
+
+/**
+  Returns the timing histograms summed over all threads including the ones
+  that have exited, sorted by total time in descending order.
+ */
+std::vector<FormatTiming> collect_format_timings();
+#endif
+}  // namespace fmt
+#endif
+
+#if FMT_USE_PARALLEL_FORMAT
+namespace fmt {
+namespace internal {
+
+// Returns the number of hardware threads or 1 if it is not known.
+unsigned default_num_threads();
+
+// Formats a sequence of chunks on a pool of threads and writes the output
+// of the chunks in order from the calling thread.
+template <typename Char>
+class ParallelFormatter {
+ public:
+  virtual ~ParallelFormatter() {}
+
+  // Formats the chunk with the specified index. Called concurrently from
+  // the worker threads.
+  virtual void format_chunk(std::size_t index, BasicWriter<Char> &w) = 0;
+
+  // Writes the output of a chunk. Called from the calling thread only.
+  virtual void write(BasicStringRef<Char> output) = 0;
+
+  void run(std::size_t num_chunks, unsigned num_threads);
+};
+
+template <typename Char, typename It, typename Fn, typename Sink>
+class ParallelFormatTask : public ParallelFormatter<Char> {
+ private:
+  It first_;
+  std::size_t size_;
+  std::size_t chunk_size_;
+  Fn &format_record_;
+  Sink &sink_;
+
+ public:
+  ParallelFormatTask(It first, It last, Fn &format_record, Sink &sink)
+  : first_(first), size_(static_cast<std::size_t>(last - first)),
+    chunk_size_(0), format_record_(format_record), sink_(sink) {}
+
+  void format_chunk(std::size_t index, BasicWriter<Char> &w) {
+    std::size_t offset = index * chunk_size_;
+    std::size_t count = (std::min)(chunk_size_, size_ - offset);
+    It it = first_ + offset;
+    for (It end = it + count; it != end; ++it)
+      format_record_(w, *it);
+  }
+
+  void write(BasicStringRef<Char> output) { sink_(output); }
+
+  void run(unsigned num_threads, std::size_t chunk_size) {
+    if (size_ == 0)
+      return;
+    if (num_threads == 0)
+      num_threads = default_num_threads();
+    if (chunk_size == 0) {
+      // Make enough chunks for the threads to balance the load if
+      // the records take different time to format.
+      chunk_size = size_ / (num_threads * 16u);
+      chunk_size = (std::max)(std::size_t(64), (std::min)(chunk_size,
+                                                          std::size_t(8192)));
+    }
+    chunk_size_ = chunk_size;
+    ParallelFormatter<Char>::run(
+          (size_ + chunk_size - 1) / chunk_size, num_threads);
+  }
+};
+
+template <typename Char>
+struct CompiledFormatRecord {
+  const BasicCompiledFormat<Char> &format;
+
+  template <typename T>
+  void operator()(BasicWriter<Char> &w, const T &record) const {
+    w.write(format, record);
+  }
+};
+}  // namespace internal
+
+/**
+  \rst
+  Formats the records in the range [*first*, *last*) in parallel on
+  *num_threads* threads and passes the output to *sink* in the order of
+  the records. ``format_record(w, record)`` is called for each record to
+  write it to a writer ``w`` of type ``BasicWriter<Char>&`` and
+  ``sink(output)`` is called with a ``BasicStringRef<Char>`` for each
+  chunk of *chunk_size* consecutive records.
+
+  The records are split into chunks that idle threads pick up in order,
+  so that records which take longer to format don't stall other threads.
+  Each chunk is formatted into its own buffer and the sink is only called
+  from the calling thread while the rest of the chunks are formatted.
+  At most a few chunks per thread are kept in memory at any time. If either
+  *format_record* or *sink* throws the formatting stops and the exception
+  is propagated to the caller.
+
+  *It* should be a random access iterator. If *num_threads* is 0 the number
+  of hardware threads is used and if *chunk_size* is 0 it is chosen
+  according to the number of records.
+
+  **Example**::
+
+    fmt::File file("out.txt", fmt::File::WRONLY | fmt::File::CREATE);
+    fmt::parallel_format(records.begin(), records.end(),
+      [](fmt::Writer &w, const Record &r) {
+        w.write("{} {:.3f}\n", r.id, r.value);
+      },
+      [&](fmt::StringRef s) { file.write(s.data(), s.size()); });
+  \endrst
+ */
+template <typename Char = char, typename It, typename Fn, typename Sink>
+void parallel_format(It first, It last, Fn format_record, Sink sink,
+                     unsigned num_threads = 0, std::size_t chunk_size = 0) {
+  internal::ParallelFormatTask<Char, It, Fn, Sink> task(
+        first, last, format_record, sink);
+  task.run(num_threads, chunk_size);
+}
+
+/**
+  \rst
+  Formats each record in the range [*first*, *last*) as a single argument
+  according to a compiled format string in parallel. See
+  :func:`fmt::parallel_format(It, It, Fn, Sink, unsigned, std::size_t)`.
+
+  **Example**::
+
+    static const fmt::CompiledFormat format("{:08x}\n");
+    std::string s;
+    fmt::parallel_format(format, ids.begin(), ids.end(),
+      [&](fmt::StringRef output) { s.append(output.data(), output.size()); });
+  \endrst
+ */
+template <typename Char, typename It, typename Sink>
+void parallel_format(const BasicCompiledFormat<Char> &format,
+                     It first, It last, Sink sink,
+                     unsigned num_threads = 0, std::size_t chunk_size = 0) {
+  internal::CompiledFormatRecord<Char> format_record = {format};
+  parallel_format<Char>(first, last, format_record, sink,
+                        num_threads, chunk_size);
 }
+}  // namespace fmt
+#endif  // FMT_USE_PARALLEL_FORMAT
+
+#if FMT_EXTERN_TEMPLATES
+namespace fmt {
+// The instantiations are provided by format.cc.
+
+extern template void BasicWriter<char>::write_arg(
+    const internal::Arg &arg, FormatSpec spec);
+
+extern template void BasicWriter<char>::write_double(
+    float value, const FormatSpec &spec);
+
+extern template void BasicWriter<char>::write_double(
+    double value, const FormatSpec &spec);
+
+extern template void BasicWriter<char>::write_double(
+    long double value, const FormatSpec &spec);
+
+extern template void BasicFormatter<char>::format(StringRef format);
+
+extern template bool BasicFormatter<char>::format(
+    StringRef format, internal::FormatErrorInfo &error);
+
+extern template std::size_t BasicFormatter<char>::count(StringRef format);
+
+extern template void internal::PrintfFormatter<char>::format(
+    BasicWriter<char> &writer, StringRef format);
+
+extern template int internal::CharTraits<char>::format_float(
+    char *buffer, std::size_t size, const char *format,
+    unsigned width, int precision, double value);
+
+extern template int internal::CharTraits<char>::format_float(
+    char *buffer, std::size_t size, const char *format,
+    unsigned width, int precision, long double value);
+
+extern template void BasicWriter<wchar_t>::write_arg(
+    const internal::Arg &arg, FormatSpec spec);
+
+extern template void BasicWriter<wchar_t>::write_double(
+    float value, const FormatSpec &spec);
+
+extern template void BasicWriter<wchar_t>::write_double(
+    double value, const FormatSpec &spec);
+
+extern template void BasicWriter<wchar_t>::write_double(
+    long double value, const FormatSpec &spec);
+
+extern template void BasicFormatter<wchar_t>::format(WStringRef format);
+
+extern template bool BasicFormatter<wchar_t>::format(
+    WStringRef format, internal::FormatErrorInfo &error);
+
+extern template std::size_t BasicFormatter<wchar_t>::count(
+    WStringRef format);
+
+extern template void internal::PrintfFormatter<wchar_t>::format(
+    BasicWriter<wchar_t> &writer, WStringRef format);
+
+extern template int internal::CharTraits<wchar_t>::format_float(
+    wchar_t *buffer, std::size_t size, const wchar_t *format,
+    unsigned width, int precision, double value);
+
+extern template int internal::CharTraits<wchar_t>::format_float(
+    wchar_t *buffer, std::size_t size, const wchar_t *format,
+    unsigned width, int precision, long double value);
+}  // namespace fmt
+#endif  // FMT_EXTERN_TEMPLATES
 
 // Restore warnings.
 #if FMT_GCC_VERSION >= 406
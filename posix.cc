@@ -36,7 +36,19 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <new>
+
+#if FMT_USE_MMAP
+# include <sys/mman.h>
+#endif
+
+#if FMT_USE_ASYNC_SINK
+# include <chrono>
+# include <cstring>
+#endif
+
 #ifndef _WIN32
+# include <sys/uio.h>
 # include <unistd.h>
 #else
 # include <windows.h>
@@ -181,6 +193,33 @@ std::size_t fmt::File::write(const void *buffer, std::size_t count) {
   return result;
 }
 
+std::size_t fmt::File::writev(const StringRef *buffers, std::size_t count) {
+#ifndef _WIN32
+  enum { MAX_COUNT = 64 };
+  struct iovec iov[MAX_COUNT];
+  if (count > MAX_COUNT)
+    count = MAX_COUNT;
+  for (std::size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = const_cast<char*>(buffers[i].data());
+    iov[i].iov_len = buffers[i].size();
+  }
+  RWResult result = 0;
+  FMT_RETRY(result, FMT_POSIX_CALL(
+              writev(fd_, iov, static_cast<int>(count))));
+  if (result < 0)
+    throw SystemError(errno, "cannot write to file");
+  return result;
+#else
+  // Windows doesn't have writev for file descriptors, so write the first
+  // nonempty buffer.
+  for (std::size_t i = 0; i < count; ++i) {
+    if (buffers[i].size() != 0)
+      return write(buffers[i].data(), buffers[i].size());
+  }
+  return 0;
+#endif
+}
+
 fmt::File fmt::File::dup(int fd) {
   // Don't retry as dup doesn't return EINTR.
   // http://pubs.opengroup.org/onlinepubs/009695399/functions/dup.html
@@ -239,6 +278,162 @@ fmt::BufferedFile fmt::File::fdopen(const char *mode) {
   return file;
 }
 
+namespace {
+// Writes size bytes from data to the file retrying on partial writes.
+void write_all(fmt::File &file, const char *data, std::size_t size) {
+  while (size != 0) {
+    std::size_t count = file.write(data, size);
+    data += count;
+    size -= count;
+  }
+}
+
+// Writes all data from count buffers to the file retrying on partial
+// writes. The buffers are modified to point to the data not written yet.
+void write_all(fmt::File &file, fmt::StringRef *buffers, std::size_t count) {
+  while (count != 0) {
+    std::size_t written = file.writev(buffers, count);
+    for (; count != 0 && written >= buffers->size(); --count, ++buffers)
+      written -= buffers->size();
+    if (count != 0 && written != 0) {
+      *buffers = fmt::StringRef(
+            buffers->data() + written, buffers->size() - written);
+    }
+  }
+}
+}
+
+void fmt::print(File &f, StringRef format_str, ArgList args) {
+  MemoryWriter w;
+  w.write(format_str, args);
+  write_all(f, w.data(), w.size());
+}
+
+void fmt::write(File &f, SegmentedWriter &w) {
+  // write_all modifies the buffers, so write from a copy of the list.
+  std::vector<StringRef> segments(w.segments());
+  if (!segments.empty())
+    write_all(f, &segments[0], segments.size());
+}
+
+fmt::FileWriter::~FileWriter() FMT_NOEXCEPT {
+  try {
+    flush();
+  } catch (const SystemError &e) {
+    fmt::report_system_error(e.error_code(), "cannot write to file");
+  }
+}
+
+void fmt::FileWriter::append(StringRef data) {
+  if (buffer_.size() + data.size() <= threshold_) {
+    buffer_.append(data.data(), data.data() + data.size());
+    flush_if_full();
+    return;
+  }
+  StringRef buffers[] = {StringRef(&buffer_[0], buffer_.size()), data};
+  write_all(file_, buffers, 2);
+  buffer_.clear();
+}
+
+void fmt::FileWriter::flush() {
+  write_all(file_, &buffer_[0], buffer_.size());
+  buffer_.clear();
+}
+
+fmt::internal::MappedFileBuffer::MappedFileBuffer(
+    File &file, std::size_t chunk_size) : file_(file) {
+  std::size_t page_size = static_cast<std::size_t>(getpagesize());
+  chunk_size_ = (chunk_size + page_size - 1) / page_size * page_size;
+  if (chunk_size_ == 0)
+    chunk_size_ = page_size;
+}
+
+fmt::internal::MappedFileBuffer::~MappedFileBuffer() FMT_NOEXCEPT {
+  try {
+    close();
+    free();
+  } catch (const SystemError &e) {
+    fmt::report_system_error(e.error_code(), "cannot close mapped file");
+  }
+}
+
+void fmt::internal::MappedFileBuffer::free() {
+  if (!ptr_)
+    return;
+#if FMT_USE_MMAP
+  if (FMT_POSIX_CALL(munmap(ptr_, capacity_)) != 0)
+    throw SystemError(errno, "cannot unmap file");
+#else
+  delete [] ptr_;
+#endif
+  ptr_ = 0;
+  capacity_ = 0;
+}
+
+void fmt::internal::MappedFileBuffer::grow(std::size_t size) {
+  std::size_t capacity = (size + chunk_size_ - 1) / chunk_size_ * chunk_size_;
+#if FMT_USE_MMAP
+  // The data is kept in the file while it is remapped.
+  free();
+  int result = 0;
+  FMT_RETRY(result, FMT_POSIX_CALL(ftruncate(
+              file_.descriptor(), static_cast<off_t>(capacity))));
+  if (result != 0)
+    throw SystemError(errno, "cannot resize file");
+  void *ptr = FMT_POSIX_CALL(mmap(0, capacity, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, file_.descriptor(), 0));
+  if (ptr == MAP_FAILED)
+    throw SystemError(errno, "cannot map file");
+  ptr_ = static_cast<char*>(ptr);
+#else
+  char *ptr = new char[capacity];
+  std::copy(ptr_, ptr_ + size_, make_ptr(ptr, capacity));
+  delete [] ptr_;
+  ptr_ = ptr;
+#endif
+  capacity_ = capacity;
+}
+
+void fmt::internal::MappedFileBuffer::close() {
+#if FMT_USE_MMAP
+  free();
+  int result = 0;
+  FMT_RETRY(result, FMT_POSIX_CALL(ftruncate(
+              file_.descriptor(), static_cast<off_t>(size_))));
+  if (result != 0)
+    throw SystemError(errno, "cannot resize file");
+#else
+  write_all(file_, ptr_, size_);
+  size_ = 0;
+#endif
+}
+
+void *fmt::internal::allocate_huge_pages(std::size_t size) {
+#if FMT_USE_MMAP
+  void *ptr = FMT_POSIX_CALL(mmap(0, size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANON, -1, 0));
+  if (ptr == MAP_FAILED)
+    throw std::bad_alloc();
+# ifdef MADV_HUGEPAGE
+  // The advice is only a hint, so the result is ignored.
+  FMT_POSIX_CALL(madvise(ptr, size, MADV_HUGEPAGE));
+# endif
+  return ptr;
+#else
+  return ::operator new(size);
+#endif
+}
+
+void fmt::internal::deallocate_huge_pages(
+    void *ptr, std::size_t size) FMT_NOEXCEPT {
+#if FMT_USE_MMAP
+  FMT_POSIX_CALL(munmap(ptr, size));
+#else
+  (void)size;
+  ::operator delete(ptr);
+#endif
+}
+
 long fmt::getpagesize() {
 #ifdef _WIN32
   SYSTEM_INFO si;
@@ -251,3 +446,180 @@ long fmt::getpagesize() {
   return size;
 #endif
 }
+
+#if FMT_USE_ASYNC_SINK
+fmt::AsyncSink::AsyncSink(File file, OverflowPolicy policy,
+                          std::size_t num_slots, std::size_t slot_size)
+: file_(std::move(file)), policy_(policy), mask_(0), slot_size_(slot_size),
+  enqueue_pos_(0), dequeue_pos_(0), written_(0), dropped_(0), error_(0),
+  sleeping_(false), num_blocked_(0), num_flushing_(0), stop_(false) {
+  std::size_t size = 2;
+  while (size < num_slots)
+    size <<= 1;
+  mask_ = size - 1;
+  storage_.reset(new char[size * slot_size]);
+  slots_.reset(new Slot[size]);
+  for (std::size_t i = 0; i < size; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].data = 0;
+    slots_[i].size = 0;
+  }
+  thread_ = std::thread(&AsyncSink::run, this);
+}
+
+fmt::AsyncSink::~AsyncSink() FMT_NOEXCEPT {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  not_empty_.notify_one();
+  thread_.join();
+}
+
+bool fmt::AsyncSink::write(StringRef record) {
+  std::size_t size = record.size();
+  // Allocate memory for a large record before claiming a slot because
+  // a claimed slot must be released for the queue to make progress.
+  std::unique_ptr<char[]> large_data(size > slot_size_ ? new char[size] : 0);
+  std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot *slot = 0;
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(
+            pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+      continue;
+    }
+    if (diff < 0) {
+      // The queue is full.
+      switch (policy_) {
+      case DROP:
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      case OVERWRITE: {
+        std::size_t oldest_pos = 0;
+        if (pop(0, oldest_pos))
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        else
+          std::this_thread::yield();
+        break;
+      }
+      case BLOCK: {
+        // The wait is bounded because the background thread may free
+        // slots after the check above but before num_blocked_ is updated.
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++num_blocked_;
+        not_full_.wait_for(lock, std::chrono::milliseconds(1));
+        --num_blocked_;
+        break;
+      }
+      }
+    }
+    pos = enqueue_pos_.load(std::memory_order_relaxed);
+  }
+  char *data = large_data ? large_data.release() : storage(pos);
+  std::memcpy(data, record.data(), size);
+  slot->data = data;
+  slot->size = size;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed))
+    wake();
+  return true;
+}
+
+bool fmt::AsyncSink::print(StringRef format_str, ArgList args) {
+  MemoryWriter w;
+  w.write(format_str, args);
+  return write(StringRef(w.data(), w.size()));
+}
+
+void fmt::AsyncSink::flush() {
+  std::size_t target = enqueue_pos_.load(std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++num_flushing_;
+  while (static_cast<std::ptrdiff_t>(target - written_.load()) > 0)
+    written_cond_.wait(lock);
+  --num_flushing_;
+}
+
+bool fmt::AsyncSink::pop(Buffer<char> *buffer, std::size_t &pos) {
+  pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Slot *slot = 0;
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(
+            pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  if (buffer)
+    buffer->append(slot->data, slot->data + slot->size);
+  if (slot->data != storage(pos))
+    delete [] slot->data;
+  slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+void fmt::AsyncSink::wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  not_empty_.notify_one();
+}
+
+void fmt::AsyncSink::run() {
+  enum { MAX_BATCH_SIZE = 65536 };
+  internal::MemoryBuffer<char, internal::INLINE_BUFFER_SIZE> batch;
+  for (;;) {
+    // pop updates pos even if it fails, so keep the position of the last
+    // popped record separately.
+    std::size_t pos = 0, last_pos = 0, count = 0;
+    while (batch.size() < MAX_BATCH_SIZE && pop(&batch, pos)) {
+      last_pos = pos;
+      ++count;
+    }
+    if (count != 0) {
+      if (num_blocked_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        not_full_.notify_all();
+      }
+      try {
+        write_all(file_, &batch[0], batch.size());
+      } catch (const SystemError &e) {
+        error_.store(e.error_code(), std::memory_order_relaxed);
+        dropped_.fetch_add(count, std::memory_order_relaxed);
+      }
+      batch.clear();
+      written_.store(last_pos + 1, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (num_flushing_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_cond_.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::size_t next = dequeue_pos_.load(std::memory_order_relaxed);
+    if (slots_[next & mask_].sequence.load(std::memory_order_acquire) !=
+        next + 1) {
+      if (stop_)
+        break;
+      not_empty_.wait(lock);
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+  }
+}
+#endif
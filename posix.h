@@ -38,9 +38,36 @@
 #include <stdio.h>
 
 #include <cstddef>
+#include <memory>  // for std::allocator
 
 #include "format.h"
 
+// Define FMT_USE_MMAP to 0 to store the output of MappedFileWriter in memory
+// instead of a memory-mapped file.
+#ifndef FMT_USE_MMAP
+# ifdef _WIN32
+#  define FMT_USE_MMAP 0
+# else
+#  define FMT_USE_MMAP 1
+# endif
+#endif
+
+// Define FMT_USE_ASYNC_SINK to 0 to disable AsyncSink which requires
+// C++11 threads and atomics.
+#ifndef FMT_USE_ASYNC_SINK
+# define FMT_USE_ASYNC_SINK \
+   (__cplusplus >= 201103L || \
+       (FMT_GCC_VERSION >= 408 && FMT_HAS_GXX_CXX11) || _MSC_VER >= 1900)
+#endif
+
+#if FMT_USE_ASYNC_SINK
+# include <atomic>
+# include <condition_variable>
+# include <memory>
+# include <mutex>
+# include <thread>
+#endif
+
 #ifndef FMT_POSIX
 # if defined(_WIN32) && !defined(__MINGW32__)
 // Fix warnings about deprecated symbols.
@@ -193,10 +220,10 @@ public:
   // of MinGW that define fileno as a macro.
   int (fileno)() const;
 
-  void print(CStringRef format_str, const ArgList &args) {
+  void print(StringRef format_str, const ArgList &args) {
     fmt::print(file_, format_str, args);
   }
-  FMT_VARIADIC(void, print, CStringRef)
+  FMT_VARIADIC(void, print, StringRef)
 };
 
 // A file. Closed file is represented by a File object with descriptor -1.
@@ -304,6 +331,11 @@ class File {
   // Attempts to write count bytes from the specified buffer to the file.
   std::size_t write(const void *buffer, std::size_t count);
 
+  // Attempts to write data from count buffers to the file with a single
+  // system call. Returns the number of bytes written which may be less
+  // than the total size of the buffers.
+  std::size_t writev(const StringRef *buffers, std::size_t count);
+
   // Duplicates a file descriptor with the dup function and returns
   // the duplicate as a file object.
   static File dup(int fd);
@@ -325,8 +357,291 @@ class File {
   BufferedFile fdopen(const char *mode);
 };
 
+// Prints formatted data to the file f writing directly to the descriptor.
+void print(File &f, StringRef format_str, ArgList args);
+FMT_VARIADIC(void, print, File &, StringRef)
+
+// Writes the output of a segmented writer to the file passing the segments
+// to writev directly without copying them into a contiguous buffer.
+void write(File &f, SegmentedWriter &w);
+
+// A writer that accumulates output in a large buffer and writes it to
+// a file directly, bypassing stdio. The data is written when the buffer
+// size reaches the threshold passed to the constructor after any write
+// operation, when flush is called and when the object is destroyed.
+// FileWriter doesn't own the file which must outlive the writer.
+class FileWriter : public BasicWriter<char> {
+ private:
+  internal::MemoryBuffer<char, internal::INLINE_BUFFER_SIZE> buffer_;
+  File &file_;
+  std::size_t threshold_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(FileWriter);
+
+  void flush_if_full() {
+    if (buffer_.size() >= threshold_)
+      flush();
+  }
+
+ public:
+  enum { DEFAULT_BUFFER_SIZE = 1 << 16 };
+
+  explicit FileWriter(File &file, std::size_t buffer_size = DEFAULT_BUFFER_SIZE)
+  : BasicWriter<char>(buffer_), file_(file), threshold_(buffer_size) {
+    buffer_.reserve(buffer_size);
+  }
+
+  // Writes buffered data reporting errors, if any, without throwing
+  // an exception.
+  ~FileWriter() FMT_NOEXCEPT;
+
+  // Formats arguments and writes the output to the buffer.
+  void write(StringRef format_str, ArgList args) {
+    BasicWriter<char>::write(format_str, args);
+    flush_if_full();
+  }
+  FMT_VARIADIC(void, write, StringRef)
+
+  void write(const CompiledFormat &format, ArgList args) {
+    BasicWriter<char>::write(format, args);
+    flush_if_full();
+  }
+  FMT_VARIADIC(void, write, const CompiledFormat &)
+
+  template <typename T>
+  FileWriter &operator<<(const T &value) {
+    BasicWriter<char>::operator<<(value);
+    flush_if_full();
+    return *this;
+  }
+
+  FileWriter &write_padded(StringRef s, unsigned width,
+                           Alignment align = ALIGN_LEFT, char fill = ' ') {
+    BasicWriter<char>::write_padded(s, width, align, fill);
+    flush_if_full();
+    return *this;
+  }
+
+  FileWriter &write_wide(WStringRef s) {
+    BasicWriter<char>::write_wide(s);
+    flush_if_full();
+    return *this;
+  }
+
+  template <typename It>
+  void write_range(It first, It last, const FormatSpec &spec, StringRef sep) {
+    BasicWriter<char>::write_range(first, last, spec, sep);
+    flush_if_full();
+  }
+
+  // Appends data to the output. Data that doesn't fit in the buffer
+  // is written together with the buffered data in a single writev call
+  // without copying.
+  void append(StringRef data);
+
+  // Writes buffered data to the file. If writing fails, the data stays in
+  // the buffer.
+  void flush();
+};
+
 // Returns the memory page size.
 long getpagesize();
+
+namespace internal {
+// A buffer that stores data in a memory-mapped file starting at offset 0.
+// When the buffer grows, the file is extended and remapped in chunks.
+// If FMT_USE_MMAP is 0, the data is stored in memory and written to the
+// file at the current position by close.
+class MappedFileBuffer : public Buffer<char> {
+ private:
+  File &file_;
+  std::size_t chunk_size_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(MappedFileBuffer);
+
+  void free();
+
+ protected:
+  void grow(std::size_t size);
+
+ public:
+  // Constructs a MappedFileBuffer object. chunk_size is rounded up to
+  // a multiple of the memory page size.
+  MappedFileBuffer(File &file, std::size_t chunk_size);
+  ~MappedFileBuffer() FMT_NOEXCEPT;
+
+  // Unmaps the file and truncates it to the buffer size.
+  void close();
+};
+}
+
+namespace internal {
+// Allocates size bytes of anonymous memory advising the kernel to back it
+// with huge pages where supported. Throws std::bad_alloc on failure.
+void *allocate_huge_pages(std::size_t size);
+
+// Frees memory allocated with allocate_huge_pages.
+void deallocate_huge_pages(void *ptr, std::size_t size) FMT_NOEXCEPT;
+}
+
+// An allocator that maps blocks of at least THRESHOLD bytes directly and
+// advises the kernel to back them with transparent huge pages, reducing
+// TLB misses and page faults for very large buffers. Smaller blocks are
+// allocated with std::allocator. Usage:
+//   fmt::BasicMemoryWriter<char, fmt::HugePageAllocator<char> > out;
+template <typename T>
+class HugePageAllocator : public std::allocator<T> {
+ public:
+  enum { THRESHOLD = 1 << 21 };
+
+  template <typename U>
+  struct rebind { typedef HugePageAllocator<U> other; };
+
+  HugePageAllocator() {}
+
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    if (n * sizeof(T) < THRESHOLD)
+      return std::allocator<T>::allocate(n);
+    return static_cast<T*>(internal::allocate_huge_pages(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    if (n * sizeof(T) < THRESHOLD)
+      std::allocator<T>::deallocate(p, n);
+    else
+      internal::deallocate_huge_pages(p, n * sizeof(T));
+  }
+};
+
+// A writer that formats directly into a memory-mapped file, so the output
+// goes to the page cache without intermediate copying or write calls.
+// MappedFileWriter doesn't own the file which must be opened for reading
+// and writing and outlive the writer. On close or destruction the file is
+// truncated to the size of the written data.
+class MappedFileWriter : public BasicWriter<char> {
+ private:
+  internal::MappedFileBuffer buffer_;
+
+ public:
+  enum { DEFAULT_CHUNK_SIZE = 1 << 24 };
+
+  explicit MappedFileWriter(
+      File &file, std::size_t chunk_size = DEFAULT_CHUNK_SIZE)
+  : BasicWriter<char>(buffer_), buffer_(file, chunk_size) {}
+
+  // Unmaps the file and truncates it to the size of the written data.
+  // The writer should not be used after close.
+  void close() { buffer_.close(); }
+};
+
+#if FMT_USE_ASYNC_SINK
+// A sink that writes records to a file from a background thread so that
+// threads producing the records don't wait for I/O. Records are copied into
+// a bounded lock-free queue of preallocated slots which can be written to
+// concurrently by any number of threads. The background thread writes
+// consecutive records in batches with a single File::write call.
+// Records larger than a slot are copied to dynamically allocated memory.
+class AsyncSink {
+ public:
+  // What to do with a record if the queue is full.
+  enum OverflowPolicy {
+    BLOCK,     // Wait until the background thread frees a slot.
+    DROP,      // Discard the new record.
+    OVERWRITE  // Discard the oldest queued record.
+  };
+
+  // Constructs an AsyncSink object writing to the specified file and starts
+  // the background thread. num_slots is rounded up to a power of two.
+  explicit AsyncSink(File file, OverflowPolicy policy = BLOCK,
+                     std::size_t num_slots = 1024,
+                     std::size_t slot_size = 256);
+
+  // Writes all queued records, stops the background thread and closes
+  // the file.
+  ~AsyncSink() FMT_NOEXCEPT;
+
+  // Queues a record for writing. Returns false if the record has been
+  // discarded because the queue is full and the policy is DROP.
+  bool write(StringRef record);
+
+  // Formats arguments and queues the result for writing.
+  bool print(StringRef format_str, ArgList args);
+  FMT_VARIADIC(bool, print, StringRef)
+
+  // Waits until all records queued before the call have been written.
+  void flush();
+
+  // Returns the number of records discarded because the queue was full
+  // or because writing them failed.
+  std::size_t dropped() const FMT_NOEXCEPT {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the error code of the last failed write or 0 if there were none.
+  ErrorCode error() const FMT_NOEXCEPT {
+    return ErrorCode(error_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  struct Slot {
+    // Equal to the record position if the slot is free and to the
+    // position + 1 if the slot holds the record.
+    std::atomic<std::size_t> sequence;
+    char *data;
+    std::size_t size;
+  };
+
+  File file_;
+  OverflowPolicy policy_;
+  std::size_t mask_;
+  std::size_t slot_size_;
+  std::unique_ptr<char[]> storage_;
+  std::unique_ptr<Slot[]> slots_;
+
+  std::atomic<std::size_t> enqueue_pos_;
+  std::atomic<std::size_t> dequeue_pos_;
+
+  // The position following the last record written by the background thread.
+  std::atomic<std::size_t> written_;
+
+  std::atomic<std::size_t> dropped_;
+  std::atomic<int> error_;
+
+  // Set when the background thread is about to wait for records.
+  std::atomic<bool> sleeping_;
+
+  // The numbers of threads blocked in write and flush respectively.
+  std::atomic<int> num_blocked_;
+  std::atomic<int> num_flushing_;
+
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::condition_variable written_cond_;
+  std::thread thread_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(AsyncSink);
+
+  // Returns a pointer to the preallocated storage of the slot holding the
+  // record at position pos.
+  char *storage(std::size_t pos) {
+    return &storage_[(pos & mask_) * slot_size_];
+  }
+
+  // Dequeues a record and appends it to buffer unless the latter is null.
+  // Returns false if the next record is not ready.
+  bool pop(Buffer<char> *buffer, std::size_t &pos);
+
+  void wake();
+
+  // Writes queued records until the object is destroyed.
+  void run();
+};
+#endif
 }  // namespace fmt
 
 #if !FMT_USE_RVALUE_REFERENCES
@@ -32,6 +32,7 @@
 #include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <list>
 #include <memory>
 #include <sstream>
 #include <stdint.h>
@@ -254,6 +255,24 @@ TEST(WriterTest, Allocator) {
   EXPECT_CALL(alloc, deallocate(&mem[0], size));
 }
 
+// Returns true if the writer's data is stored in the writer object itself.
+template <typename Writer>
+bool is_inline(const Writer &w) {
+  const char *begin = reinterpret_cast<const char*>(&w);
+  const char *data = reinterpret_cast<const char*>(w.data());
+  return begin <= data && data < begin + sizeof(w);
+}
+
+TEST(WriterTest, InlineSize) {
+  fmt::BasicMemoryWriter<char, std::allocator<char>, 10> w;
+  EXPECT_LT(sizeof(w), sizeof(MemoryWriter));
+  w << "0123456789";
+  EXPECT_TRUE(is_inline(w));
+  w << 'a';
+  EXPECT_FALSE(is_inline(w));
+  EXPECT_EQ("0123456789a", w.str());
+}
+
 TEST(WriterTest, Data) {
   MemoryWriter w;
   w << 42;
@@ -295,8 +314,10 @@ TEST(WriterTest, WriteLongLong) {
 TEST(WriterTest, WriteDouble) {
   CHECK_WRITE(4.2);
   CHECK_WRITE(-4.2);
-  CHECK_WRITE(std::numeric_limits<double>::min());
-  CHECK_WRITE(std::numeric_limits<double>::max());
+  EXPECT_EQ("2.2250738585072014e-308",
+            (MemoryWriter() << std::numeric_limits<double>::min()).str());
+  EXPECT_EQ("1.7976931348623157e+308",
+            (MemoryWriter() << std::numeric_limits<double>::max()).str());
 }
 
 TEST(WriterTest, WriteLongDouble) {
@@ -348,6 +369,33 @@ TEST(WriterTest, WriteWideString) {
   //fmt::WMemoryWriter() << "abc";
 }
 
+TEST(WriterTest, WriteWide) {
+  MemoryWriter w;
+  w << "<";
+  w.write_wide(L"\x00e9t\x00e9").write_wide(std::wstring(30, L'a'));
+  EXPECT_EQ("<\xc3\xa9t\xc3\xa9" + std::string(30, 'a'), w.str());
+  std::wstring invalid(1, static_cast<wchar_t>(0xdc00));
+  EXPECT_THROW_MSG(w.write_wide(invalid), FormatError,
+                   "cannot convert wide string to UTF-8");
+  EXPECT_EQ(36u, w.size());
+  fmt::WMemoryWriter ww;
+  ww.write_wide(L"abc");
+  EXPECT_EQ(L"abc", ww.str());
+}
+
+TEST(WriterTest, WritePadded) {
+  MemoryWriter w;
+  w.write_padded("name", 8).write_padded("42", 6, fmt::ALIGN_RIGHT);
+  EXPECT_EQ("name        42", w.str());
+  w.clear();
+  w.write_padded("ab", 6, fmt::ALIGN_CENTER, '*');
+  w.write_padded("toolong", 3, fmt::ALIGN_RIGHT);
+  EXPECT_EQ("**ab**toolong", w.str());
+  fmt::WMemoryWriter ww;
+  ww.write_padded(L"abc", 5, fmt::ALIGN_RIGHT, L'-');
+  EXPECT_EQ(L"--abc", ww.str());
+}
+
 TEST(WriterTest, bin) {
   using fmt::bin;
   EXPECT_EQ("1100101011111110", (MemoryWriter() << bin(0xcafe)).str());
@@ -497,10 +545,95 @@ TEST(WriterTest, Format) {
   EXPECT_EQ("part1part2", w.str());
 }
 
+TEST(WriterTest, WriteRange) {
+  int ints[] = {1, -2, 300};
+  MemoryWriter w;
+  w.write_range(ints, ints + 3, fmt::FormatSpec(), ", ");
+  EXPECT_EQ("1, -2, 300", w.str());
+  w.clear();
+  w.write_range(ints, ints + 3, fmt::FormatSpec(4, 'x', '*'), "|");
+  EXPECT_EQ("***1|**-2|*12c", w.str());
+  w.clear();
+  w.write_range(ints, ints, fmt::FormatSpec(), ", ");
+  EXPECT_EQ("", w.str());
+  std::vector<double> doubles;
+  doubles.push_back(1.234);
+  doubles.push_back(5.678);
+  fmt::FormatSpec spec(0, 'f');
+  spec.precision_ = 1;
+  w.write_range(doubles.begin(), doubles.end(), spec, ", ");
+  EXPECT_EQ("1.2, 5.7", w.str());
+  w.clear();
+  std::vector<unsigned long long> v(100, ULLONG_MAX);
+  w.write_range(v.begin(), v.end(), fmt::FormatSpec(0, 'b'), "");
+  EXPECT_EQ(std::string(6400, '1'), w.str());
+  w.clear();
+  const char *strings[] = {"a", "bc"};
+  w.write_range(strings, strings + 2, fmt::FormatSpec(3), " ");
+  EXPECT_EQ("a   bc ", w.str());
+  fmt::WMemoryWriter ww;
+  ww.write_range(ints, ints + 2, fmt::FormatSpec(), L", ");
+  EXPECT_EQ(L"1, -2", ww.str());
+  Date dates[] = {Date(2012, 12, 9)};
+  EXPECT_THROW_MSG(w.write_range(dates, dates + 1, fmt::FormatSpec(), ""),
+      FormatError, "cannot write a range of user-defined type");
+}
+
 TEST(WriterTest, WWriter) {
   EXPECT_EQ(L"cafe", (fmt::WMemoryWriter() << fmt::hex(0xcafe)).str());
 }
 
+TEST(SegmentedWriterTest, Write) {
+  fmt::SegmentedWriter w(8);
+  EXPECT_EQ(0u, w.size());
+  EXPECT_TRUE(w.segments().empty());
+  w << "abc" << 42;
+  const char *first = w.segments()[0].data();
+  std::string expected = "abc42";
+  for (int i = 0; i < 100; ++i) {
+    w.write("{:>4}", i);
+    expected += fmt::format("{:>4}", i);
+  }
+  w << std::string(20, 'x');
+  expected += std::string(20, 'x');
+  EXPECT_EQ(expected.size(), w.size());
+  EXPECT_EQ(expected, w.str());
+  const std::vector<fmt::StringRef> &segments = w.segments();
+  EXPECT_GT(segments.size(), 1u);
+  // The data written before is never moved.
+  EXPECT_EQ(first, segments[0].data());
+  std::string joined;
+  for (std::size_t i = 0; i < segments.size(); ++i)
+    joined.append(segments[i].data(), segments[i].size());
+  EXPECT_EQ(expected, joined);
+  w.clear();
+  EXPECT_EQ(0u, w.size());
+  w << "def";
+  EXPECT_EQ("def", w.str());
+}
+
+TEST(SegmentedWriterTest, BasicWriterRef) {
+  fmt::SegmentedWriter w(4);
+  fmt::Writer &base = w;
+  base << "abcdef";
+  base.write("{}{}", 1, 2);
+  w << '!';
+  EXPECT_EQ("abcdef12!", w.str());
+  // Writing past several chunks through a reference grows the window
+  // geometrically.
+  w.clear();
+  std::string expected;
+  for (int i = 0; i < 100000; ++i) {
+    base << "0123456789";
+    expected += "0123456789";
+  }
+  EXPECT_LT(base.buffer().capacity(), 2 * expected.size());
+  EXPECT_EQ(expected, w.str());
+  fmt::WSegmentedWriter ww(4);
+  ww << L"wide" << 42;
+  EXPECT_EQ(L"wide42", ww.str());
+}
+
 TEST(ArrayWriterTest, Ctor) {
   char array[10] = "garbage";
   fmt::ArrayWriter w(array, sizeof(array));
@@ -562,6 +695,27 @@ TEST(FormatterTest, NoArgs) {
   EXPECT_EQ("test", format("test"));
 }
 
+// Checks that special characters are found at every offset in a block
+// of the format string regardless of its alignment.
+TEST(FormatterTest, LongLiterals) {
+  std::string text(100, 'x');
+  for (std::size_t start = 0; start < 40; ++start) {
+    for (std::size_t pos = start; pos < 70; ++pos) {
+      std::string literal = text.substr(start, pos - start);
+      EXPECT_EQ(literal, format((literal + "{}").c_str(), ""));
+      EXPECT_EQ(literal + "}", format((literal + "}}").c_str()));
+      EXPECT_EQ(literal + "42" + literal,
+                format((literal + "{}" + literal).c_str(), 42));
+      std::wstring wliteral(literal.begin(), literal.end());
+      EXPECT_EQ(wliteral + L"{" + wliteral,
+                format((wliteral + L"{{" + wliteral).c_str()));
+      EXPECT_EQ(wliteral + L"42", format((wliteral + L"{}").c_str(), 42));
+    }
+  }
+  EXPECT_THROW_MSG(format((text + "}").c_str()),
+      FormatError, "unmatched '}' in format string");
+}
+
 TEST(FormatterTest, ArgsInDifferentPositions) {
   EXPECT_EQ("42", format("{0}", 42));
   EXPECT_EQ("before 42", format("before {0}", 42));
@@ -618,6 +772,13 @@ TEST(FormatterTest, ManyArgs) {
   std::string format_str = fmt::format("{{{}}}", MAX_PACKED_ARGS + 1);
   EXPECT_THROW_MSG(TestFormat<MAX_PACKED_ARGS>::format(format_str),
                    FormatError, "argument index out of range");
+  EXPECT_EQ("99 0 15 16 31 32 63 64",
+            TestFormat<100>::format("{99} {0} {15} {16} {31} {32} {63} {64}"));
+  EXPECT_THROW_MSG(TestFormat<100>::format("{100}"),
+                   FormatError, "argument index out of range");
+  EXPECT_EQ("31 abc 1.5 x", TestFormat<32>::format(
+              "{31} {32} {33:.1f} {34}", "abc", 1.5, 'x'));
+  EXPECT_EQ("s 40", TestFormat<41>::format("{x} {40}", fmt::arg("x", "s")));
 }
 #endif
 
@@ -642,6 +803,64 @@ TEST(FormatterTest, NamedArg) {
   EXPECT_EQ(L"n=100", format(L"n={n}", FMT_CAPTURE_W(n)));
 }
 
+// Formats the arguments named a0, a1, ... with values 0, 1, ... followed by
+// an argument named a0 with value -1.
+std::string format_named_args(const std::string &format_str,
+                              unsigned num_args, bool compiled) {
+  using fmt::internal::Arg;
+  std::vector<std::string> names;
+  for (unsigned i = 0; i < num_args; ++i)
+    names.push_back(format("a{}", i));
+  names.push_back("a0");
+  std::vector<fmt::internal::NamedArg<char> > named_args;
+  for (unsigned i = 0; i <= num_args; ++i) {
+    named_args.push_back(fmt::internal::NamedArg<char>(
+                           names[i], i < num_args ? static_cast<int>(i) : -1));
+  }
+  // Values are passed in an array of Value if there are few of them
+  // and Arg otherwise.
+  std::vector<fmt::internal::Value> values(num_args + 1);
+  std::vector<Arg> args(num_args + 2);
+  fmt::ULongLong types = 0;
+  for (unsigned i = 0; i <= num_args; ++i) {
+    values[i].pointer = args[i].pointer = &named_args[i];
+    args[i].type = Arg::NAMED_ARG;
+    if (i < fmt::ArgList::MAX_PACKED_ARGS)
+      types |= static_cast<fmt::ULongLong>(Arg::NAMED_ARG) << (4 * i);
+  }
+  args[num_args + 1].type = Arg::NONE;
+  fmt::ArgList arg_list = num_args + 1 < fmt::ArgList::MAX_PACKED_ARGS ?
+        fmt::ArgList(types, &values[0]) : fmt::ArgList(types, &args[0]);
+  if (compiled)
+    return format(fmt::CompiledFormat(format_str), arg_list);
+  return format(format_str, arg_list);
+}
+
+TEST(FormatterTest, ManyNamedArgs) {
+  // Test both the linear search and the hash table, the latter with
+  // and without allocating memory.
+  unsigned num_args[] = {3, 12, 40};
+  for (std::size_t i = 0; i < sizeof(num_args) / sizeof(*num_args); ++i) {
+    unsigned n = num_args[i];
+    std::string format_str = "{a0}", expected = "0";
+    for (int j = static_cast<int>(n) - 1; j > 0; j -= 2) {
+      format_str += format("/{{a{}}}", j);
+      expected += format("/{}", j);
+    }
+    format_str += "/{a1:>{a2}}";
+    expected += "/ 1";
+    for (int compiled = 0; compiled <= 1; ++compiled) {
+      EXPECT_EQ(expected, format_named_args(format_str, n, compiled != 0));
+      EXPECT_THROW_MSG(format_named_args("{a0}{a}", n, compiled != 0),
+                       FormatError, "argument not found");
+      EXPECT_THROW_MSG(format_named_args(format("{{a{}}}", n), n,
+                                         compiled != 0),
+                       FormatError, "argument not found");
+    }
+  }
+  EXPECT_EQ("1", format("{x}", fmt::arg("x", 1), fmt::arg("x", 2)));
+}
+
 TEST(FormatterTest, AutoArgIndex) {
   EXPECT_EQ("abc", format("{}{}{}", 'a', 'b', 'c'));
   EXPECT_THROW_MSG(format("{0}{}", 'a', 'b'),
@@ -1286,6 +1505,87 @@ TEST(FormatterTest, FormatDouble) {
   EXPECT_EQ(buffer, format("{:A}", -42.0));
 }
 
+TEST(FormatterTest, FormatShortestDouble) {
+  EXPECT_EQ("0.1", format("{}", 0.1));
+  EXPECT_EQ("0.3", format("{}", 0.3));
+  EXPECT_EQ("0.30000000000000004", format("{}", 0.1 + 0.2));
+  EXPECT_EQ("-6016.951217939863", format("{}", -6016.951217939863));
+  EXPECT_EQ("1e+16", format("{}", 1e16));
+  EXPECT_EQ("1234567890123456", format("{}", 1234567890123456.0));
+  EXPECT_EQ("0.0001", format("{}", 1e-4));
+  EXPECT_EQ("1e-05", format("{}", 1e-5));
+  EXPECT_EQ("5e-324", format("{}", 4.9406564584124654e-324));
+  EXPECT_EQ("1.7976931348623157e+308", format("{}", 1.7976931348623157e308));
+  EXPECT_EQ("-0", format("{}", -0.0));
+  EXPECT_EQ("+0.5", format("{:+}", 0.5));
+  EXPECT_EQ("  0.25", format("{:6}", 0.25));
+  EXPECT_EQ("-00.25", format("{:06}", -0.25));
+}
+
+TEST(FormatterTest, FormatShortestFloat) {
+  EXPECT_EQ("0.1", format("{}", 0.1f));
+  EXPECT_EQ("0.3", format("{}", 0.1f + 0.2f));
+  EXPECT_EQ("392.65", format("{}", 392.65f));
+  EXPECT_EQ("16777216", format("{}", 16777216.0f));
+  EXPECT_EQ("1e-45", format("{}", std::numeric_limits<float>::denorm_min()));
+  EXPECT_EQ("1.1754944e-38", format("{}", std::numeric_limits<float>::min()));
+  EXPECT_EQ("3.4028235e+38", format("{}", std::numeric_limits<float>::max()));
+  EXPECT_EQ("-0.5", format("{}", -0.5f));
+  EXPECT_EQ("  0.1", format("{:5}", 0.1f));
+  EXPECT_EQ("0.10000000149011612", format("{}", static_cast<double>(0.1f)));
+  EXPECT_EQ("0.100000", format("{:f}", 0.1f));
+  fmt::MemoryWriter w;
+  w << 0.1f;
+  EXPECT_EQ("0.1", w.str());
+  // Check that the output round-trips and is not longer than the shortest
+  // representation found with snprintf.
+  char buffer[BUFFER_SIZE];
+  for (uint32_t bits = 1; bits < 0x7f800000; bits += 0x1234b) {
+    float value = 0;
+    std::memcpy(&value, &bits, sizeof(bits));
+    std::string s = format("{}", value);
+    EXPECT_EQ(value, static_cast<float>(std::strtod(s.c_str(), 0))) << s;
+    int precision = 1;
+    for (; precision < 9; ++precision) {
+      safe_sprintf(buffer, "%.*e", precision - 1, value);
+      if (static_cast<float>(std::strtod(buffer, 0)) == value)
+        break;
+    }
+    std::string digits;
+    for (std::size_t i = 0; i < s.size() && s[i] != 'e'; ++i) {
+      if (std::isdigit(s[i]) && (!digits.empty() || s[i] != '0'))
+        digits += s[i];
+    }
+    digits.erase(digits.find_last_not_of('0') + 1);
+    EXPECT_LE(digits.size(), static_cast<std::size_t>(precision)) << s;
+  }
+}
+
+TEST(FormatterTest, FormatDoublePrecision) {
+  char buffer[BUFFER_SIZE];
+  double values[] = {
+    0.0, 0.5, 1.0, 0.125, 392.65, 999999.5, 9.5, 1e-5, 123456789.0,
+    2.2250738585072014e-308, 4.9406564584124654e-324, 1.2345678901234567e200
+  };
+  const char *formats[][2] = {
+    {"{:e}", "%e"}, {"{:.0e}", "%.0e"}, {"{:.16e}", "%.16e"},
+    {"{:f}", "%f"}, {"{:.0f}", "%.0f"}, {"{:.20f}", "%.20f"},
+    {"{:g}", "%g"}, {"{:.1g}", "%.1g"}, {"{:.17g}", "%.17g"},
+    {"{:#g}", "%#g"}, {"{:#.0f}", "%#.0f"}, {"{:+E}", "%+E"},
+    {"{:<15.3e}", "%-15.3e"}, {"{:015.7G}", "%015.7G"}
+  };
+  for (std::size_t i = 0; i < sizeof(values) / sizeof(*values); ++i) {
+    for (std::size_t j = 0; j < sizeof(formats) / sizeof(*formats); ++j) {
+      safe_sprintf(buffer, formats[j][1], values[i]);
+      EXPECT_EQ(buffer, format(formats[j][0], values[i]));
+      safe_sprintf(buffer, formats[j][1], -values[i]);
+      EXPECT_EQ(buffer, format(formats[j][0], -values[i]));
+    }
+  }
+  EXPECT_EQ("1.000e+00****", format("{:*<13.3e}", 1.0));
+  EXPECT_EQ("**1.000e+00**", format("{:*^13.3e}", 1.0));
+}
+
 TEST(FormatterTest, FormatNaN) {
   double nan = std::numeric_limits<double>::quiet_NaN();
   EXPECT_EQ("nan", format("{}", nan));
@@ -1295,6 +1595,8 @@ TEST(FormatterTest, FormatNaN) {
   EXPECT_EQ("nan    ", format("{:<7}", nan));
   EXPECT_EQ("  nan  ", format("{:^7}", nan));
   EXPECT_EQ("    nan", format("{:>7}", nan));
+  EXPECT_EQ("nan0000000", format("{:010}", nan));
+  EXPECT_EQ("nan       ", format("{:=10}", nan));
 }
 
 TEST(FormatterTest, FormatInfinity) {
@@ -1307,6 +1609,8 @@ TEST(FormatterTest, FormatInfinity) {
   EXPECT_EQ("inf    ", format("{:<7}", inf));
   EXPECT_EQ("  inf  ", format("{:^7}", inf));
   EXPECT_EQ("    inf", format("{:>7}", inf));
+  EXPECT_EQ("-inf000000", format("{:010}", -inf));
+  EXPECT_EQ("inf       ", format("{:=10}", inf));
 }
 
 TEST(FormatterTest, FormatLongDouble) {
@@ -1409,6 +1713,172 @@ TEST(FormatterTest, CustomFormat) {
   EXPECT_EQ("42", format("{0}", Answer()));
 }
 
+TEST(FormatterTest, FormatUsingIOStreamsWithSpec) {
+  Date date(2012, 12, 9);
+  EXPECT_EQ("2012-12-9 ", format("{:10}", date));
+  EXPECT_EQ(" 2012-12-9", format("{:>10}", date));
+  EXPECT_EQ("*2012-12-9**", format("{:*^12}", date));
+  EXPECT_EQ("2012", format("{:.4}", date));
+  EXPECT_EQ("  2012", format("{:>6.4}", date));
+  EXPECT_EQ("2012-12-9", format("{:5}", date));
+  EXPECT_EQ(L"  2012-12-9", format(L"{:>11}", date));
+  std::string long_str(1000, 'x');
+  EXPECT_EQ("[" + long_str + "]", format("[{}]", TestString(long_str.c_str())));
+  char buffer[8];
+  fmt::ArrayWriter w(buffer);
+  EXPECT_THROW_MSG(w.write("{}", date), std::runtime_error,
+      "buffer overflow");
+}
+
+struct Money {
+  int cents;
+  explicit Money(int c) : cents(c) {}
+};
+
+// A stream inserter that is never used because Formatter is specialized.
+std::ostream &operator<<(std::ostream &os, Money) { return os << "wrong"; }
+
+namespace fmt {
+template <>
+struct Formatter<Money> {
+  template <typename Char>
+  static void format(BasicWriter<Char> &w, Money m) {
+    w << m.cents / 100 << '.' << pad(m.cents % 100, 2, '0');
+  }
+};
+}
+
+TEST(FormatterTest, FormatterSpecialization) {
+  EXPECT_EQ("1234.05", format("{}", Money(123405)));
+  EXPECT_EQ("  1234.05", format("{:>9}", Money(123405)));
+  EXPECT_EQ("12", format("{:.2}", Money(123405)));
+  EXPECT_EQ("a 0.42 b", format("a {} {}", Money(42), 'b'));
+  EXPECT_EQ(L"0.07 ", format(L"{:5}", Money(7)));
+  EXPECT_THROW_MSG(format("{:d}", Money(1)), FormatError,
+      "unknown format code 'd' for string");
+}
+
+std::tm make_tm(int year, int mon, int mday, int hour, int min, int sec) {
+  std::tm time = std::tm();
+  time.tm_year = year - 1900;
+  time.tm_mon = mon - 1;
+  time.tm_mday = mday;
+  time.tm_hour = hour;
+  time.tm_min = min;
+  time.tm_sec = sec;
+  time.tm_wday = 2;
+  time.tm_yday = 44;
+  return time;
+}
+
+TEST(FormatterTest, FormatTime) {
+  std::tm time = make_tm(2016, 2, 14, 9, 5, 7);
+  EXPECT_EQ("2016-02-14 09:05:07", format("{}", time));
+  EXPECT_EQ("2016-02-14 09:05:07", format("{:%Y-%m-%d %H:%M:%S}", time));
+  EXPECT_EQ("Tue Tuesday Feb Feb February",
+            format("{:%a %A %b %h %B}", time));
+  EXPECT_EQ("20 16 02/14/16 14 2016-02-14 09 09 045 02 05",
+            format("{:%C %y %D %e %F %H %I %j %m %M}", time));
+  EXPECT_EQ("AM 09:05:07 AM 09:05 09:05:07 2 2 % \n \t",
+            format("{:%p %r %R %T %u %w %% %n %t}", time));
+  time.tm_hour = 0;
+  EXPECT_EQ("12 AM", format("{:%I %p}", time));
+  time.tm_hour = 23;
+  time.tm_mday = 3;
+  EXPECT_EQ("11 PM  3", format("{:%I %p %e}", time));
+  time.tm_wday = 0;
+  EXPECT_EQ("7 0 Sun", format("{:%u %w %a}", time));
+  time.tm_year = 42 - 1900;
+  EXPECT_EQ("0042", format("{:%Y}", time));
+  EXPECT_EQ("[2016]", format("[{:%Y}]", make_tm(2016, 1, 1, 0, 0, 0)));
+  EXPECT_EQ(L"2016-02-14 09:05", format(L"{:%F %R}",
+                                        make_tm(2016, 2, 14, 9, 5, 7)));
+  EXPECT_EQ(L"2016-02-14 09:05:07", format(L"{}",
+                                           make_tm(2016, 2, 14, 9, 5, 7)));
+  EXPECT_EQ("0042 x", format("{0:%Y} {1}", time, 'x'));
+  fmt::CompiledFormat compiled("{:%H:%M}!");
+  EXPECT_EQ("23:05!", format(compiled, time));
+  EXPECT_THROW_MSG(format("{:%Q}", time), FormatError, "invalid time format");
+  EXPECT_THROW_MSG(format("{:%}", time), FormatError, "invalid time format");
+  EXPECT_THROW_MSG(format("{:%Y", time), FormatError,
+                   "missing '}' in format string");
+  time.tm_mon = 12;
+  EXPECT_THROW_MSG(format("{:%b}", time), FormatError,
+                   "time field out of range");
+}
+
+TEST(FormatterTest, UTCTime) {
+  for (fmt::LongLong t = -100000000000LL; t < 100000000000LL;
+       t += 987654321) {
+    std::time_t time = static_cast<std::time_t>(t);
+    std::tm expected = *std::gmtime(&time);
+    std::tm actual = fmt::internal::utc_time(t);
+    EXPECT_EQ(expected.tm_year, actual.tm_year);
+    EXPECT_EQ(expected.tm_mon, actual.tm_mon);
+    EXPECT_EQ(expected.tm_mday, actual.tm_mday);
+    EXPECT_EQ(expected.tm_hour, actual.tm_hour);
+    EXPECT_EQ(expected.tm_min, actual.tm_min);
+    EXPECT_EQ(expected.tm_sec, actual.tm_sec);
+    EXPECT_EQ(expected.tm_wday, actual.tm_wday);
+    EXPECT_EQ(expected.tm_yday, actual.tm_yday);
+  }
+}
+
+#if FMT_USE_CHRONO
+TEST(FormatterTest, FormatTimePoint) {
+  using namespace std::chrono;
+  system_clock::time_point epoch;
+  EXPECT_EQ("1970-01-01 00:00:00",
+            format("{}", time_point_cast<seconds>(epoch)));
+  time_point<system_clock, milliseconds> t(milliseconds(1455440707042LL));
+  EXPECT_EQ("2016-02-14 09:05:07.042", format("{}", t));
+  EXPECT_EQ("09:05:07.042 AM", format("{:%r}", t));
+  EXPECT_EQ("09:05", format("{:%H:%M}", t));
+  time_point<system_clock, microseconds> before(microseconds(-1));
+  EXPECT_EQ("1969-12-31 23:59:59.999999", format("{}", before));
+  time_point<system_clock, nanoseconds> ns(nanoseconds(1000000007));
+  EXPECT_EQ(L"00:00:01.000000007", format(L"{:%T}", ns));
+}
+#endif
+
+TEST(TimeFormatTest, Format) {
+  fmt::TimeFormat time_format("[%F %T]");
+  // A sequence of times within and across minute boundaries.
+  const fmt::LongLong times[] = {
+    0, 1, 59, 60, 1455440707, 1455440708, 1455440759, 1455440700, 1455440760,
+    -1, -60, -61
+  };
+  for (std::size_t i = 0; i < sizeof(times) / sizeof(*times); ++i) {
+    MemoryWriter w;
+    time_format.format(w, times[i]);
+    EXPECT_EQ(format("[{:%F %T}]", fmt::internal::utc_time(times[i])),
+              w.str());
+  }
+  MemoryWriter w;
+  time_format.format(w, 1455440707, 42, 3);
+  time_format.format(w, 1455440709, 7, 3);
+  time_format.format(w, 1455440709, 123456, 6);
+  EXPECT_EQ("[2016-02-14 09:05:07.042][2016-02-14 09:05:09.007]"
+            "[2016-02-14 09:05:09.123456]", w.str());
+  fmt::TimeFormat seconds_twice("%S %S %M");
+  w.clear();
+  seconds_twice.format(w, 61);
+  seconds_twice.format(w, 62);
+  EXPECT_EQ("01 01 0102 02 01", w.str());
+  fmt::WTimeFormat wide_format(L"%H:%M:%S");
+  fmt::WMemoryWriter ww;
+  wide_format.format(ww, 3661);
+  EXPECT_EQ(L"01:01:01", ww.str());
+  EXPECT_THROW_MSG(fmt::TimeFormat("%Q"), FormatError, "invalid time format");
+#if FMT_USE_CHRONO
+  using namespace std::chrono;
+  w.clear();
+  time_format.format(
+        w, time_point<system_clock, milliseconds>(milliseconds(61500)));
+  EXPECT_EQ("[1970-01-01 00:01:01.500]", w.str());
+#endif
+}
+
 TEST(FormatterTest, WideFormatString) {
   EXPECT_EQ(L"42", format(L"{}", 42));
   EXPECT_EQ(L"4.2", format(L"{}", 4.2));
@@ -1550,6 +2020,37 @@ TEST(FormatIntTest, FormatDec) {
   EXPECT_EQ("42", format_decimal(42ull));
 }
 
+// Checks values around the boundaries of groups of digits that are
+// formatted together.
+TEST(FormatIntTest, DigitBoundaries) {
+  for (fmt::ULongLong power = 1; ; power *= 10) {
+    fmt::ULongLong values[] = {power - 1, power, power + 1, power * 9 + 7};
+    for (std::size_t i = 0; i < sizeof(values) / sizeof(*values); ++i) {
+      fmt::ULongLong value = values[i];
+      std::ostringstream os;
+      os << value;
+      EXPECT_EQ(os.str(), fmt::FormatInt(value).str());
+      EXPECT_EQ(os.str(), format("{}", value));
+      if (value <= UINT_MAX)
+        EXPECT_EQ(os.str(), format("{}", static_cast<unsigned>(value)));
+      char buffer[100];
+      safe_sprintf(buffer, "%llx", value);
+      EXPECT_EQ(buffer, format("{:x}", value));
+      safe_sprintf(buffer, "%llo", value);
+      EXPECT_EQ(buffer, format("{:o}", value));
+    }
+    if (power > ULLONG_MAX / 10)
+      break;
+  }
+  EXPECT_EQ("4294967295", format("{}", UINT_MAX));
+  EXPECT_EQ("18446744073709551615", fmt::FormatInt(ULLONG_MAX).str());
+  EXPECT_EQ(std::string(64, '1'), format("{:b}", ULLONG_MAX));
+  EXPECT_EQ("1000000000000000000000000000000", format("{:b}", 1u << 30));
+  EXPECT_EQ("0", format("{:b}", 0));
+  EXPECT_EQ("0", format("{:x}", 0));
+  EXPECT_EQ("0", format("{:o}", 0));
+}
+
 TEST(FormatTest, Print) {
 #if FMT_USE_FILE_DESCRIPTORS
   EXPECT_WRITE(stdout, fmt::print("Don't {}!", "panic"), "Don't panic!");
@@ -1568,6 +2069,323 @@ TEST(FormatTest, PrintColored) {
 }
 #endif
 
+#if FMT_USE_FILE_DESCRIPTORS
+class PrintsInFormat {};
+
+template <typename Char>
+void format(fmt::BasicFormatter<Char> &f, const Char *, PrintsInFormat) {
+  fmt::print("in{}", "ner");
+  f.writer() << "outer";
+}
+
+TEST(FormatTest, PrintFromFormat) {
+  EXPECT_WRITE(stdout, fmt::print("{} {}", PrintsInFormat(), 42),
+               "innerouter 42");
+}
+
+TEST(FormatTest, BufferCacheLimit) {
+  std::string long_str(1000, 'x');
+  fmt::set_buffer_cache_limit(0);
+  EXPECT_WRITE(stdout, fmt::print("{}", long_str), long_str);
+  EXPECT_WRITE(stdout, fmt::print("{}", 42), "42");
+  fmt::set_buffer_cache_limit(10000);
+  EXPECT_WRITE(stdout, fmt::print("{}", long_str), long_str);
+  EXPECT_WRITE(stdout, fmt::print("{}", 42), "42");
+  EXPECT_WRITE(stdout, fmt::printf("%s", long_str), long_str);
+  fmt::set_buffer_cache_limit(65536);
+}
+#endif
+
+TEST(FormatTest, FormatTo) {
+  std::string s = "The answer is ";
+  fmt::format_to(s, "{}", 42);
+  EXPECT_EQ("The answer is 42", s);
+  s.clear();
+  fmt::format_to(s, "{:*^1000}", "");
+  EXPECT_EQ(std::string(1000, '*'), s);
+  std::vector<char> v(1, 'a');
+  fmt::format_to(v, "{}c", 'b');
+  EXPECT_EQ("abc", std::string(&v[0], v.size()));
+  fmt::internal::MemoryBuffer<char, 10> buffer;
+  fmt::format_to(buffer, "{}", "abc");
+  fmt::format_to(buffer, "{:.3f}", 1.0);
+  EXPECT_EQ("abc1.000", std::string(&buffer[0], buffer.size()));
+  std::wstring ws = L"a";
+  fmt::format_to(ws, L"{}c{}", L"b", 1);
+  EXPECT_EQ(L"abc1", ws);
+}
+
+#if FMT_USE_VARIADIC_TEMPLATES
+// An allocator that counts allocations.
+template <typename T>
+class CountingAllocator : public std::allocator<T> {
+ public:
+  int *count;
+
+  template <typename U>
+  struct rebind { typedef CountingAllocator<U> other; };
+
+  explicit CountingAllocator(int *c = 0) : count(c) {}
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> &other) : count(other.count) {}
+
+  T *allocate(std::size_t n, const void * = 0) {
+    if (count)
+      ++*count;
+    return std::allocator<T>::allocate(n);
+  }
+};
+
+TEST(FormatTest, FormatToCustomAllocator) {
+  typedef CountingAllocator<char> Allocator;
+  int count = 0;
+  std::basic_string<char, std::char_traits<char>, Allocator>
+      s((Allocator(&count)));
+  s.reserve(1000);
+  int initial_count = count;
+  fmt::format_to(s, "{:*^999}", "abc");
+  EXPECT_EQ(initial_count, count);
+  EXPECT_EQ(std::string(498, '*') + "abc" + std::string(498, '*'),
+            s.c_str());
+  std::vector<char, Allocator> v((Allocator(&count)));
+  fmt::format_to(v, "{}", 42);
+  EXPECT_EQ("42", std::string(v.begin(), v.end()));
+  EXPECT_EQ(initial_count + 1, count);
+}
+#endif
+
+TEST(FormatTest, TryFormat) {
+  MemoryWriter w;
+  fmt::FormatResult result = fmt::try_format(w, "{} {:>4}", 42, "abc");
+  EXPECT_EQ(0, result.error);
+  EXPECT_EQ(7u, result.size);
+  EXPECT_EQ("42  abc", w.str());
+  w.clear();
+  result = fmt::try_format(w, "ab{:d}cd", "x");
+  EXPECT_STREQ("unknown format code for string", result.error);
+  EXPECT_EQ(2u, result.size);
+  EXPECT_EQ("ab", w.str());
+  struct {
+    const char *format;
+    const char *error;
+  } errors[] = {
+    {"{", "missing '}' in format string"},
+    {"}", "unmatched '}' in format string"},
+    {"{9}", "argument index out of range"},
+    {"{0:+}", "format specifier '+' requires signed argument"},
+    {"{4:#}", "format specifier '#' requires numeric argument"},
+    {"{0:.2}", "precision not allowed in integer format specifier"},
+    {"{0:{1}}", "width is not integer"},
+    {"{0:.{2}}", "negative precision"},
+    {"{0:99999999999}", "number is too big"},
+    {"{0:s}", "unknown format code for integer"},
+    {"{1:x}", "unknown format code for floating-point number"},
+    {"{2:c}", "unknown format code for integer"},
+    {"{3:=}", "invalid format specifier for char"},
+    {"{4}", "string pointer is null"},
+    {"{5:x}", "unknown format code for pointer"},
+    {"{name}", "argument not found"}
+  };
+  for (std::size_t i = 0; i < sizeof(errors) / sizeof(*errors); ++i) {
+    w.clear();
+    result = fmt::try_format(w, errors[i].format, 42u, 1.5, -1, 'a',
+                             static_cast<const char*>(0),
+                             static_cast<const void*>(&w));
+    EXPECT_STREQ(errors[i].error, result.error) << errors[i].format;
+  }
+  fmt::WMemoryWriter ww;
+  EXPECT_EQ(0, fmt::try_format(ww, L"{}", 42).error);
+  EXPECT_EQ(L"42", ww.str());
+}
+
+TEST(FormatTest, TryFormatToN) {
+  char buffer[4];
+  fmt::FormatResult result =
+      fmt::try_format_to_n(buffer, sizeof(buffer), "{}", 123456);
+  EXPECT_EQ(0, result.error);
+  EXPECT_EQ(6u, result.size);
+  EXPECT_EQ("1234", std::string(buffer, sizeof(buffer)));
+  result = fmt::try_format_to_n(buffer, sizeof(buffer), "{:q}", 1);
+  EXPECT_STREQ("unknown format code for integer", result.error);
+  EXPECT_EQ(0u, result.size);
+}
+
+TEST(FormatTest, FormatToN) {
+  char buffer[10];
+  std::fill_n(buffer, sizeof(buffer), 'x');
+  EXPECT_EQ(2u, fmt::format_to_n(buffer, sizeof(buffer), "{}", 42));
+  EXPECT_EQ("42xx", std::string(buffer, 4));
+  EXPECT_EQ(5u, fmt::format_to_n(buffer, 3, "{}", "abcde"));
+  EXPECT_EQ("abcxx", std::string(buffer, 5));
+  EXPECT_EQ(3u, fmt::format_to_n(static_cast<char*>(0), 0, "{}", 123));
+  std::string s(1000, 'a');
+  EXPECT_EQ(1000u, fmt::format_to_n(buffer, sizeof(buffer), "{}", s));
+  EXPECT_EQ("aaaaaaaaaa", std::string(buffer, sizeof(buffer)));
+  wchar_t wbuffer[4] = {};
+  EXPECT_EQ(4u, fmt::format_to_n(wbuffer, 3, L"{}", 1234));
+  EXPECT_EQ(std::wstring(L"123"), wbuffer);
+}
+
+TEST(FormatTest, FormattedSize) {
+  EXPECT_EQ(0u, fmt::formatted_size(""));
+  EXPECT_EQ(2u, fmt::formatted_size("{{}}"));
+  EXPECT_EQ(16u, fmt::formatted_size("The answer is {}", 42));
+  EXPECT_EQ(10u, fmt::formatted_size("{:>10}", 42));
+  EXPECT_EQ(11u, fmt::formatted_size("{}", INT_MIN));
+  EXPECT_EQ(20u, fmt::formatted_size("{}", ULLONG_MAX));
+  EXPECT_EQ(10u, fmt::formatted_size("{}{}{}", true, false, 'c'));
+  EXPECT_EQ(6u, fmt::formatted_size("{0}{1}{0}", "ab", std::string("cd")));
+  EXPECT_EQ(9u, fmt::formatted_size("{:{}}", "abc", 9));
+  EXPECT_EQ(4u, fmt::formatted_size("{:.2f}", 1.234));
+  EXPECT_EQ(9u, fmt::formatted_size("{}", Date(2012, 12, 9)));
+  EXPECT_EQ(3u, fmt::formatted_size(L"{}", L"abc"));
+  const char *formats[] = {"{}", "{:+}", "{:x}", "{:#o}", "{:*^7}"};
+  int values[] = {0, 9, -10, 123456, INT_MAX};
+  for (std::size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+    for (std::size_t j = 0; j < sizeof(values) / sizeof(*values); ++j) {
+      EXPECT_EQ(format(formats[i], values[j]).size(),
+                fmt::formatted_size(formats[i], values[j]));
+    }
+  }
+  EXPECT_THROW_MSG(fmt::formatted_size("{}"), FormatError,
+                   "argument index out of range");
+  EXPECT_THROW_MSG(fmt::formatted_size("{", 42), FormatError,
+                   "missing '}' in format string");
+}
+
+// Format strings that are not null-terminated must not be read past
+// their end.
+TEST(FormatTest, FormatStringRef) {
+  EXPECT_EQ("42", format(StringRef("{}}", 2), 42));
+  EXPECT_EQ("x 42", format(StringRef("x {:}x", 5), 42));
+  EXPECT_EQ("   42", format(StringRef("{:>{}}}", 6), 42, 5));
+  EXPECT_EQ("{", format(StringRef("{{{", 2)));
+  EXPECT_EQ("}", format(StringRef("}}}", 2)));
+  EXPECT_EQ(std::string("a\0b1", 4), format(StringRef("a\0b{}", 5), 1));
+  EXPECT_EQ(L"42", format(fmt::WStringRef(L"{}}", 2), 42));
+  EXPECT_THROW_MSG(format(StringRef("ab}}", 3)),
+      FormatError, "unmatched '}' in format string");
+  EXPECT_THROW_MSG(format(StringRef("{0:x}", 3), 42),
+      FormatError, "missing '}' in format string");
+  EXPECT_THROW_MSG(format(StringRef("{}", 1), 42),
+      FormatError, "missing '}' in format string");
+  EXPECT_EQ(2u, fmt::formatted_size(StringRef("{}}", 2), 42));
+  std::string s;
+  fmt::format_to(s, StringRef("{}{}", 2), 42, 43);
+  EXPECT_EQ("42", s);
+  fmt::FormatRecord record;
+  record.capture(StringRef("{} {}", 2), 42);
+  EXPECT_EQ("42", record.str());
+  record.capture(StringRef("", 0));
+  EXPECT_FALSE(record.empty());
+  EXPECT_EQ("", record.str());
+}
+
+TEST(FormatTest, FormatRecord) {
+  fmt::FormatRecord record;
+  EXPECT_TRUE(record.empty());
+  {
+    std::string s = "abc";
+    char cstr[] = "def";
+    record.capture("{} {} {} {:>4}", 42, s, cstr, 'x');
+    s = "xyz";
+    cstr[0] = 'x';
+  }
+  EXPECT_FALSE(record.empty());
+  EXPECT_EQ("42 abc def    x", record.str());
+  record.capture("{:.1f}", 1.25);
+  EXPECT_EQ("1.2", record.str());
+  fmt::MemoryWriter w;
+  record.format(w);
+  EXPECT_EQ("1.2", w.str());
+}
+
+TEST(FormatTest, FormatRecordNamedArgs) {
+  fmt::FormatRecord record;
+  {
+    std::string name = "answer", value = "42";
+    record.capture("{answer} {0}", fmt::arg(name, value));
+  }
+  EXPECT_EQ("42 42", record.str());
+}
+
+TEST(FormatTest, FormatRecordManyArgs) {
+  fmt::FormatRecord record;
+  record.capture("{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}",
+                 1, 2, 3, 4, 5, 6, 7, 8, 9, "a", 'b', 'c', 'd', 'e', 'f',
+                 'g', 'h', 'i', 'j', std::string("k"));
+  EXPECT_EQ("123456789abcdefghijk", record.str());
+}
+
+TEST(FormatTest, WideFormatRecord) {
+  fmt::WFormatRecord record;
+  record.capture(L"{} {}", "abc", std::wstring(L"def"));
+  EXPECT_EQ(L"abc def", record.str());
+}
+
+#if FMT_USE_RVALUE_REFERENCES
+TEST(FormatTest, MoveFormatRecord) {
+  fmt::FormatRecord record;
+  record.capture("{}", "test");
+  fmt::FormatRecord record2(std::move(record));
+  EXPECT_TRUE(record.empty());
+  EXPECT_EQ("test", record2.str());
+}
+#endif
+
+#if FMT_USE_IS_COPY_CONSTRUCTIBLE
+class CopyCounter {
+ public:
+  static int num_objects;
+
+  CopyCounter() { ++num_objects; }
+  CopyCounter(const CopyCounter &) { ++num_objects; }
+  ~CopyCounter() { --num_objects; }
+};
+
+int CopyCounter::num_objects;
+
+template <typename Char>
+void format(fmt::BasicFormatter<Char> &f, const Char *, CopyCounter) {
+  f.writer() << "copy";
+}
+
+TEST(FormatTest, FormatRecordCustomArg) {
+  {
+    fmt::FormatRecord record;
+    record.capture("{}", CopyCounter());
+    EXPECT_EQ(1, CopyCounter::num_objects);
+    EXPECT_EQ("copy", record.str());
+    record.capture("{}", 42);
+    EXPECT_EQ(0, CopyCounter::num_objects);
+    record.capture("{} {}", Answer(), CopyCounter());
+    EXPECT_EQ("42 copy", record.str());
+  }
+  EXPECT_EQ(0, CopyCounter::num_objects);
+}
+
+class NonCopyable {
+ public:
+  NonCopyable() {}
+
+ private:
+  NonCopyable(const NonCopyable &);
+};
+
+template <typename Char>
+void format(fmt::BasicFormatter<Char> &f, const Char *, const NonCopyable &) {
+  f.writer() << "non-copyable";
+}
+
+TEST(FormatTest, FormatRecordNonCopyableArg) {
+  fmt::FormatRecord record;
+  EXPECT_THROW_MSG(record.capture("{}", NonCopyable()), FormatError,
+                   "cannot copy argument of custom type");
+  EXPECT_TRUE(record.empty());
+}
+#endif
+
 TEST(FormatTest, Variadic) {
   EXPECT_EQ("abc1", format("{}c{}", "ab", 1));
   EXPECT_EQ(L"abc1", format(L"{}c{}", L"ab", 1));
@@ -1594,6 +2412,35 @@ std::string format_message(int id, const char *format,
 
 FMT_VARIADIC(std::string, format_message, int, const char *)
 
+TEST(FormatTest, Join) {
+  int ints[] = {1, 2, 3};
+  EXPECT_EQ("1, 2, 3", format("{}", fmt::join(ints, ints + 3, ", ")));
+  EXPECT_EQ("(+01)(+02)(+03)",
+            format("({:+03})", fmt::join(ints, ints + 3, ")(")));
+  EXPECT_EQ("[  1,  2]", format("[{:>{}}]", fmt::join(ints, ints + 2, ","), 3));
+  EXPECT_EQ("", format("{:+.2f}", fmt::join(ints, ints, ", ")));
+  std::vector<double> v;
+  v.push_back(1.234);
+  v.push_back(5.678);
+  EXPECT_EQ("1.2 5.7 !", format("{:.1f} {}", fmt::join(v.begin(), v.end(), " "),
+                                '!'));
+  std::list<std::string> strings;
+  strings.push_back("ab");
+  strings.push_back("c");
+  EXPECT_EQ("ab-c",
+            format("{}", fmt::join(strings.begin(), strings.end(), "-")));
+  Date dates[] = {Date(2012, 12, 9), Date(2013, 1, 2)};
+  EXPECT_EQ("2012-12-9, 2013-1-2",
+            format("{}", fmt::join(dates, dates + 2, ", ")));
+  EXPECT_EQ(L"1;2", format(L"{}", fmt::join(ints, ints + 2, L";")));
+  EXPECT_THROW_MSG(format("{:.2}", fmt::join(ints, ints + 3, ", ")),
+      FormatError, "precision not allowed in integer format specifier");
+  EXPECT_THROW_MSG(format("{:+}", fmt::join(strings.begin(), strings.end(),
+      ", ")), FormatError, "format specifier '+' requires numeric argument");
+  EXPECT_THROW_MSG(format("{:d}", fmt::join(v.begin(), v.end(), ", ")),
+      FormatError, "unknown format code 'd' for double");
+}
+
 TEST(FormatTest, FormatMessageExample) {
   EXPECT_EQ("[42] something happened",
       format_message(42, "{} happened", "something"));
@@ -1613,3 +2460,185 @@ TEST(FormatTest, MaxArgs) {
             fmt::format("{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}",
                         0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 'a', 'b', 'c', 'd', 'e'));
 }
+
+TEST(CompiledFormatTest, Format) {
+  fmt::CompiledFormat f("{} + {:>4} = {:.2f}{{}}");
+  EXPECT_EQ("1 +    2 = 3.00{}", format(f, 1, 2, 3.0));
+  EXPECT_EQ("a +    b = 0.50{}", format(f, 'a', "b", 0.5));
+  EXPECT_EQ("{} + {:>4} = {:.2f}{{}}", std::string(f.format_str().c_str()));
+  EXPECT_EQ("", format(fmt::CompiledFormat("")));
+  EXPECT_EQ("}{", format(fmt::CompiledFormat("}}{{")));
+}
+
+TEST(CompiledFormatTest, ArgIndexing) {
+  EXPECT_EQ("b a b", format(fmt::CompiledFormat("{1} {0} {1}"), 'a', 'b'));
+  EXPECT_EQ("42 answer", format(fmt::CompiledFormat("{x} {y}"),
+                                fmt::arg("y", "answer"), fmt::arg("x", 42)));
+  EXPECT_EQ("   42", format(fmt::CompiledFormat("{0:{1}}"), 42, 5));
+  EXPECT_EQ("3.1", format(fmt::CompiledFormat("{:.{}}"), 3.14159, 2));
+  EXPECT_EQ("  3.1", format(fmt::CompiledFormat("{0:{w}.{p}}"), 3.14159,
+                            fmt::arg("w", 5), fmt::arg("p", 2)));
+}
+
+TEST(CompiledFormatTest, Errors) {
+  EXPECT_THROW_MSG(fmt::CompiledFormat("}"), FormatError,
+      "unmatched '}' in format string");
+  EXPECT_THROW_MSG(fmt::CompiledFormat("{0"), FormatError,
+      "missing '}' in format string");
+  EXPECT_THROW_MSG(fmt::CompiledFormat("{:"), FormatError,
+      "missing '}' in format string");
+  EXPECT_THROW_MSG(fmt::CompiledFormat("{0}{}"), FormatError,
+      "cannot switch from manual to automatic argument indexing");
+  EXPECT_THROW_MSG(fmt::CompiledFormat("{}{0}"), FormatError,
+      "cannot switch from automatic to manual argument indexing");
+  fmt::CompiledFormat sign("{:+}");
+  EXPECT_EQ("+42", format(sign, 42));
+  EXPECT_THROW_MSG(format(sign, 42u), FormatError,
+      "format specifier '+' requires signed argument");
+  EXPECT_THROW_MSG(format(sign, "abc"), FormatError,
+      "format specifier '+' requires numeric argument");
+  EXPECT_THROW_MSG(format(sign), FormatError, "argument index out of range");
+  EXPECT_THROW_MSG(format(fmt::CompiledFormat("{:.2}"), 42), FormatError,
+      "precision not allowed in integer format specifier");
+  EXPECT_THROW_MSG(format(fmt::CompiledFormat("{:{}}"), 42, -1), FormatError,
+      "negative width");
+  EXPECT_THROW_MSG(format(fmt::CompiledFormat("{:{<5}"), 42), FormatError,
+      "invalid fill character '{'");
+  EXPECT_THROW_MSG(format(fmt::CompiledFormat("{:d}"), "abc"), FormatError,
+      "unknown format code 'd' for string");
+  EXPECT_THROW_MSG(format(fmt::CompiledFormat("{a}"), 42), FormatError,
+      "argument not found");
+}
+
+TEST(CompiledFormatTest, CustomArg) {
+  fmt::CompiledFormat f("{}/{:>10}/{}");
+  EXPECT_EQ("2012-12-9/ 2012-12-9/42",
+            format(f, Date(2012, 12, 9), Date(2012, 12, 9), Answer()));
+}
+
+TEST(CompiledFormatTest, Writer) {
+  static const fmt::CompiledFormat f("({:+f}, {:+f})");
+  MemoryWriter w;
+  w.write(f, -3.14, 3.14);
+  w.write(f, 1.0, -1.0);
+  EXPECT_EQ("(-3.140000, +3.140000)(+1.000000, -1.000000)", w.str());
+  fmt::WCompiledFormat wf(L"{}c{}");
+  EXPECT_EQ(L"abc1", format(wf, L"ab", 1));
+}
+
+#if FMT_USE_FILE_DESCRIPTORS
+TEST(CompiledFormatTest, Print) {
+  fmt::CompiledFormat f("Don't {}!");
+  EXPECT_WRITE(stdout, fmt::print(f, "panic"), "Don't panic!");
+  EXPECT_WRITE(stderr, fmt::print(stderr, f, "panic"), "Don't panic!");
+}
+#endif
+
+TEST(FormatTest, CompileTimeFormatString) {
+  EXPECT_EQ("", fmt::format(FMT_STRING("")));
+  EXPECT_EQ("{}", fmt::format(FMT_STRING("{{}}")));
+  EXPECT_EQ("42 and abc", fmt::format(FMT_STRING("{} and {}"), 42, "abc"));
+  EXPECT_EQ("b, a", fmt::format(FMT_STRING("{1}, {0}"), 'a', 'b'));
+  EXPECT_EQ("**+42**", fmt::format(FMT_STRING("{:*^7}"), "+42"));
+  EXPECT_EQ("-0042", fmt::format(FMT_STRING("{:05}"), -42));
+  EXPECT_EQ("+0x2a", fmt::format(FMT_STRING("{:+#x}"), 42));
+  EXPECT_EQ("1.23", fmt::format(FMT_STRING("{:.{}f}"), 1.2345, 2));
+  EXPECT_EQ("   1.2", fmt::format(FMT_STRING("{:{}.{}}"), 1.2345, 6, 2));
+  EXPECT_EQ("true", fmt::format(FMT_STRING("{}"), true));
+  EXPECT_EQ("0x1234", fmt::format(
+              FMT_STRING("{:p}"), reinterpret_cast<void*>(0x1234)));
+  EXPECT_EQ("abc", fmt::format(FMT_STRING("{:s}"), std::string("abc")));
+  EXPECT_EQ("  2012-12-9",
+            fmt::format(FMT_STRING("{:>11}"), Date(2012, 12, 9)));
+  EXPECT_EQ(L"abc1", fmt::format(FMT_STRING(L"{}c{}"), L"ab", 1));
+  EXPECT_THROW_MSG(fmt::format(FMT_STRING("{:{}}"), 42, -1), FormatError,
+      "negative width");
+}
+
+#if FMT_USE_FILE_DESCRIPTORS
+TEST(FormatTest, PrintCompileTimeFormatString) {
+  EXPECT_WRITE(stdout, fmt::print(FMT_STRING("Don't {}!"), "panic"),
+               "Don't panic!");
+  EXPECT_WRITE(stderr, fmt::print(stderr, FMT_STRING("Don't {}!"), "panic"),
+               "Don't panic!");
+}
+#endif
+
+#if FMT_USE_PARALLEL_FORMAT
+// Appends the output of parallel_format to a string counting the chunks.
+template <typename Char>
+struct StringSink {
+  std::basic_string<Char> *str;
+  int *num_chunks;
+
+  void operator()(fmt::BasicStringRef<Char> s) const {
+    str->append(s.data(), s.size());
+    ++*num_chunks;
+  }
+};
+
+TEST(ParallelFormatTest, CompiledFormat) {
+  std::vector<int> values;
+  std::string expected;
+  for (int i = 0; i < 100000; ++i) {
+    values.push_back(i * 7);
+    expected += format("{:x}\n", i * 7);
+  }
+  static const fmt::CompiledFormat f("{:x}\n");
+  std::string s;
+  int num_chunks = 0;
+  StringSink<char> sink = {&s, &num_chunks};
+  fmt::parallel_format(f, values.begin(), values.end(), sink, 4, 100);
+  EXPECT_EQ(expected, s);
+  EXPECT_EQ(1000, num_chunks);
+  s.clear();
+  fmt::parallel_format(f, values.begin(), values.end(), sink);
+  EXPECT_EQ(expected, s);
+  s.clear();
+  fmt::parallel_format(f, values.begin(), values.end(), sink, 1, 7);
+  EXPECT_EQ(expected, s);
+  num_chunks = 0;
+  fmt::parallel_format(f, values.begin(), values.begin(), sink, 4);
+  EXPECT_EQ(0, num_chunks);
+  std::wstring ws;
+  StringSink<wchar_t> wsink = {&ws, &num_chunks};
+  fmt::parallel_format(fmt::WCompiledFormat(L"[{}]"),
+                       values.begin(), values.begin() + 3, wsink, 2, 1);
+  EXPECT_EQ(L"[0][7][14]", ws);
+}
+
+TEST(ParallelFormatTest, Records) {
+  // Records with very long names take much longer to format than the others.
+  std::vector<std::pair<int, std::string> > records;
+  for (int i = 0; i < 20000; ++i)
+    records.push_back(std::make_pair(i, std::string(i % 997 ? 3 : 5000, 'x')));
+  std::string expected;
+  for (std::size_t i = 0; i < records.size(); ++i)
+    expected += format("{} {}\n", records[i].first, records[i].second);
+  std::string s;
+  int num_chunks = 0;
+  StringSink<char> sink = {&s, &num_chunks};
+  fmt::parallel_format(records.begin(), records.end(),
+    [](fmt::Writer &w, const std::pair<int, std::string> &r) {
+      w.write("{} {}\n", r.first, r.second);
+    }, sink, 8, 64);
+  EXPECT_EQ(expected, s);
+}
+
+TEST(ParallelFormatTest, Errors) {
+  std::vector<int> values(10000, 42);
+  values[5000] = -1;
+  std::string s;
+  int num_chunks = 0;
+  StringSink<char> sink = {&s, &num_chunks};
+  EXPECT_THROW_MSG(fmt::parallel_format(values.begin(), values.end(),
+    [](fmt::Writer &w, int value) {
+      w.write("{:{}}", value, value);
+    }, sink, 4, 10), FormatError, "negative width");
+  EXPECT_GE(500, num_chunks);
+  EXPECT_THROW_MSG(fmt::parallel_format(fmt::CompiledFormat("{}"),
+    values.begin(), values.end(), [](fmt::StringRef) {
+      throw std::runtime_error("sink error");
+    }, 4, 10), std::runtime_error, "sink error");
+}
+#endif
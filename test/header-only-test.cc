@@ -26,3 +26,10 @@
  */
 
 #include "format.h"
+#include "gtest/gtest.h"
+
+TEST(HeaderOnlyTest, Format) {
+  EXPECT_EQ("42", fmt::format("{}", 42));
+  EXPECT_EQ(L"1.5", fmt::format(L"{}", 1.5));
+  EXPECT_EQ("  abc", fmt::sprintf("%5s", "abc"));
+}
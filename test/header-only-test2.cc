@@ -25,4 +25,9 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef FMT_EXTERN_TEMPLATES
+// Provide the instantiations declared extern in format.h.
+# define FMT_INSTANTIATE_TEMPLATES
+#endif
+
 #include "format.h"
@@ -58,6 +58,8 @@ int dup2_count;
 int fdopen_count;
 int read_count;
 int write_count;
+int writev_count;
+int ftruncate_count;
 int pipe_count;
 int fopen_count;
 int fclose_count;
@@ -164,6 +166,29 @@ test::ssize_t test::write(int fildes, const void *buf, test::size_t nbyte) {
 }
 
 #ifndef _WIN32
+test::ssize_t test::writev(int fildes, const struct iovec *iov, int iovcnt) {
+  EMULATE_EINTR(writev, -1);
+  return ::writev(fildes, iov, iovcnt);
+}
+
+int test::ftruncate(int fildes, off_t length) {
+  EMULATE_EINTR(ftruncate, -1);
+  return ::ftruncate(fildes, length);
+}
+
+void *test::mmap(
+    void *addr, size_t len, int prot, int flags, int fildes, off_t off) {
+  return ::mmap(addr, len, prot, flags, fildes, off);
+}
+
+int test::munmap(void *addr, size_t len) {
+  return ::munmap(addr, len);
+}
+
+int test::madvise(void *addr, size_t len, int advice) {
+  return ::madvise(addr, len, advice);
+}
+
 int test::pipe(int fildes[2]) {
   EMULATE_EINTR(pipe, -1);
   return ::pipe(fildes);
@@ -327,6 +352,30 @@ TEST(FileTest, WriteRetry) {
 #endif
 }
 
+#ifndef _WIN32
+TEST(FileTest, WritevRetry) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  fmt::StringRef buffers[] = {"te", "st"};
+  std::size_t count = 0;
+  EXPECT_RETRY(count = write_end.writev(buffers, 2),
+      writev, "cannot write to file");
+  write_end.close();
+  EXPECT_EQ(4u, count);
+  EXPECT_READ(read_end, "test");
+}
+#endif
+
+#if FMT_USE_MMAP
+TEST(MappedFileWriterTest, ResizeRetry) {
+  File f("test-file", File::RDWR | O_CREAT | O_TRUNC);
+  fmt::MappedFileWriter w(f, 1);
+  EXPECT_RETRY(w << "test", ftruncate, "cannot resize file");
+  w.close();
+  EXPECT_EQ(4, f.size());
+}
+#endif
+
 #ifdef _WIN32
 TEST(FileTest, ConvertReadCount) {
   File read_end, write_end;
@@ -41,6 +41,10 @@
 struct stat;
 #endif
 
+#ifndef _WIN32
+struct iovec;
+#endif
+
 namespace test {
 
 #ifndef _MSC_VER
@@ -72,6 +76,15 @@ FILE *fdopen(int fildes, const char *mode);
 ssize_t read(int fildes, void *buf, size_t nbyte);
 ssize_t write(int fildes, const void *buf, size_t nbyte);
 
+#ifndef _WIN32
+ssize_t writev(int fildes, const struct iovec *iov, int iovcnt);
+
+int ftruncate(int fildes, off_t length);
+void *mmap(void *addr, size_t len, int prot, int flags, int fildes, off_t off);
+int munmap(void *addr, size_t len);
+int madvise(void *addr, size_t len, int advice);
+#endif
+
 #ifndef _WIN32
 int pipe(int fildes[2]);
 #else
@@ -31,6 +31,12 @@
 #include "posix.h"
 #include "util.h"
 
+#if FMT_USE_ASYNC_SINK
+# include <algorithm>
+# include <thread>
+# include <vector>
+#endif
+
 #ifdef __MINGW32__
 # undef fileno
 #endif
@@ -380,3 +386,240 @@ TEST(FileTest, FdopenError) {
   EXPECT_SYSTEM_ERROR_NOASSERT(
       f.fdopen("r"), EBADF, "cannot associate stream with file descriptor");
 }
+
+TEST(FileTest, Writev) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  fmt::StringRef buffers[] = {"te", "", "st"};
+  EXPECT_EQ(4u, write_end.writev(buffers, 3));
+  write_end.close();
+  EXPECT_READ(read_end, "test");
+}
+
+TEST(FileTest, WritevError) {
+  File f("test-file", File::RDONLY);
+  fmt::StringRef buffers[] = {" "};
+  EXPECT_SYSTEM_ERROR(f.writev(buffers, 1), EBADF, "cannot write to file");
+}
+
+TEST(FileTest, Print) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  fmt::print(write_end, "Don't {}!", "panic");
+  write_end.close();
+  EXPECT_READ(read_end, "Don't panic!");
+}
+
+TEST(FileWriterTest, Write) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  {
+    fmt::FileWriter w(write_end, 8);
+    w.write("{}", 42);
+    w << "ab";
+    EXPECT_EQ("42ab", w.str());
+    // Reaching the threshold flushes the buffer.
+    w.write("{}", "cdef");
+    EXPECT_EQ(0u, w.size());
+    EXPECT_READ(read_end, "42abcdef");
+    w << "gh";
+    w.flush();
+    EXPECT_READ(read_end, "gh");
+    w << "ij";
+  }
+  write_end.close();
+  EXPECT_READ(read_end, "ij");
+}
+
+TEST(FileWriterTest, FlushAfterEveryWrite) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  {
+    fmt::FileWriter w(write_end, 4);
+    w << 12345;
+    EXPECT_EQ(0u, w.size());
+    EXPECT_READ(read_end, "12345");
+    w.write_padded("ab", 4);
+    EXPECT_EQ(0u, w.size());
+    EXPECT_READ(read_end, "ab  ");
+    w << "x";
+    EXPECT_EQ(1u, w.size());
+  }
+  write_end.close();
+  EXPECT_READ(read_end, "x");
+}
+
+TEST(FileWriterTest, FlushError) {
+  File f = open_file();
+  fmt::FileWriter w(f, 8);
+  w << "abc";
+  EXPECT_THROW(w.flush(), fmt::SystemError);
+  EXPECT_EQ("abc", w.str());
+  EXPECT_THROW(w.append(std::string(100, 'x')), fmt::SystemError);
+  EXPECT_EQ("abc", w.str());
+  w.clear();
+}
+
+TEST(FileWriterTest, Append) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  std::string large(100, 'x');
+  {
+    fmt::FileWriter w(write_end, 8);
+    w.append("abc");
+    EXPECT_EQ("abc", w.str());
+    w.append(large);
+    EXPECT_EQ(0u, w.size());
+    w.append("def");
+  }
+  write_end.close();
+  EXPECT_READ(read_end, ("abc" + large + "def").c_str());
+}
+
+TEST(MappedFileWriterTest, Write) {
+  std::string large(10000, 'x');
+  {
+    File f("test-file", File::RDWR | O_CREAT | O_TRUNC);
+    fmt::MappedFileWriter w(f, 1);
+    w.write("The answer is {}. ", 42);
+    w << large;
+    EXPECT_EQ("The answer is 42. " + large, w.str());
+  }
+  File f("test-file", File::RDONLY);
+  EXPECT_EQ(static_cast<fmt::LongLong>(large.size() + 18), f.size());
+  EXPECT_READ(f, ("The answer is 42. " + large).c_str());
+}
+
+TEST(MappedFileWriterTest, Close) {
+  File f("test-file", File::RDWR | O_CREAT | O_TRUNC);
+  fmt::MappedFileWriter w(f);
+  w.write("{}", "test");
+  w.close();
+  EXPECT_EQ(4, f.size());
+}
+
+TEST(SegmentedWriterTest, WriteToFile) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  fmt::SegmentedWriter w(16);
+  for (int i = 0; i < 10; ++i)
+    w.write("line {}\n", i);
+  std::string expected = w.str();
+  fmt::write(write_end, w);
+  write_end.close();
+  EXPECT_READ(read_end, expected.c_str());
+}
+
+TEST(HugePageAllocatorTest, MemoryWriter) {
+  fmt::BasicMemoryWriter<char, fmt::HugePageAllocator<char> > w;
+  std::string large(fmt::HugePageAllocator<char>::THRESHOLD + 1, 'x');
+  w << "abc";
+  EXPECT_EQ("abc", w.str());
+  w << large;
+  EXPECT_EQ("abc" + large, w.str());
+  w.shrink_to_fit();
+  EXPECT_EQ(large.size() + 3, w.buffer().capacity());
+  w.release();
+  EXPECT_EQ(0u, w.size());
+}
+
+#if FMT_USE_ASYNC_SINK
+TEST(AsyncSinkTest, Write) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  std::string large(1000, 'x');
+  {
+    fmt::AsyncSink sink(std::move(write_end), fmt::AsyncSink::BLOCK, 4, 16);
+    EXPECT_TRUE(sink.write("abc"));
+    EXPECT_TRUE(sink.print("{}{}", 4, 2));
+    EXPECT_TRUE(sink.write(large));
+  }
+  EXPECT_READ(read_end, ("abc42" + large).c_str());
+}
+
+TEST(AsyncSinkTest, Flush) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  fmt::AsyncSink sink(std::move(write_end));
+  sink.write("test");
+  sink.flush();
+  EXPECT_READ(read_end, "test");
+  EXPECT_EQ(0u, sink.dropped());
+}
+
+TEST(AsyncSinkTest, FlushToFile) {
+  File f("test-file", File::RDWR | O_CREAT | O_TRUNC);
+  fmt::AsyncSink sink(File::dup(f.descriptor()));
+  for (int i = 0; i < 10; ++i) {
+    sink.print("{}\n", i);
+    sink.flush();
+    EXPECT_EQ(2 * (i + 1), f.size());
+  }
+}
+
+TEST(AsyncSinkTest, ConcurrentWrites) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  enum { NUM_THREADS = 4, NUM_RECORDS = 1000 };
+  {
+    fmt::AsyncSink sink(std::move(write_end), fmt::AsyncSink::BLOCK, 8);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+      threads.push_back(std::thread([&sink, i] {
+        for (int j = 0; j < NUM_RECORDS; ++j)
+          sink.print("{}", i);
+      }));
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
+    EXPECT_EQ(0u, sink.dropped());
+  }
+  std::string output = read(read_end, NUM_THREADS * NUM_RECORDS + 1);
+  EXPECT_EQ(static_cast<std::size_t>(NUM_THREADS * NUM_RECORDS),
+            output.size());
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    EXPECT_EQ(NUM_RECORDS,
+              std::count(output.begin(), output.end(), '0' + i));
+  }
+}
+
+TEST(AsyncSinkTest, DropOrOverwrite) {
+  fmt::AsyncSink::OverflowPolicy policies[] = {
+    fmt::AsyncSink::DROP, fmt::AsyncSink::OVERWRITE
+  };
+  for (std::size_t i = 0; i < sizeof(policies) / sizeof(*policies); ++i) {
+    File read_end, write_end;
+    File::pipe(read_end, write_end);
+    enum { NUM_RECORDS = 1000 };
+    std::size_t num_dropped = 0;
+    {
+      fmt::AsyncSink sink(std::move(write_end), policies[i], 2);
+      for (int j = 0; j < NUM_RECORDS; ++j) {
+        if (!sink.write("abc"))
+          ++num_dropped;
+      }
+      sink.flush();
+      if (policies[i] == fmt::AsyncSink::DROP)
+        EXPECT_EQ(num_dropped, sink.dropped());
+      else
+        EXPECT_EQ(0u, num_dropped);
+      num_dropped = sink.dropped();
+    }
+    std::string expected;
+    for (std::size_t j = num_dropped; j < NUM_RECORDS; ++j)
+      expected += "abc";
+    EXPECT_EQ(expected, read(read_end, 3 * NUM_RECORDS + 1));
+  }
+}
+
+TEST(AsyncSinkTest, WriteError) {
+  File read_end, write_end;
+  File::pipe(read_end, write_end);
+  // We intentionally write to the read end of the pipe to cause error.
+  fmt::AsyncSink sink(std::move(read_end));
+  sink.write("test");
+  sink.flush();
+  EXPECT_EQ(EBADF, sink.error().get());
+  EXPECT_EQ(1u, sink.dropped());
+}
+#endif
@@ -48,7 +48,10 @@ std::string make_positional(fmt::StringRef format) {
 #define EXPECT_PRINTF(expected_output, format, arg) \
   EXPECT_EQ(expected_output, fmt::sprintf(format, arg)) \
     << "format: " << format; \
-  EXPECT_EQ(expected_output, fmt::sprintf(make_positional(format), arg))
+  EXPECT_EQ(expected_output, fmt::sprintf(make_positional(format), arg)); \
+  EXPECT_EQ(expected_output, \
+            fmt::sprintf(fmt::CompiledPrintfFormat(format), arg)) \
+    << "format: " << format
 
 TEST(PrintfTest, NoArgs) {
   EXPECT_EQ("test", fmt::sprintf("test"));
@@ -62,6 +65,40 @@ TEST(PrintfTest, Escape) {
   EXPECT_EQ("%s", fmt::sprintf("%%s"));
 }
 
+TEST(PrintfTest, LongLiterals) {
+  std::string text(100, 'x');
+  for (std::size_t size = 0; size < 70; ++size) {
+    std::string literal = text.substr(0, size);
+    EXPECT_EQ(literal + "%" + literal,
+              fmt::sprintf((literal + "%%" + literal).c_str()));
+    EXPECT_EQ(literal + "42", fmt::sprintf((literal + "%d").c_str(), 42));
+  }
+}
+
+TEST(PrintfTest, FormatStringRef) {
+  EXPECT_EQ("42", fmt::sprintf(fmt::StringRef("%d%d", 2), 42));
+  EXPECT_EQ("%", fmt::sprintf(fmt::StringRef("%%%", 2)));
+  EXPECT_EQ("   42", fmt::sprintf(fmt::StringRef("%5d%", 3), 42));
+  EXPECT_THROW_MSG(fmt::sprintf(fmt::StringRef("%5d", 2), 42),
+      FormatError, "invalid format string");
+  EXPECT_THROW_MSG(fmt::sprintf(fmt::StringRef("%d", 1), 42),
+      FormatError, "invalid format string");
+}
+
+TEST(PrintfTest, TypeOnlySpecs) {
+  EXPECT_EQ("42 abc 2a 1.500000 x",
+            fmt::sprintf("%d %s %x %f %c", 42, "abc", 42, 1.5, 'x'));
+  EXPECT_EQ("-1 4294967295", fmt::sprintf("%i %u", -1, -1));
+  EXPECT_EQ("1 4294967295",
+            fmt::sprintf("%d %u", true, static_cast<signed char>(-1)));
+  EXPECT_EQ("ffffffffffffffff",
+            fmt::sprintf("%llx", static_cast<fmt::LongLong>(-1)));
+  EXPECT_THROW_MSG(fmt::sprintf("%d"), FormatError,
+                   "argument index out of range");
+  EXPECT_THROW_MSG(fmt::sprintf("%y", 42), FormatError,
+                   "unknown format code 'y' for integer");
+}
+
 TEST(PrintfTest, PositionalArgs) {
   EXPECT_EQ("42", fmt::sprintf("%1$d", 42));
   EXPECT_EQ("before 42", fmt::sprintf("before %1$d", 42));
@@ -452,3 +489,26 @@ TEST(PrintfTest, PrintfError) {
   EXPECT_LT(result, 0);
 }
 #endif
+
+TEST(PrintfTest, CompiledFormat) {
+  fmt::CompiledPrintfFormat f("%2$s = %1$08.3f%%");
+  EXPECT_EQ("pi = 0003.142%", fmt::sprintf(f, 3.14159, "pi"));
+  EXPECT_EQ("e = 0002.718%", fmt::sprintf(f, 2.71828, "e"));
+  EXPECT_EQ("  -42|0x2a|  abc",
+            fmt::sprintf(fmt::CompiledPrintfFormat("%*d|%#x|%*.*s"),
+                         5, -42, 42, 5, 3, "abcdef"));
+  EXPECT_EQ("255", fmt::sprintf(fmt::CompiledPrintfFormat("%hhu"), -1));
+  EXPECT_THROW_MSG(fmt::CompiledPrintfFormat("%"),
+      FormatError, "invalid format string");
+  EXPECT_THROW_MSG(fmt::CompiledPrintfFormat("%1$d%d"), FormatError,
+      "cannot switch from manual to automatic argument indexing");
+  EXPECT_THROW_MSG(fmt::sprintf(fmt::CompiledPrintfFormat("%d")),
+      FormatError, "argument index out of range");
+  fmt::WMemoryWriter w;
+  fmt::printf(w, fmt::WCompiledPrintfFormat(L"abc%%"), fmt::ArgList());
+  EXPECT_EQ(L"abc%", w.str());
+#if FMT_USE_FILE_DESCRIPTORS
+  EXPECT_WRITE(stdout, fmt::printf(fmt::CompiledPrintfFormat("%s"), "test"),
+               "test");
+#endif
+}
@@ -0,0 +1,172 @@
+/*
+ Formatting statistics tests.
+
+ Copyright (c) 2015, Victor Zverovich
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "format.h"
+
+// The tests are compiled with FMT_USE_STATS by the stats-test target; other
+// targets, such as the pedantic build of all tests, compile an empty file.
+#if FMT_USE_STATS
+
+#include <sstream>
+#include <thread>
+
+#include "gtest-extra.h"
+
+namespace {
+struct Streamable {};
+
+std::ostream &operator<<(std::ostream &os, Streamable) {
+  return os << "streamable";
+}
+
+// Returns the timing of the format string or a zero timing.
+fmt::FormatTiming find_timing(const std::string &format) {
+  std::vector<fmt::FormatTiming> timings = fmt::collect_format_timings();
+  for (std::size_t i = 0; i < timings.size(); ++i) {
+    if (timings[i].format == format)
+      return timings[i];
+  }
+  return fmt::FormatTiming();
+}
+}
+
+TEST(StatsTest, BufferGrowth) {
+  fmt::reset_stats();
+  fmt::MemoryWriter w;
+  w << std::string(100, 'x');
+  EXPECT_EQ(0u, fmt::thread_stats().buffer_grows);
+  w << std::string(1000, 'x');
+  fmt::Stats stats = fmt::thread_stats();
+  EXPECT_EQ(1u, stats.buffer_grows);
+  EXPECT_EQ(1u, stats.inline_buffer_spills);
+  EXPECT_EQ(1100u, stats.bytes_allocated);
+  w << std::string(1000, 'x');
+  stats = fmt::thread_stats();
+  EXPECT_EQ(2u, stats.buffer_grows);
+  EXPECT_EQ(1u, stats.inline_buffer_spills);
+  EXPECT_EQ(1100u + 2100u, stats.bytes_allocated);
+}
+
+TEST(StatsTest, SlowPaths) {
+  fmt::reset_stats();
+  fmt::format("{}", 42);
+  fmt::Stats stats = fmt::thread_stats();
+  EXPECT_EQ(0u, stats.double_snprintf_calls);
+  EXPECT_EQ(0u, stats.ostream_fallbacks);
+  EXPECT_EQ(0u, stats.arg_map_builds);
+  EXPECT_EQ("0x1.8p+0", fmt::format("{:a}", 1.5));
+  EXPECT_EQ("1.5", fmt::format("{}", 1.5));
+  EXPECT_EQ(1002u, fmt::format("{:.1000f}", 0.5).size());
+  EXPECT_EQ("streamable", fmt::format("{}", Streamable()));
+  EXPECT_EQ("1", fmt::format("{a}", fmt::arg("a", 1)));
+  stats = fmt::thread_stats();
+  EXPECT_EQ(2u, stats.double_snprintf_calls);
+  EXPECT_EQ(1u, stats.double_snprintf_retries);
+  EXPECT_EQ(1u, stats.ostream_fallbacks);
+  EXPECT_EQ(1u, stats.arg_map_builds);
+}
+
+TEST(StatsTest, CollectAcrossThreads) {
+  fmt::reset_stats();
+  std::thread t([] {
+    fmt::MemoryWriter w;
+    w << std::string(1000, 'x');
+    EXPECT_EQ(1u, fmt::thread_stats().buffer_grows);
+  });
+  t.join();
+  EXPECT_EQ(0u, fmt::thread_stats().buffer_grows);
+  fmt::MemoryWriter w;
+  w << std::string(1000, 'x');
+  EXPECT_EQ(2u, fmt::collect_stats().buffer_grows);
+  fmt::reset_stats();
+  EXPECT_EQ(0u, fmt::collect_stats().buffer_grows);
+}
+
+TEST(StatsTest, FormatTiming) {
+  fmt::reset_stats();
+  for (int i = 0; i < 3; ++i)
+    fmt::format("{} timing", i);
+  std::thread([] { fmt::format("{} timing", 1); }).join();
+  fmt::format(L"{} timing \u00e9", 1);
+  fmt::CompiledFormat compiled("{} compiled");
+  fmt::format(compiled, 1);
+  fmt::format(compiled, 2);
+  fmt::FormatTiming timing = find_timing("{} timing");
+  EXPECT_EQ(4u, timing.count);
+  fmt::ULongLong count = 0;
+  for (int i = 0; i < fmt::FormatTiming::NUM_BUCKETS; ++i)
+    count += timing.buckets[i];
+  EXPECT_EQ(timing.count, count);
+  EXPECT_EQ(1u, find_timing("{} timing ?").count);
+  EXPECT_EQ(2u, find_timing("{} compiled").count);
+  std::vector<fmt::FormatTiming> timings = fmt::collect_format_timings();
+  for (std::size_t i = 1; i < timings.size(); ++i)
+    EXPECT_GE(timings[i - 1].total_ns, timings[i].total_ns);
+  fmt::reset_stats();
+  EXPECT_EQ(0u, find_timing("{} timing").count);
+}
+
+TEST(StatsTest, FormatTimingReusedAddress) {
+  fmt::reset_stats();
+  char format[] = "A={}";
+  for (int i = 0; i < 3; ++i)
+    fmt::format(fmt::StringRef(format, 4), i);
+  format[0] = 'B';
+  for (int i = 0; i < 2; ++i)
+    fmt::format(fmt::StringRef(format, 4), i);
+  EXPECT_EQ(3u, find_timing("A={}").count);
+  EXPECT_EQ(2u, find_timing("B={}").count);
+  std::string dynamic = "A={}";
+  fmt::format(dynamic, 42);
+  EXPECT_EQ(4u, find_timing("A={}").count);
+}
+TEST(StatsTest, BufferCacheLimit) {
+  std::string long_str(1000, 'x');
+  std::ostringstream os;
+  fmt::set_buffer_cache_limit(10000);
+  fmt::print(os, "{}", long_str);
+  // The buffer is within the limit so it is kept and reused without growing.
+  fmt::reset_stats();
+  fmt::print(os, "{}", long_str);
+  EXPECT_EQ(0u, fmt::thread_stats().buffer_grows);
+  // The buffer is over the limit so it is released after the call and
+  // the next call has to grow a new one.
+  fmt::set_buffer_cache_limit(0);
+  fmt::print(os, "{}", long_str);
+  EXPECT_EQ(0u, fmt::thread_stats().buffer_grows);
+  fmt::print(os, "{}", long_str);
+  fmt::Stats stats = fmt::thread_stats();
+  EXPECT_EQ(1u, stats.buffer_grows);
+  EXPECT_EQ(1u, stats.inline_buffer_spills);
+  fmt::print(os, "{}", long_str);
+  stats = fmt::thread_stats();
+  EXPECT_EQ(2u, stats.buffer_grows);
+  EXPECT_EQ(2u, stats.inline_buffer_spills);
+  fmt::set_buffer_cache_limit(65536);
+  EXPECT_EQ(5000u, os.str().size());
+}
+#endif  // FMT_USE_STATS
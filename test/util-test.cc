@@ -388,6 +388,93 @@ TEST(MemoryBufferTest, ExceptionInDeallocate) {
   EXPECT_CALL(alloc, deallocate(&mem2[0], 2 * size));
 }
 
+TEST(MemoryBufferTest, GrowthPolicy) {
+  fmt::GrowthPolicy policy;
+  EXPECT_EQ(150u, policy.next_capacity(100, 101));
+  EXPECT_EQ(200u, policy.next_capacity(100, 200));
+  policy = fmt::GrowthPolicy::geometric(2, 1);
+  EXPECT_EQ(200u, policy.next_capacity(100, 101));
+  policy = fmt::GrowthPolicy::geometric(1, 1);
+  EXPECT_EQ(101u, policy.next_capacity(100, 101));
+  policy = fmt::GrowthPolicy::chunked(64);
+  EXPECT_EQ(128u, policy.next_capacity(100, 101));
+  EXPECT_EQ(64u, policy.next_capacity(0, 1));
+  MemoryBuffer<char, 10, std::allocator<char>, fmt::GrowthPolicy> buffer;
+  buffer.set_growth_policy(policy);
+  buffer.resize(11);
+  EXPECT_EQ(64u, buffer.capacity());
+  buffer.resize(65);
+  EXPECT_EQ(128u, buffer.capacity());
+}
+
+// A buffer with the same data as MemoryBuffer but without a growth policy.
+struct BufferWithoutPolicy : fmt::Buffer<char> {
+  char data[10];
+};
+
+TEST(MemoryBufferTest, DefaultGrowthPolicy) {
+  EXPECT_EQ(150u, fmt::DefaultGrowthPolicy::next_capacity(100, 101));
+  EXPECT_EQ(200u, fmt::DefaultGrowthPolicy::next_capacity(100, 200));
+  EXPECT_EQ(sizeof(BufferWithoutPolicy), sizeof(MemoryBuffer<char, 10>));
+  MemoryBuffer<char, 10> buffer;
+  buffer.resize(11);
+  EXPECT_EQ(15u, buffer.capacity());
+}
+
+TEST(MemoryBufferTest, ShrinkToFit) {
+  MemoryBuffer<char, 10> buffer;
+  buffer.append("abc", "abc" + 3);
+  buffer.shrink_to_fit();
+  EXPECT_EQ(10u, buffer.capacity());
+  buffer.resize(100);
+  buffer[99] = 'x';
+  buffer.resize(20);
+  buffer.shrink_to_fit();
+  EXPECT_EQ(20u, buffer.capacity());
+  EXPECT_EQ('a', buffer[0]);
+  buffer.resize(5);
+  buffer.shrink_to_fit();
+  EXPECT_EQ(10u, buffer.capacity());
+  EXPECT_EQ("abc", std::string(&buffer[0], 3));
+}
+
+TEST(MemoryBufferTest, Release) {
+  typedef AllocatorRef< MockAllocator<char> > TestAllocator;
+  StrictMock< MockAllocator<char> > alloc;
+  MemoryBuffer<char, 10, TestAllocator> buffer((TestAllocator(&alloc)));
+  std::vector<char> mem(20);
+  EXPECT_CALL(alloc, allocate(20)).WillOnce(Return(&mem[0]));
+  buffer.resize(20);
+  EXPECT_CALL(alloc, deallocate(&mem[0], 20));
+  buffer.release();
+  EXPECT_EQ(0u, buffer.size());
+  EXPECT_EQ(10u, buffer.capacity());
+}
+
+TEST(StringBufferTest, Str) {
+  fmt::internal::StringBuffer<char> buffer;
+  EXPECT_EQ(static_cast<std::size_t>(fmt::internal::INLINE_BUFFER_SIZE),
+            buffer.capacity());
+  buffer.append("abc", "abc" + 3);
+  EXPECT_EQ("abc", buffer.str());
+  EXPECT_EQ(0u, buffer.size());
+  std::string s(1000, 'x');
+  buffer.append(s.data(), s.data() + s.size());
+  EXPECT_EQ(s, buffer.str());
+  EXPECT_EQ(0u, buffer.size());
+}
+
+TEST(StringBufferTest, StrCapacity) {
+  // Check that the result doesn't hold on to the buffer's storage.
+  std::string s(22, 'x');
+  fmt::internal::StringBuffer<char> buffer;
+  buffer.append(s.data(), s.data() + s.size());
+  std::string result = buffer.str();
+  EXPECT_EQ(s, result);
+  EXPECT_LT(result.capacity(), 2 * s.size());
+  EXPECT_LT(fmt::format("{}", s).capacity(), 2 * s.size());
+}
+
 TEST(UtilTest, Increment) {
   char s[10] = "123";
   increment(s);
@@ -710,6 +797,92 @@ TEST(UtilTest, CountDigits) {
   test_count_digits<uint64_t>();
 }
 
+TEST(UtilTest, UTF8ToWChar) {
+  MemoryBuffer<wchar_t, 10> buffer;
+  buffer.push_back(L'!');
+  EXPECT_TRUE(fmt::internal::utf8_to_wchar("", buffer));
+  EXPECT_TRUE(fmt::internal::utf8_to_wchar(
+      "\xd0\xbb\xd0\xbe\xd1\x88\xd0\xb0\xd0\xb4\xd0\xba\xd0\xb0", buffer));
+  EXPECT_EQ(std::wstring(L"!\x043B\x043E\x0448\x0430\x0434\x043A\x0430"),
+            std::wstring(&buffer[0], buffer.size()));
+  // Mix ASCII blocks with multibyte sequences at different offsets.
+  std::string ascii(40, 'a');
+  for (std::size_t i = 0; i < ascii.size(); i += 7) {
+    std::string s = ascii.substr(0, i) + "\xe2\x82\xac" + ascii.substr(i);
+    buffer.clear();
+    EXPECT_TRUE(fmt::internal::utf8_to_wchar(s, buffer));
+    std::wstring expected = std::wstring(i, L'a') + L'\x20AC' +
+        std::wstring(ascii.size() - i, L'a');
+    EXPECT_EQ(expected, std::wstring(&buffer[0], buffer.size()));
+  }
+  buffer.clear();
+  EXPECT_TRUE(fmt::internal::utf8_to_wchar("\xf0\x9f\x98\x80", buffer));
+  if (sizeof(wchar_t) == 2) {
+    ASSERT_EQ(2u, buffer.size());
+    EXPECT_EQ(0xd83d, static_cast<int>(buffer[0]));
+    EXPECT_EQ(0xde00, static_cast<int>(buffer[1]));
+  } else {
+    ASSERT_EQ(1u, buffer.size());
+    EXPECT_EQ(0x1f600, static_cast<int>(buffer[0]));
+  }
+}
+
+TEST(UtilTest, UTF8ToWCharInvalid) {
+  const char *invalid[] = {
+    "\x80",              // unexpected continuation byte
+    "\xc0\xaf",          // overlong
+    "\xe0\x80\xaf",      // overlong
+    "\xed\xa0\x80",      // surrogate
+    "\xf4\x90\x80\x80",  // out of range
+    "\xe2\x82",          // truncated
+    "\xe2\x28\xa1"       // invalid continuation byte
+  };
+  for (std::size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+    MemoryBuffer<wchar_t, 10> buffer;
+    buffer.push_back(L'x');
+    std::string s = std::string(20, 'a') + invalid[i];
+    EXPECT_FALSE(fmt::internal::utf8_to_wchar(s, buffer)) << i;
+    EXPECT_EQ(1u, buffer.size());
+  }
+}
+
+TEST(UtilTest, WCharToUTF8) {
+  MemoryBuffer<char, 10> buffer;
+  EXPECT_TRUE(fmt::internal::wchar_to_utf8(L"", buffer));
+  EXPECT_EQ(0u, buffer.size());
+  std::wstring s = std::wstring(20, L'a') + L"\x0451\x0436" +
+      std::wstring(17, L'b') + L"\x20AC" + L"c";
+  EXPECT_TRUE(fmt::internal::wchar_to_utf8(s, buffer));
+  EXPECT_EQ(std::string(20, 'a') + "\xd1\x91\xd0\xb6" + std::string(17, 'b') +
+            "\xe2\x82\xac" "c", std::string(&buffer[0], buffer.size()));
+  // A long non-ASCII string requires growing the output.
+  buffer.clear();
+  EXPECT_TRUE(fmt::internal::wchar_to_utf8(std::wstring(100, L'\x20AC'),
+                                           buffer));
+  std::string expected;
+  for (int i = 0; i < 100; ++i)
+    expected += "\xe2\x82\xac";
+  EXPECT_EQ(expected, std::string(&buffer[0], buffer.size()));
+}
+
+TEST(UtilTest, WCharToUTF8Invalid) {
+  MemoryBuffer<char, 10> buffer;
+  buffer.push_back('x');
+  std::wstring s(20, L'a');
+  s += static_cast<wchar_t>(0xdc00);
+  EXPECT_FALSE(fmt::internal::wchar_to_utf8(s, buffer));
+  EXPECT_EQ(1u, buffer.size());
+  s[20] = static_cast<wchar_t>(0xd800);
+  EXPECT_FALSE(fmt::internal::wchar_to_utf8(s, buffer));
+  EXPECT_EQ(1u, buffer.size());
+  if (sizeof(wchar_t) == 2) {
+    s += static_cast<wchar_t>(0xdc00);
+    EXPECT_TRUE(fmt::internal::wchar_to_utf8(s, buffer));
+    EXPECT_EQ("x" + std::string(20, 'a') + "\xf0\x90\x80\x80",
+              std::string(&buffer[0], buffer.size()));
+  }
+}
+
 #ifdef _WIN32
 TEST(UtilTest, UTF16ToUTF8) {
   std::string s = "ёжик";